@@ -196,7 +196,14 @@ SOURCES += src/main.cpp\
     src/query/airportquery.cpp \
     src/query/infoquery.cpp \
     src/query/mapquery.cpp \
-    src/query/procedurequery.cpp
+    src/query/procedurequery.cpp \
+    src/common/magdecgrid.cpp \
+    src/mapgui/mapbenchmark.cpp \
+    src/mapgui/maptileexport.cpp \
+    src/print/briefingexport.cpp \
+    src/query/airspaceindex.cpp \
+    src/query/cachebudget.cpp \
+    src/query/airportranking.cpp
 
 HEADERS  += src/gui/mainwindow.h \
     src/search/columnlist.h \
@@ -281,7 +288,15 @@ HEADERS  += src/gui/mainwindow.h \
     src/query/airportquery.h \
     src/query/infoquery.h \
     src/query/mapquery.h \
-    src/query/procedurequery.h
+    src/query/procedurequery.h \
+    src/common/magdecgrid.h \
+    src/mapgui/mapbenchmark.h \
+    src/query/querystatistics.h \
+    src/mapgui/maptileexport.h \
+    src/print/briefingexport.h \
+    src/query/airspaceindex.h \
+    src/query/cachebudget.h \
+    src/query/airportranking.h
 
 FORMS    += src/gui/mainwindow.ui \
     src/db/databasedialog.ui \
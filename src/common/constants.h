@@ -111,10 +111,12 @@ const QLatin1Literal MAINWINDOW_WIDGET_STATE_POS("MainWindow/WidgetStatePosition
 const QLatin1Literal MAINWINDOW_WIDGET_STATE_SIZE("MainWindow/WidgetStateSize");
 const QLatin1Literal MAINWINDOW_WIDGET_STATE_MAXIMIZED("MainWindow/WidgetStateMaximized");
 const QLatin1Literal MAINWINDOW_PRINT_SIZE("MainWindow/PrintPreviewSize");
+const QLatin1Literal MAINWINDOW_HIGHRES_SCALE("MainWindow/HighResImageScale");
 const QLatin1Literal MAP_DETAILFACTOR("Map/DetailFactor");
 const QLatin1Literal MAP_DISTANCEMARKERS("Map/DistanceMarkers");
 const QLatin1Literal MAP_AIRSPACES("Map/AirspaceFilter");
 const QLatin1Literal MAP_HOMEDISTANCE("Map/HomeDistance");
+const QLatin1Literal MAP_HISTORY_SNAPSHOT_CACHE_KB("Map/HistorySnapshotCacheKb");
 const QLatin1Literal MAP_HOMELATY("Map/HomeLatY");
 const QLatin1Literal MAP_HOMELONX("Map/HomeLonX");
 const QLatin1Literal MAP_KMLFILES("Map/KmlFiles");
@@ -143,6 +145,7 @@ const QLatin1Literal SEARCHTAB_NAV_VIEW_DIST_WIDGET("SearchPaneNav/WidgetDistVie
 const QLatin1Literal SETTINGS_INFOQUERY("Settings/InfoQuery");
 const QLatin1Literal SETTINGS_MAPQUERY("Settings/MapQuery");
 const QLatin1Literal SETTINGS_DATABASE("Settings/Database");
+const QLatin1Literal SETTINGS_CACHE_BUDGET_KB("Settings/CacheBudgetKb");
 
 const QLatin1Literal APPROACHTREE_WIDGET("ApproachTree/Widget");
 const QLatin1Literal APPROACHTREE_SELECTED_WIDGET("ApproachTree/WidgetSelected");
@@ -25,6 +25,8 @@
 
 #include <QLineF>
 
+#include <cmath>
+
 using namespace Marble;
 using namespace atools::geo;
 
@@ -201,6 +203,120 @@ QPoint CoordinateConverter::wToS(const Marble::GeoDataCoordinates& coords, const
   }
 }
 
+/* Orthographic projection for the spherical view. Written without branches to allow vectorization. */
+static void wToSSpherical(const float *lonX, const float *latY, float *x, float *y, bool *visible, int num,
+                          double centerLon, double centerLat, double radius, double width, double height,
+                          double minX, double maxX, double minY, double maxY)
+{
+  const double TO_RAD = M_PI / 180.;
+  const double sinLat0 = std::sin(centerLat), cosLat0 = std::cos(centerLat);
+
+  for(int i = 0; i < num; i++)
+  {
+    double lon = lonX[i] * TO_RAD - centerLon, lat = latY[i] * TO_RAD;
+    double sinLat = std::sin(lat), cosLat = std::cos(lat), cosLon = std::cos(lon);
+
+    // Unit sphere coordinates after rotating the center to the front
+    double px = cosLat * std::sin(lon);
+    double py = cosLat0 * sinLat - sinLat0 * cosLat * cosLon;
+    double pz = sinLat0 * sinLat + cosLat0 * cosLat * cosLon;
+
+    double sx = width / 2. + radius * px;
+    double sy = height / 2. - radius * py;
+    x[i] = static_cast<float>(sx);
+    y[i] = static_cast<float>(sy);
+
+    // Points with negative z are hidden behind the globe
+    visible[i] = (pz >= 0.) & (sx >= minX) & (sx < maxX) & (sy >= minY) & (sy < maxY);
+  }
+}
+
+/* Mercator projection. Written without branches to allow vectorization. */
+static void wToSMercator(const float *lonX, const float *latY, float *x, float *y, bool *visible, int num,
+                         double centerLon, double centerLat, double radius, double width, double height,
+                         double minX, double maxX, double minY, double maxY)
+{
+  const double TO_RAD = M_PI / 180.;
+  const double MAX_LAT = std::atan(std::sinh(M_PI));
+  const double rad2Pixel = 2. * radius / M_PI;
+  const double worldWidth = 4. * radius;
+  const double centerY = std::atanh(std::sin(centerLat));
+
+  for(int i = 0; i < num; i++)
+  {
+    // Longitude difference normalized to -180 to 180
+    double lon = lonX[i] * TO_RAD - centerLon;
+    lon -= 2. * M_PI * std::floor((lon + M_PI) / (2. * M_PI));
+
+    double originalLat = latY[i] * TO_RAD;
+    double lat = std::min(std::max(originalLat, -MAX_LAT), MAX_LAT);
+
+    double sx = width / 2. + rad2Pixel * lon;
+    double sy = height / 2. - rad2Pixel * (std::atanh(std::sin(lat)) - centerY);
+
+    // Use repetition of the world which falls into the screen
+    sx += (sx < minX) ? worldWidth : 0.;
+    sx -= (sx >= maxX) ? worldWidth : 0.;
+
+    x[i] = static_cast<float>(sx);
+    y[i] = static_cast<float>(sy);
+    visible[i] = (lat == originalLat) & (sx >= minX) & (sx < maxX) & (sy >= minY) & (sy < maxY);
+  }
+}
+
+void CoordinateConverter::wToS(const float *lonX, const float *latY, float *x, float *y, bool *visible, int num,
+                               const QSize& size) const
+{
+  double radius = viewport->radius(), width = viewport->width(), height = viewport->height();
+
+  // Screen rectangle extended by object size
+  double minX = -size.width() / 2., maxX = width + size.width() / 2.;
+  double minY = -size.height() / 2., maxY = height + size.height() / 2.;
+
+  if(viewport->projection() == Marble::Spherical)
+    wToSSpherical(lonX, latY, x, y, visible, num, viewport->centerLongitude(), viewport->centerLatitude(),
+                  radius, width, height, minX, maxX, minY, maxY);
+  else if(viewport->projection() == Marble::Mercator && 4. * radius > maxX - minX)
+    wToSMercator(lonX, latY, x, y, visible, num, viewport->centerLongitude(), viewport->centerLatitude(),
+                 radius, width, height, minX, maxX, minY, maxY);
+  else
+  {
+    for(int i = 0; i < num; i++)
+    {
+      double xr, yr;
+      visible[i] = wToS(Pos(lonX[i], latY[i]), xr, yr, size);
+      x[i] = static_cast<float>(xr);
+      y[i] = static_cast<float>(yr);
+    }
+  }
+}
+
+void CoordinateConverter::wToS(const QVector<atools::geo::Pos>& positions, QVector<QPointF>& points,
+                               QVector<bool>& visible, const QSize& size) const
+{
+  int num = positions.size();
+
+  // Split into contiguous coordinate arrays
+  QVector<float> lonX(num), latY(num), x(num), y(num);
+  for(int i = 0; i < num; i++)
+  {
+    const Pos& pos = positions.at(i);
+    lonX[i] = pos.isValid() ? pos.getLonX() : 0.f;
+    latY[i] = pos.isValid() ? pos.getLatY() : 0.f;
+  }
+
+  visible.resize(num);
+  wToS(lonX.constData(), latY.constData(), x.data(), y.data(), visible.data(), num, size);
+
+  points.resize(num);
+  for(int i = 0; i < num; i++)
+  {
+    points[i] = QPointF(x.at(i), y.at(i));
+    if(!positions.at(i).isValid())
+      visible[i] = false;
+  }
+}
+
 bool CoordinateConverter::sToW(int x, int y, Marble::GeoDataCoordinates& coords) const
 {
   qreal lon, lat;
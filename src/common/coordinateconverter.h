@@ -22,6 +22,7 @@
 
 #include <QPoint>
 #include <QSize>
+#include <QVector>
 
 namespace Marble {
 class ViewportParams;
@@ -103,6 +104,23 @@ public:
   bool wToS(const atools::geo::Line& coords, QLineF& line, const QSize& size = DEFAULT_WTOS_SIZE,
             bool *isHidden = nullptr) const;
 
+  /*
+   * Batch conversion of world to screen coordinates for arrays of size num.
+   * Uses closed form projections for the spherical and Mercator projection which avoid creating
+   * GeoDataCoordinates and virtual calls for each point. Other projections and Mercator views showing
+   * the world more than once fall back to the single point conversion.
+   * @param lonX, latY world coordinates in degree
+   * @param x, y resulting screen coordinates. Also set for invisible points.
+   * @param visible true if point is visible and not hidden
+   * @param size estimated screen size of the object
+   */
+  void wToS(const float *lonX, const float *latY, float *x, float *y, bool *visible, int num,
+            const QSize& size = DEFAULT_WTOS_SIZE) const;
+
+  /* Batch conversion for a list of positions. Result vectors are resized. Invalid positions are not visible. */
+  void wToS(const QVector<atools::geo::Pos>& positions, QVector<QPointF>& points, QVector<bool>& visible,
+            const QSize& size = DEFAULT_WTOS_SIZE) const;
+
   bool sToW(int x, int y, Marble::GeoDataCoordinates& coords) const;
 
   /* Converte screen to world coordinates */
@@ -23,17 +23,38 @@
 
 #include <QDateTime>
 #include <QElapsedTimer>
+#include <QHash>
 #include <QLocale>
+#include <QMutexLocker>
 #include <QRegularExpression>
 
 namespace formatter {
 
+/* Cache for time strings keyed by minutes. Formatting can be called from threads. */
+static QMutex timeCacheMutex;
+static QHash<int, QString> minutesHoursCache;
+
+/* Maximum number of cached strings. Cache is cleared if size exceeds this */
+static const int MAX_TIME_CACHE_SIZE = 10000;
+
 QString formatMinutesHours(double time)
 {
   int hours = (int)time;
   int minutes = (int)((time - hours) * 60);
-  return QString(QObject::tr("%1:%2")).arg(QLocale().toString(hours)).
-         arg(minutes, 2, 10, QChar('0'));
+  int key = hours * 60 + minutes;
+
+  QMutexLocker locker(&timeCacheMutex);
+  auto it = minutesHoursCache.constFind(key);
+  if(it != minutesHoursCache.constEnd())
+    return it.value();
+
+  if(minutesHoursCache.size() > MAX_TIME_CACHE_SIZE)
+    minutesHoursCache.clear();
+
+  QString str = QString(QObject::tr("%1:%2")).arg(QLocale().toString(hours)).
+                arg(minutes, 2, 10, QChar('0'));
+  minutesHoursCache.insert(key, str);
+  return str;
 }
 
 QString formatMinutesHoursLong(double time)
@@ -135,6 +156,12 @@ QString formatElapsed(const QElapsedTimer& timer)
   }
 }
 
+void clearCache()
+{
+  QMutexLocker locker(&timeCacheMutex);
+  minutesHoursCache.clear();
+}
+
 QString capNavString(const QString& str)
 {
   return atools::fs::util::capNavString(str);
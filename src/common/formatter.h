@@ -35,7 +35,7 @@ QString formatDate(int timeT);
 /* Format time_t to long locale dependent date string */
 QString formatDateLong(int timeT);
 
-/* Format a decimal time in hours to h:mm format */
+/* Format a decimal time in hours to h:mm format. Result is cached. */
 QString formatMinutesHours(double time);
 
 /* Format a decimal time in hours to X h Y m format */
@@ -54,6 +54,9 @@ QString formatFloatUnit(float value, const QString& unit = QString(), int precis
 /* Format elapsed time to minutes and seconds */
 QString formatElapsed(const QElapsedTimer& timer);
 
+/* Clear the cache of formatted strings. Needed if the locale changes. */
+void clearCache();
+
 } // namespace formatter
 
 #endif // LITTLENAVMAP_FORMATTER_H
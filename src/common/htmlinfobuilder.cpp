@@ -2340,6 +2340,16 @@ void HtmlInfoBuilder::aircraftProgressText(const atools::fs::sc::SimConnectAircr
   {
     head(html, tr("Position"));
     html.row2(tr("Coordinates:"), Unit::coords(aircraft.getPosition()));
+
+    // Airspaces at aircraft position and altitude
+    QList<map::MapAirspace> airspaces;
+    mapQuery->getAirspacesAtPos(airspaces, aircraft.getPosition(), aircraft.getPosition().getAltitude());
+    QStringList airspaceTexts;
+    for(const map::MapAirspace& airspace : airspaces)
+      airspaceTexts.append(tr("%1 (%2)").arg(formatter::capNavString(airspace.name)).
+                           arg(map::airspaceTypeToString(airspace.type)));
+    if(!airspaceTexts.isEmpty())
+      html.row2(airspaceTexts.size() > 1 ? tr("Airspaces:") : tr("Airspace:"), airspaceTexts.join(tr(", ")));
     html.tableEnd();
   }
 }
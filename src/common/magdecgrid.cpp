@@ -0,0 +1,124 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "common/magdecgrid.h"
+
+#include "fs/common/magdecreader.h"
+#include "geo/pos.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+void MagDecGrid::init(atools::fs::common::MagDecReader& reader)
+{
+  clear();
+
+  if(!reader.isValid())
+    return;
+
+  grid.resize(NUM_LONX * NUM_LATY);
+  float *data = grid.data();
+  for(int y = 0; y < NUM_LATY; y++)
+  {
+    float *row = data + y * NUM_LONX;
+    for(int x = 0; x < NUM_LONX - 1; x++)
+      row[x] = reader.getMagVar(atools::geo::Pos(static_cast<float>(x - 180), static_cast<float>(y - 90)));
+
+    // Wrap around at the anti-meridian
+    row[NUM_LONX - 1] = row[0];
+  }
+}
+
+void MagDecGrid::clear()
+{
+  grid.clear();
+}
+
+float MagDecGrid::getMagVar(const atools::geo::Pos& pos) const
+{
+  return getMagVar(pos.getLonX(), pos.getLatY());
+}
+
+void MagDecGrid::getMagVars(float *magvars, const float *lonX, const float *latY, int num) const
+{
+  for(int i = 0; i < num; i++)
+    magvars[i] = getMagVar(lonX[i], latY[i]);
+}
+
+void MagDecGrid::getMagVars(QVector<float>& magvars, const QVector<atools::geo::Pos>& positions) const
+{
+  int num = positions.size();
+
+  // Split into contiguous coordinate arrays
+  QVector<float> lonX(num), latY(num);
+  for(int i = 0; i < num; i++)
+  {
+    const atools::geo::Pos& pos = positions.at(i);
+    lonX[i] = pos.isValid() ? pos.getLonX() : 0.f;
+    latY[i] = pos.isValid() ? pos.getLatY() : 0.f;
+  }
+
+  magvars.resize(num);
+  getMagVars(magvars.data(), lonX.constData(), latY.constData(), num);
+
+  for(int i = 0; i < num; i++)
+  {
+    if(!positions.at(i).isValid())
+      magvars[i] = 0.f;
+  }
+}
+
+void MagDecGrid::benchmark(atools::fs::common::MagDecReader& reader) const
+{
+  if(!isValid() || !reader.isValid())
+    return;
+
+  // Points on a fine grid which are not aligned with the one degree steps
+  const int NUM = 100000;
+  QVector<float> lonX(NUM), latY(NUM), magvars(NUM), readerMagvars(NUM);
+  for(int i = 0; i < NUM; i++)
+  {
+    lonX[i] = -179.9f + std::fmod(i * 0.731f, 359.8f);
+    latY[i] = -89.9f + std::fmod(i * 0.377f, 179.8f);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  for(int i = 0; i < NUM; i++)
+    readerMagvars[i] = reader.getMagVar(atools::geo::Pos(lonX.at(i), latY.at(i)));
+  qint64 readerNs = timer.nsecsElapsed();
+
+  timer.restart();
+  getMagVars(magvars.data(), lonX.constData(), latY.constData(), NUM);
+  qint64 gridNs = timer.nsecsElapsed();
+
+  // Use absolute values so that positive and negative errors do not cancel out
+  double sumDiff = 0.;
+  float maxDiff = 0.f;
+  for(int i = 0; i < NUM; i++)
+  {
+    float diff = std::abs(magvars.at(i) - readerMagvars.at(i));
+    sumDiff += diff;
+    maxDiff = std::max(maxDiff, diff);
+  }
+
+  qDebug() << Q_FUNC_INFO << NUM << "lookups"
+           << "reader" << readerNs / 1000 << "us"
+           << "grid batch" << gridNs / 1000 << "us"
+           << "mean absolute difference" << sumDiff / NUM
+           << "max absolute difference" << maxDiff;
+}
@@ -0,0 +1,99 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_MAGDECGRID_H
+#define LITTLENAVMAP_MAGDECGRID_H
+
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+
+namespace atools {
+namespace geo {
+class Pos;
+}
+namespace fs {
+namespace common {
+class MagDecReader;
+}
+}
+}
+
+/*
+ * Dense float grid of magnetic declination values with one degree spacing sampled once from the
+ * MagDecReader after loading the database.
+ *
+ * Values are bilinearly interpolated between grid points. The lookup is inline and free of branches except
+ * for clamping so loops over arrays of coordinates can be vectorized by the compiler.
+ *
+ * Not thread safe for initialization but lookups can be done concurrently.
+ */
+class MagDecGrid
+{
+public:
+  /* Sample all grid points from the reader. Grid is invalid if reader is invalid. */
+  void init(atools::fs::common::MagDecReader& reader);
+  void clear();
+
+  bool isValid() const
+  {
+    return !grid.isEmpty();
+  }
+
+  /* Get interpolated magnetic variance in degree for position. Same sign as MagDecReader::getMagVar.
+   * Must not be called when grid is not valid. */
+  inline float getMagVar(float lonX, float latY) const
+  {
+    // Shift to positive grid coordinates and clamp to grid boundaries
+    float x = std::min(std::max(lonX + 180.f, 0.f), static_cast<float>(NUM_LONX - 1) - 0.001f);
+    float y = std::min(std::max(latY + 90.f, 0.f), static_cast<float>(NUM_LATY - 1) - 0.001f);
+
+    int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+    float fx = x - x0, fy = y - y0;
+
+    const float *row0 = grid.constData() + y0 * NUM_LONX + x0;
+    const float *row1 = row0 + NUM_LONX;
+
+    float top = row0[0] + (row0[1] - row0[0]) * fx;
+    float bottom = row1[0] + (row1[1] - row1[0]) * fx;
+    return top + (bottom - top) * fy;
+  }
+
+  float getMagVar(const atools::geo::Pos& pos) const;
+
+  /* Batch lookup for arrays of coordinates. All arrays have to be of size num. */
+  void getMagVars(float *magvars, const float *lonX, const float *latY, int num) const;
+
+  /* Batch lookup for a list of positions. Result list is resized to the size of positions.
+   * Invalid positions get a value of 0. */
+  void getMagVars(QVector<float>& magvars, const QVector<atools::geo::Pos>& positions) const;
+
+  /* Compare lookup times of this grid with the reader and print the result to the log */
+  void benchmark(atools::fs::common::MagDecReader& reader) const;
+
+private:
+  /* One degree spacing. Longitude -180 to 180 inclusive where 180 is copied from -180 to
+   * allow interpolation across the anti-meridian. Latitude -90 to 90 inclusive. */
+  static Q_DECL_CONSTEXPR int NUM_LONX = 361;
+  static Q_DECL_CONSTEXPR int NUM_LATY = 181;
+
+  /* Row major from south to north */
+  QVector<float> grid;
+};
+
+#endif // LITTLENAVMAP_MAGDECGRID_H
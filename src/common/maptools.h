@@ -132,7 +132,7 @@ static Q_DECL_CONSTEXPR int MAX_LIST_ENTRIES = 5;
 /* Inserts element into list sorted by screen distance to xs/ys using ids set for deduplication */
 template<typename TYPE>
 void insertSortedByDistance(const CoordinateConverter& conv, QList<TYPE>& list, QSet<int> *ids,
-                            int xs, int ys, TYPE type)
+                            int xs, int ys, const TYPE& type)
 {
   if(list.size() > MAX_LIST_ENTRIES)
     return;
@@ -158,7 +158,7 @@ void insertSortedByDistance(const CoordinateConverter& conv, QList<TYPE>& list,
 /* Inserts element into list sorted by screen distance of tower to xs/ys using ids set for deduplication */
 template<typename TYPE>
 void insertSortedByTowerDistance(const CoordinateConverter& conv, QList<TYPE>& list, int xs, int ys,
-                                 TYPE type)
+                                 const TYPE& type)
 {
   auto it = std::lower_bound(list.begin(), list.end(), type,
                              [ = ](const TYPE &a1, const TYPE &a2)->bool
@@ -20,6 +20,7 @@
 #include "atools.h"
 #include "geo/calculations.h"
 #include "common/unit.h"
+#include "common/maptools.h"
 #include "options/optiondata.h"
 
 #include <QDataStream>
@@ -799,6 +800,40 @@ bool MapAirport::procedure() const
   return flags.testFlag(AP_PROCEDURE);
 }
 
+int MapAirportDiagram::memorySize() const
+{
+  int size = static_cast<int>(sizeof(MapAirportDiagram));
+  size += runways.size() * static_cast<int>(sizeof(MapRunway));
+  size += taxipaths.size() * static_cast<int>(sizeof(MapTaxiPath));
+  size += parkings.size() * static_cast<int>(sizeof(MapParking));
+  size += starts.size() * static_cast<int>(sizeof(MapStart));
+  size += helipads.size() * static_cast<int>(sizeof(MapHelipad));
+
+  // Geometry is the largest part for aprons
+  for(const MapApron& apron : aprons)
+    size += static_cast<int>(sizeof(MapApron)) +
+            apron.vertices.size() * static_cast<int>(sizeof(atools::geo::Pos)) +
+            apron.xplanePath.elementCount() * static_cast<int>(sizeof(QPainterPath::Element));
+  return size;
+}
+
+/* Equirectangular approximation which is sufficient for the small extent of an airport */
+static const double APRON_METER_PER_DEGREE = 111319.49;
+
+QPointF MapApron::toLocal(const atools::geo::Pos& pos) const
+{
+  double cosLat = std::cos(atools::geo::toRadians(static_cast<double>(xplaneReference.getLatY())));
+  return QPointF((pos.getLonX() - xplaneReference.getLonX()) * APRON_METER_PER_DEGREE * cosLat,
+                 (xplaneReference.getLatY() - pos.getLatY()) * APRON_METER_PER_DEGREE);
+}
+
+atools::geo::Pos MapApron::fromLocal(const QPointF& point) const
+{
+  double cosLat = std::cos(atools::geo::toRadians(static_cast<double>(xplaneReference.getLatY())));
+  return atools::geo::Pos(static_cast<float>(xplaneReference.getLonX() + point.x() / (APRON_METER_PER_DEGREE * cosLat)),
+                          static_cast<float>(xplaneReference.getLatY() - point.y() / APRON_METER_PER_DEGREE));
+}
+
 bool MapAirport::anyFuel() const
 {
   return flags.testFlag(AP_AVGAS) || flags.testFlag(AP_JETFUEL);
@@ -1144,9 +1179,31 @@ QString parkingShortName(const QString& name)
     return QString();
 }
 
+void MapSearchResult::addRef(int id, MapObjectTypes type)
+{
+  QSet<int> *ids = nullptr;
+  if(type == map::AIRPORT)
+    ids = &airportIds;
+  else if(type == map::VOR)
+    ids = &vorIds;
+  else if(type == map::NDB)
+    ids = &ndbIds;
+  else if(type == map::WAYPOINT)
+    ids = &waypointIds;
+
+  // Same limit as for the object lists
+  if(ids == nullptr || ids->size() > maptools::MAX_LIST_ENTRIES || ids->contains(id))
+    return;
+
+  refs.append({id, type});
+  ids->insert(id);
+}
+
 bool MapSearchResult::isEmpty(const MapObjectTypes& types) const
 {
   bool filled = false;
+  for(const MapObjectRef& ref : refs)
+    filled |= types & ref.type;
   filled |= types & map::AIRPORT && !airports.isEmpty();
   filled |= types & map::WAYPOINT && !waypoints.isEmpty();
   filled |= types & map::VOR && !vors.isEmpty();
@@ -29,6 +29,7 @@
 #include "fs/common/xpgeometry.h"
 
 #include <QColor>
+#include <QPainterPath>
 #include <QString>
 
 namespace proc {
@@ -244,6 +245,15 @@ struct MapApron
   /* X-Plane complex geometry including curves and holes */
   atools::fs::common::XpGeo geometry;
 
+  /* X-Plane geometry with flattened curves and subtracted holes. Created once when loading.
+   * Coordinates are in meter relative to xplaneReference with x pointing east and y pointing south. */
+  QPainterPath xplanePath;
+  atools::geo::Pos xplaneReference;
+
+  /* Convert between coordinates and the local metric coordinates of xplanePath */
+  QPointF toLocal(const atools::geo::Pos& pos) const;
+  atools::geo::Pos fromLocal(const QPointF& point) const;
+
   QString surface;
   bool drawSurface;
 
@@ -356,6 +366,22 @@ struct MapHelipad
 
 };
 
+/* All objects needed to draw an airport diagram. Loaded in one pass and cached as a unit. */
+struct MapAirportDiagram
+{
+  int airportId = -1;
+  QList<MapRunway> runways; /* Sorted to have the best surfaces last */
+  QList<MapApron> aprons;
+  QList<MapTaxiPath> taxipaths;
+  QList<MapParking> parkings;
+  QList<MapStart> starts;
+  QList<MapHelipad> helipads;
+
+  /* Estimated memory usage in bytes */
+  int memorySize() const;
+
+};
+
 /* VOR station */
 struct MapVor
 {
@@ -635,6 +661,15 @@ struct MapSearchResult
   QList<atools::fs::sc::SimConnectAircraft> aiAircraft;
   atools::fs::sc::SimConnectUserAircraft userAircraft;
 
+  /* If true airports, VOR, NDB and waypoints from the map query caches are not copied into the lists above.
+   * Only id and type are added to refs and the id sets. Use MapScreenIndex::resolveSearchResult to load the
+   * full objects when needed. */
+  bool idsOnly = false;
+  MapObjectRefList refs;
+
+  /* Add reference for id only mode if not already present in the id set for the type */
+  void addRef(int id, map::MapObjectTypes type);
+
   bool isEmpty(const map::MapObjectTypes& types) const;
 
   bool hasVor() const
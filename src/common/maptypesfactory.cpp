@@ -19,11 +19,13 @@
 
 #include <cmath>
 #include "sql/sqlrecord.h"
+#include "sql/sqlquery.h"
 #include "geo/calculations.h"
 #include "common/maptypes.h"
 
 using namespace atools::geo;
 using atools::sql::SqlRecord;
+using atools::sql::SqlQuery;
 using namespace map;
 
 MapTypesFactory::MapTypesFactory()
@@ -36,6 +38,19 @@ MapTypesFactory::~MapTypesFactory()
 
 }
 
+const QString& MapTypesFactory::intern(const QString& str)
+{
+  QSet<QString>::const_iterator it = internedStrings.constFind(str);
+  if(it == internedStrings.constEnd())
+  {
+    if(internedStrings.size() >= MAX_INTERNED_STRINGS)
+      // Sharing is only an optimization - start over
+      internedStrings.clear();
+    it = internedStrings.insert(str);
+  }
+  return *it;
+}
+
 void MapTypesFactory::fillAirport(const SqlRecord& record, map::MapAirport& airport, bool complete, bool nav)
 {
   fillAirportBase(record, airport, complete);
@@ -55,7 +70,7 @@ void MapTypesFactory::fillAirport(const SqlRecord& record, map::MapAirport& airp
     airport.position = Pos(record.valueFloat("lonx"), record.valueFloat("laty"),
                            record.valueFloat("altitude"));
 
-    airport.region = record.valueStr("region", QString());
+    airport.region = intern(record.valueStr("region", QString()));
   }
   else
     airport.position = Pos(record.valueFloat("lonx"), record.valueFloat("laty"), 0.f);
@@ -75,7 +90,7 @@ void MapTypesFactory::fillRunway(const atools::sql::SqlRecord& record, map::MapR
 {
   if(!overview)
   {
-    runway.surface = record.valueStr("surface");
+    runway.surface = intern(record.valueStr("surface"));
     runway.shoulder = record.valueStr("shoulder", QString()); // Optional X-Plane field
     runway.primaryName = record.valueStr("primary_name");
     runway.secondaryName = record.valueStr("secondary_name");
@@ -130,7 +145,7 @@ void MapTypesFactory::fillAirportBase(const SqlRecord& record, map::MapAirport&
   if(complete)
   {
     ap.towerFrequency = record.valueInt("tower_frequency");
-    ap.ident = record.valueStr("ident");
+    ap.ident = intern(record.valueStr("ident"));
     ap.name = record.valueStr("name");
     ap.rating = record.valueInt("rating", -1);
     ap.longestRunwayLength = record.valueInt("longest_runway_length");
@@ -273,12 +288,27 @@ void MapTypesFactory::fillVorFromNav(const SqlRecord& record, map::MapVor& vor)
 void MapTypesFactory::fillVorBase(const SqlRecord& record, map::MapVor& vor)
 {
   vor.id = record.valueInt("vor_id");
-  vor.ident = record.valueStr("ident");
-  vor.region = record.valueStr("region");
+  vor.ident = intern(record.valueStr("ident"));
+  vor.region = intern(record.valueStr("region"));
   vor.name = atools::capString(record.valueStr("name"));
 
+  fillVorType(record.valueStr("type"), vor);
+
+  vor.channel = record.valueStr("channel");
+  vor.frequency = record.valueInt("frequency");
+
+  vor.range = record.valueInt("range");
+  vor.magvar = record.valueFloat("mag_var");
+
+  if(record.isNull("altitude"))
+    vor.position = Pos(record.valueFloat("lonx"), record.valueFloat("laty"), INVALID_ALTITUDE_VALUE);
+  else
+    vor.position = Pos(record.valueFloat("lonx"), record.valueFloat("laty"), record.valueFloat("altitude"));
+}
+
+void MapTypesFactory::fillVorType(const QString& type, map::MapVor& vor)
+{
   // Check also for types from the nav_search table and VORTACs
-  QString type = record.valueStr("type");
   if(type == "VH" || type == "VTH")
     vor.type = "H";
   else if(type == "VL" || type == "VTL")
@@ -290,26 +320,114 @@ void MapTypesFactory::fillVorBase(const SqlRecord& record, map::MapVor& vor)
 
   vor.tacan = type == "TC";
   vor.vortac = type.startsWith("VT");
+}
 
-  vor.channel = record.valueStr("channel");
-  vor.frequency = record.valueInt("frequency");
+void MapTypesFactory::fillVor(SqlQuery *query, VorColumns& columns, map::MapVor& vor)
+{
+  if(columns.id == -1)
+  {
+    SqlRecord rec = query->record();
+    columns.id = rec.indexOf("vor_id");
+    columns.ident = rec.indexOf("ident");
+    columns.region = rec.indexOf("region");
+    columns.name = rec.indexOf("name");
+    columns.type = rec.indexOf("type");
+    columns.channel = rec.indexOf("channel");
+    columns.frequency = rec.indexOf("frequency");
+    columns.range = rec.indexOf("range");
+    columns.magvar = rec.indexOf("mag_var");
+    columns.dmeOnly = rec.indexOf("dme_only");
+    columns.dmeAltitude = rec.indexOf("dme_altitude");
+    columns.altitude = rec.indexOf("altitude");
+    columns.lonx = rec.indexOf("lonx");
+    columns.laty = rec.indexOf("laty");
+  }
 
-  vor.range = record.valueInt("range");
-  vor.magvar = record.valueFloat("mag_var");
+  vor.id = query->value(columns.id).toInt();
+  vor.ident = intern(query->value(columns.ident).toString());
+  vor.region = intern(query->value(columns.region).toString());
+  vor.name = atools::capString(query->value(columns.name).toString());
+  fillVorType(query->value(columns.type).toString(), vor);
 
-  if(record.isNull("altitude"))
-    vor.position = Pos(record.valueFloat("lonx"), record.valueFloat("laty"), INVALID_ALTITUDE_VALUE);
-  else
-    vor.position = Pos(record.valueFloat("lonx"), record.valueFloat("laty"), record.valueFloat("altitude"));
+  vor.channel = query->value(columns.channel).toString();
+  vor.frequency = query->value(columns.frequency).toInt();
+
+  vor.range = query->value(columns.range).toInt();
+  vor.magvar = query->value(columns.magvar).toFloat();
+
+  QVariant altitude = query->value(columns.altitude);
+  vor.position = Pos(query->value(columns.lonx).toFloat(), query->value(columns.laty).toFloat(),
+                     altitude.isNull() ? INVALID_ALTITUDE_VALUE : altitude.toFloat());
+
+  vor.dmeOnly = query->value(columns.dmeOnly).toInt() > 0;
+  vor.hasDme = !query->value(columns.dmeAltitude).isNull();
+}
+
+void MapTypesFactory::fillNdb(SqlQuery *query, NdbColumns& columns, map::MapNdb& ndb)
+{
+  if(columns.id == -1)
+  {
+    SqlRecord rec = query->record();
+    columns.id = rec.indexOf("ndb_id");
+    columns.ident = rec.indexOf("ident");
+    columns.region = rec.indexOf("region");
+    columns.name = rec.indexOf("name");
+    columns.type = rec.indexOf("type");
+    columns.frequency = rec.indexOf("frequency");
+    columns.range = rec.indexOf("range");
+    columns.magvar = rec.indexOf("mag_var");
+    columns.altitude = rec.indexOf("altitude");
+    columns.lonx = rec.indexOf("lonx");
+    columns.laty = rec.indexOf("laty");
+  }
+
+  ndb.id = query->value(columns.id).toInt();
+  ndb.ident = intern(query->value(columns.ident).toString());
+  ndb.region = intern(query->value(columns.region).toString());
+  ndb.name = atools::capString(query->value(columns.name).toString());
+  ndb.type = intern(query->value(columns.type).toString());
+  ndb.frequency = query->value(columns.frequency).toInt();
+  ndb.range = query->value(columns.range).toInt();
+  ndb.magvar = query->value(columns.magvar).toFloat();
+
+  QVariant altitude = query->value(columns.altitude);
+  ndb.position = Pos(query->value(columns.lonx).toFloat(), query->value(columns.laty).toFloat(),
+                     altitude.isNull() ? INVALID_ALTITUDE_VALUE : altitude.toFloat());
+}
+
+void MapTypesFactory::fillWaypoint(SqlQuery *query, WaypointColumns& columns, map::MapWaypoint& waypoint)
+{
+  if(columns.id == -1)
+  {
+    SqlRecord rec = query->record();
+    columns.id = rec.indexOf("waypoint_id");
+    columns.ident = rec.indexOf("ident");
+    columns.region = rec.indexOf("region");
+    columns.type = rec.indexOf("type");
+    columns.numVictorAirway = rec.indexOf("num_victor_airway");
+    columns.numJetAirway = rec.indexOf("num_jet_airway");
+    columns.magvar = rec.indexOf("mag_var");
+    columns.lonx = rec.indexOf("lonx");
+    columns.laty = rec.indexOf("laty");
+  }
+
+  waypoint.id = query->value(columns.id).toInt();
+  waypoint.ident = intern(query->value(columns.ident).toString());
+  waypoint.region = intern(query->value(columns.region).toString());
+  waypoint.type = intern(query->value(columns.type).toString());
+  waypoint.magvar = query->value(columns.magvar).toFloat();
+  waypoint.hasVictorAirways = query->value(columns.numVictorAirway).toInt() > 0;
+  waypoint.hasJetAirways = query->value(columns.numJetAirway).toInt() > 0;
+  waypoint.position = Pos(query->value(columns.lonx).toFloat(), query->value(columns.laty).toFloat());
 }
 
 void MapTypesFactory::fillNdb(const SqlRecord& record, map::MapNdb& ndb)
 {
   ndb.id = record.valueInt("ndb_id");
-  ndb.ident = record.valueStr("ident");
-  ndb.region = record.valueStr("region");
+  ndb.ident = intern(record.valueStr("ident"));
+  ndb.region = intern(record.valueStr("region"));
   ndb.name = atools::capString(record.valueStr("name"));
-  ndb.type = record.valueStr("type");
+  ndb.type = intern(record.valueStr("type"));
   ndb.frequency = record.valueInt("frequency");
   ndb.range = record.valueInt("range");
   ndb.magvar = record.valueFloat("mag_var");
@@ -342,10 +460,10 @@ void MapTypesFactory::fillHelipad(const SqlRecord& record, map::MapHelipad& heli
 void MapTypesFactory::fillWaypoint(const SqlRecord& record, map::MapWaypoint& waypoint)
 {
   waypoint.id = record.valueInt("waypoint_id");
-  waypoint.ident = record.valueStr("ident");
-  waypoint.region = record.valueStr("region");
+  waypoint.ident = intern(record.valueStr("ident"));
+  waypoint.region = intern(record.valueStr("region"));
   // waypoint.airportIdent = record.valueStr("region");
-  waypoint.type = record.valueStr("type");
+  waypoint.type = intern(record.valueStr("type"));
   waypoint.magvar = record.valueFloat("mag_var");
   waypoint.hasVictorAirways = record.valueInt("num_victor_airway") > 0;
   waypoint.hasJetAirways = record.valueInt("num_jet_airway") > 0;
@@ -355,9 +473,9 @@ void MapTypesFactory::fillWaypoint(const SqlRecord& record, map::MapWaypoint& wa
 void MapTypesFactory::fillWaypointFromNav(const SqlRecord& record, map::MapWaypoint& waypoint)
 {
   waypoint.id = record.valueInt("waypoint_id");
-  waypoint.ident = record.valueStr("ident");
-  waypoint.region = record.valueStr("region");
-  waypoint.type = record.valueStr("type");
+  waypoint.ident = intern(record.valueStr("ident"));
+  waypoint.region = intern(record.valueStr("region"));
+  waypoint.type = intern(record.valueStr("type"));
   waypoint.magvar = record.valueFloat("mag_var");
   waypoint.hasVictorAirways = record.valueInt("waypoint_num_victor_airway") > 0;
   waypoint.hasJetAirways = record.valueInt("waypoint_num_jet_airway") > 0;
@@ -368,7 +486,7 @@ void MapTypesFactory::fillAirway(const SqlRecord& record, map::MapAirway& airway
 {
   airway.id = record.valueInt("airway_id");
   airway.type = airwayTypeFromString(record.valueStr("airway_type"));
-  airway.name = record.valueStr("airway_name");
+  airway.name = intern(record.valueStr("airway_name"));
   airway.minAltitude = record.valueInt("minimum_altitude");
 
   if(record.contains("maximum_altitude"))
@@ -405,7 +523,7 @@ void MapTypesFactory::fillAirway(const SqlRecord& record, map::MapAirway& airway
 void MapTypesFactory::fillMarker(const SqlRecord& record, map::MapMarker& marker)
 {
   marker.id = record.valueInt("marker_id");
-  marker.type = record.valueStr("type");
+  marker.type = intern(record.valueStr("type"));
   marker.ident = record.valueStr("ident");
   marker.heading = static_cast<int>(std::round(record.valueFloat("heading")));
   marker.position = Pos(record.valueFloat("lonx"),
@@ -415,9 +533,9 @@ void MapTypesFactory::fillMarker(const SqlRecord& record, map::MapMarker& marker
 void MapTypesFactory::fillIls(const SqlRecord& record, map::MapIls& ils)
 {
   ils.id = record.valueInt("ils_id");
-  ils.ident = record.valueStr("ident");
+  ils.ident = intern(record.valueStr("ident"));
   ils.name = record.valueStr("name");
-  ils.region = record.valueStr("region", QString());
+  ils.region = intern(record.valueStr("region", QString()));
   ils.heading = record.valueFloat("loc_heading");
   ils.width = record.isNull("loc_width") ? INVALID_COURSE_VALUE : record.valueFloat("loc_width");
   ils.magvar = record.valueFloat("mag_var");
@@ -442,7 +560,7 @@ void MapTypesFactory::fillParking(const SqlRecord& record, map::MapParking& park
 {
   parking.id = record.valueInt("parking_id");
   parking.airportId = record.valueInt("airport_id");
-  parking.type = record.valueStr("type");
+  parking.type = intern(record.valueStr("type"));
   parking.name = record.valueStr("name");
   parking.airlineCodes = record.valueStr("airline_codes");
 
@@ -20,10 +20,13 @@
 
 #include "common/mapflags.h"
 
+#include <QSet>
+
 namespace atools {
 namespace sql {
 
 class SqlRecord;
+class SqlQuery;
 }
 }
 
@@ -54,6 +57,27 @@ public:
   MapTypesFactory();
   ~MapTypesFactory();
 
+  /* Column indexes of a prepared query for the fill methods taking a query. Resolved by name from the first row.
+   * Objects are then filled by index directly from the current query row without creating a SqlRecord and
+   * looking up each column by name. Reset by assigning a default object when the query is prepared again. */
+  struct WaypointColumns
+  {
+    int id = -1, ident = -1, region = -1, type = -1, numVictorAirway = -1, numJetAirway = -1, magvar = -1,
+        lonx = -1, laty = -1;
+  };
+
+  struct VorColumns
+  {
+    int id = -1, ident = -1, region = -1, name = -1, type = -1, channel = -1, frequency = -1, range = -1,
+        magvar = -1, dmeOnly = -1, dmeAltitude = -1, altitude = -1, lonx = -1, laty = -1;
+  };
+
+  struct NdbColumns
+  {
+    int id = -1, ident = -1, region = -1, name = -1, type = -1, frequency = -1, range = -1, magvar = -1,
+        altitude = -1, lonx = -1, laty = -1;
+  };
+
   /*
    * Populate airport object.
    * @param complete if false only id and position are present in the record. Used for creating the object
@@ -79,6 +103,12 @@ public:
   void fillWaypoint(const atools::sql::SqlRecord& record, map::MapWaypoint& waypoint);
   void fillWaypointFromNav(const atools::sql::SqlRecord& record, map::MapWaypoint& waypoint);
 
+  /* Fill from the current row of a query using column indexes. Same result as the methods above.
+   * columns are resolved on first call. */
+  void fillVor(atools::sql::SqlQuery *query, VorColumns& columns, map::MapVor& vor);
+  void fillNdb(atools::sql::SqlQuery *query, NdbColumns& columns, map::MapNdb& ndb);
+  void fillWaypoint(atools::sql::SqlQuery *query, WaypointColumns& columns, map::MapWaypoint& waypoint);
+
   void fillAirway(const atools::sql::SqlRecord& record, map::MapAirway& airway);
   void fillMarker(const atools::sql::SqlRecord& record, map::MapMarker& marker);
   void fillIls(const atools::sql::SqlRecord& record, map::MapIls& ils);
@@ -90,15 +120,34 @@ public:
 
   void fillHelipad(const atools::sql::SqlRecord& record, map::MapHelipad& helipad);
 
+  /* Clear the table of shared strings. Call when the database changes. */
+  void clearInternedStrings()
+  {
+    internedStrings.clear();
+  }
+
 private:
+  /* Get a shared copy of the string from the table. Identical idents, regions and types of all objects
+   * share one allocation which reduces heap usage and makes comparisons fast since QString compares
+   * the data pointers first. */
+  const QString& intern(const QString& str);
+
+  /* Table is cleared when reaching this size to limit memory */
+  static Q_DECL_CONSTEXPR int MAX_INTERNED_STRINGS = 50000;
+
   void fillVorBase(const atools::sql::SqlRecord& record, map::MapVor& vor);
 
+  /* Set type, TACAN and VORTAC flags from the type column */
+  static void fillVorType(const QString& type, map::MapVor& vor);
+
   void fillAirportBase(const atools::sql::SqlRecord& record, map::MapAirport& ap, bool complete);
 
   map::MapAirportFlags airportFlag(const atools::sql::SqlRecord& record, const QString& field,
                                    map::MapAirportFlags airportFlag);
   map::MapAirportFlags fillAirportFlags(const atools::sql::SqlRecord& record, bool overview);
 
+  QSet<QString> internedStrings;
+
 };
 
 #endif // LITTLENAVMAP_MAPTYPESFACTORY_H
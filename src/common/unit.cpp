@@ -21,6 +21,14 @@
 
 #include "geo/pos.h"
 
+#include <QElapsedTimer>
+#include <QVector>
+#include <QHash>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <cmath>
+
 const static QString COORDS_DEC_FORMAT("%L1° %L2 %L3° %L4");
 const static QString COORDS_DM_FORMAT("%L1° %L2' %L3 %L4° %L5' %L6");
 const static QString COORDS_DMS_FORMAT("%L1° %L2' %L3\" %L4 %L5° %L6' %L7\" %L8");
@@ -49,6 +57,42 @@ QString Unit::unitWeightStr;
 QString Unit::unitFfVolStr;
 QString Unit::unitFfWeightStr;
 
+namespace {
+
+/* Key for the formatted string cache. Unit string is identified by address. */
+struct FormatKey
+{
+  const QString *unit;
+  qint32 value;
+  qint8 precision;
+  bool addUnit, narrow;
+
+  bool operator==(const FormatKey& other) const
+  {
+    return unit == other.unit && value == other.value && precision == other.precision &&
+           addUnit == other.addUnit && narrow == other.narrow;
+  }
+
+};
+
+inline uint qHash(const FormatKey& key)
+{
+  return ::qHash(key.value) ^ ::qHash(reinterpret_cast<quintptr>(key.unit)) ^
+         static_cast<uint>(key.precision << 24 | key.addUnit << 28 | key.narrow << 29);
+}
+
+/* Maximum number of cached strings. Cache is cleared if size exceeds this */
+const int MAX_CACHE_SIZE = 50000;
+
+/* Rounded values above this are not cached to avoid overflow of the key */
+const float MAX_CACHE_VALUE = 1.e8f;
+
+/* Formatting is also done in threads, for example for printing */
+QMutex cacheMutex;
+QHash<FormatKey, QString> stringCache;
+
+}
+
 Unit::Unit()
 {
 
@@ -86,6 +130,10 @@ void Unit::init()
     clocale = new QLocale(QLocale::C);
     opts = &OptionData::instance();
     optionsChanged();
+
+#ifdef DEBUG_UNIT_BENCHMARK
+    benchmark();
+#endif
   }
 }
 
@@ -99,6 +147,8 @@ void Unit::deInit()
 
 void Unit::initTranslateableTexts()
 {
+  clearCache();
+
   unitDistStr = Unit::tr("nm");
   unitShortDistStr = Unit::tr("ft");
   unitAltStr = Unit::tr("ft");
@@ -115,10 +165,7 @@ void Unit::initTranslateableTexts()
 QString Unit::distMeter(float value, bool addUnit, int minValPrec, bool narrow)
 {
   float val = distMeterF(value);
-  if(narrow)
-    return u(clocale->toString(val, 'f', val < minValPrec ? 1 : 0), unitDistStr, addUnit, narrow);
-  else
-    return u(locale->toString(val, 'f', val < minValPrec ? 1 : 0), unitDistStr, addUnit, narrow);
+  return uCached(val, val < minValPrec ? 1 : 0, unitDistStr, addUnit, narrow);
 }
 
 QString Unit::distNm(float value, bool addUnit, int minValPrec, bool narrow)
@@ -149,7 +196,7 @@ float Unit::distNmF(float value)
 
 QString Unit::distShortMeter(float value, bool addUnit, bool narrow)
 {
-  return u(distShortMeterF(value), unitShortDistStr, addUnit, narrow);
+  return uCached(distShortMeterF(value), 0, unitShortDistStr, addUnit, narrow);
 }
 
 QString Unit::distShortNm(float value, bool addUnit, bool narrow)
@@ -187,7 +234,7 @@ float Unit::distShortFeetF(float value)
 
 QString Unit::speedKts(float value, bool addUnit)
 {
-  return u(speedKtsF(value), unitSpeedStr, addUnit);
+  return uCached(speedKtsF(value), 0, unitSpeedStr, addUnit, false);
 }
 
 float Unit::speedKtsF(float value)
@@ -208,7 +255,7 @@ float Unit::speedKtsF(float value)
 
 QString Unit::speedMeterPerSec(float value, bool addUnit)
 {
-  return u(speedMeterPerSecF(value), unitSpeedStr, addUnit);
+  return uCached(speedMeterPerSecF(value), 0, unitSpeedStr, addUnit, false);
 }
 
 float Unit::speedMeterPerSecF(float value)
@@ -232,11 +279,10 @@ QString Unit::speedVertFpm(float value, bool addUnit)
   switch(unitVertSpeed)
   {
     case opts::VERT_SPEED_FPM:
-      return locale->toString(value, 'f', 0) + (addUnit ? " " + unitVertSpeedStr : QString());
+      return uCached(value, 0, unitVertSpeedStr, addUnit, false);
 
     case opts::VERT_SPEED_MS:
-      return locale->toString(atools::geo::feetToMeter(value) / 60.f, 'f', 1) +
-             (addUnit ? " " + unitVertSpeedStr : QString());
+      return uCached(atools::geo::feetToMeter(value) / 60.f, 1, unitVertSpeedStr, addUnit, false);
   }
   return QString();
 }
@@ -256,7 +302,7 @@ float Unit::speedVertFpmF(float value)
 
 QString Unit::altMeter(float value, bool addUnit, bool narrow)
 {
-  return u(altMeterF(value), unitAltStr, addUnit, narrow);
+  return uCached(altMeterF(value), 0, unitAltStr, addUnit, narrow);
 }
 
 QString Unit::altFeet(float value, bool addUnit, bool narrow)
@@ -398,8 +444,95 @@ QString Unit::u(float num, const QString& un, bool addUnit, bool narrow)
     return locale->toString(num, 'f', 0) + (addUnit ? " " + un : QString());
 }
 
+QString Unit::uFormat(float num, int precision, const QString& un, bool addUnit, bool narrow)
+{
+  if(narrow)
+    return u(clocale->toString(num, 'f', precision), un, addUnit, narrow);
+  else
+    return u(locale->toString(num, 'f', precision), un, addUnit, narrow);
+}
+
+QString Unit::uCached(float num, int precision, const QString& un, bool addUnit, bool narrow)
+{
+  float scaled = precision > 0 ? num * 10.f : num;
+  if(std::abs(scaled) > MAX_CACHE_VALUE || std::isnan(scaled))
+    return uFormat(num, precision, un, addUnit, narrow);
+
+  // Format the rounded value so that all values mapping to the same key give the same text
+  qint32 rounded = static_cast<qint32>(std::round(scaled));
+  FormatKey key = {&un, rounded, static_cast<qint8>(precision), addUnit, narrow};
+
+  QMutexLocker locker(&cacheMutex);
+  auto it = stringCache.constFind(key);
+  if(it != stringCache.constEnd())
+    return it.value();
+
+  if(stringCache.size() > MAX_CACHE_SIZE)
+    stringCache.clear();
+
+  QString str = uFormat(precision > 0 ? rounded / 10.f : static_cast<float>(rounded), precision, un, addUnit,
+                        narrow);
+  stringCache.insert(key, str);
+  return str;
+}
+
+void Unit::clearCache()
+{
+  QMutexLocker locker(&cacheMutex);
+  stringCache.clear();
+}
+
+void Unit::benchmark()
+{
+  // Typical values of a route table and map labels in meter, feet and knots
+  const int NUM = 20000;
+  QVector<float> distances, altitudes, speeds;
+  for(int i = 0; i < NUM; i++)
+  {
+    distances.append(atools::geo::nmToMeter((i % 500) * 1.37f));
+    altitudes.append((i % 400) * 100.f);
+    speeds.append(100.f + (i % 350));
+  }
+
+  // Repeat like repaints and table updates do
+  QElapsedTimer timer;
+  int length = 0;
+  for(bool cached : {false, true})
+  {
+    clearCache();
+    timer.restart();
+    for(int repeat = 0; repeat < 5; repeat++)
+    {
+      for(int i = 0; i < NUM; i++)
+      {
+        if(cached)
+        {
+          length += distMeter(distances.at(i)).size();
+          length += altFeet(altitudes.at(i)).size();
+          length += speedKts(speeds.at(i)).size();
+          length += distMeter(distances.at(i), true, 20, true).size();
+        }
+        else
+        {
+          float dist = distMeterF(distances.at(i));
+          length += uFormat(dist, dist < 20 ? 1 : 0, unitDistStr, true, false).size();
+          length += u(altFeetF(altitudes.at(i)), unitAltStr, true).size();
+          length += u(speedKtsF(speeds.at(i)), unitSpeedStr, true).size();
+          length += uFormat(dist, dist < 20 ? 1 : 0, unitDistStr, true, true).size();
+        }
+      }
+    }
+    qDebug() << Q_FUNC_INFO << (cached ? "cached" : "uncached") << timer.nsecsElapsed() / 1000 << "us"
+             << "strings" << NUM * 5 * 4;
+  }
+  clearCache();
+  qDebug() << Q_FUNC_INFO << "length" << length;
+}
+
 void Unit::optionsChanged()
 {
+  clearCache();
+
   unitDist = opts->getUnitDist();
   unitShortDist = opts->getUnitShortDist();
   unitAlt = opts->getUnitAlt();
@@ -160,11 +160,22 @@ public:
     return unitShortDist;
   }
 
+  /* Log timing of formatting typical route table and map label values with and without string cache */
+  static void benchmark();
+
 private:
   Unit();
   static QString u(const QString& num, const QString& un, bool addUnit, bool narrow);
   static QString u(float num, const QString& un, bool addUnit, bool narrow = false);
 
+  /* Get formatted number and unit from the cache or create a new entry. Value is rounded to precision before
+   * formatting. un has to be one of the static unit strings since its address is used as key. */
+  static QString uCached(float num, int precision, const QString& un, bool addUnit, bool narrow);
+  static QString uFormat(float num, int precision, const QString& un, bool addUnit, bool narrow);
+
+  /* Clear the string cache. Needed when units, unit names or locale change */
+  static void clearCache();
+
   static const OptionData *opts;
   static QLocale *locale, *clocale;
 
@@ -88,6 +88,12 @@ public:
    */
   QString getVatsimMetar(const QString& airportIcao);
 
+  /* true if NOAA or VATSIM requests are running or queued */
+  bool hasPendingRequests() const
+  {
+    return noaaReply != nullptr || vatsimReply != nullptr || !noaaRequests.isEmpty() || !vatsimRequests.isEmpty();
+  }
+
   /* Does nothing currently */
   void preDatabaseLoad();
 
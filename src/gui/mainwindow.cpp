@@ -40,6 +40,7 @@
 #include "query/mapquery.h"
 #include "query/airportquery.h"
 #include "mapgui/mapwidget.h"
+#include "mapgui/maptileexport.h"
 #include "profile/profilewidget.h"
 #include "route/routecontroller.h"
 #include "gui/filehistoryhandler.h"
@@ -71,6 +72,7 @@
 #include <QDesktopWidget>
 #include <QDir>
 #include <QFileInfoList>
+#include <QInputDialog>
 
 #include "ui_mainwindow.h"
 
@@ -658,6 +660,12 @@ void MainWindow::connectAllSlots()
 
   connect(ui->actionMapSetHome, &QAction::triggered, mapWidget, &MapWidget::changeHome);
 
+  // Repaint map when airport diagrams are loaded in background
+  connect(NavApp::getAirportQuerySim(), &AirportQuery::airportDiagramsLoaded, mapWidget, [this]()
+  {
+    mapWidget->update();
+  });
+
   connect(routeController, &RouteController::showRect, mapWidget, &MapWidget::showRect);
   connect(routeController, &RouteController::showPos, mapWidget, &MapWidget::showPos);
   connect(routeController, &RouteController::changeMark, mapWidget, &MapWidget::changeSearchMark);
@@ -742,6 +750,7 @@ void MainWindow::connectAllSlots()
   connect(ui->actionPrintMap, &QAction::triggered, printSupport, &PrintSupport::printMap);
   connect(ui->actionPrintFlightplan, &QAction::triggered, printSupport, &PrintSupport::printFlightplan);
   connect(ui->actionSaveMapAsImage, &QAction::triggered, this, &MainWindow::mapSaveImage);
+  connect(ui->actionSaveMapAsHighResImage, &QAction::triggered, this, &MainWindow::mapSaveImageHighRes);
 
   // KML actions
   connect(ui->actionLoadKml, &QAction::triggered, this, &MainWindow::kmlOpen);
@@ -822,6 +831,7 @@ void MainWindow::connectAllSlots()
   // Map object/feature display
   connect(ui->actionMapShowCities, &QAction::toggled, this, &MainWindow::updateMapObjectsShown);
   connect(ui->actionMapShowGrid, &QAction::toggled, this, &MainWindow::updateMapObjectsShown);
+  connect(ui->actionMapShowRenderStatistics, &QAction::toggled, this, &MainWindow::updateMapObjectsShown);
   connect(ui->actionMapShowHillshading, &QAction::toggled, this, &MainWindow::updateMapObjectsShown);
   connect(ui->actionMapShowAirports, &QAction::toggled, this, &MainWindow::updateMapObjectsShown);
   connect(ui->actionMapShowSoftAirports, &QAction::toggled, this, &MainWindow::updateMapObjectsShown);
@@ -2025,6 +2035,41 @@ void MainWindow::mapSaveImage()
   }
 }
 
+/* Render map in tiles into an image which is larger than the map window */
+void MainWindow::mapSaveImageHighRes()
+{
+  MapTileExport tileExport(mapWidget);
+
+  bool ok;
+  int scale = QInputDialog::getInt(this, tr("Save Map as High Resolution Image"),
+                                   tr("Scale factor for the current map size of %1 x %2 pixel:").
+                                   arg(mapWidget->width()).arg(mapWidget->height()),
+                                   Settings::instance().valueInt(lnm::MAINWINDOW_HIGHRES_SCALE, 4),
+                                   2, 20, 1, &ok);
+  if(!ok)
+    return;
+
+  Settings::instance().setValue(lnm::MAINWINDOW_HIGHRES_SCALE, scale);
+
+  QString imageFile = dialog->saveFileDialog(
+    tr("Save Map as High Resolution Image"),
+    tr("TIFF Image Files (*.tif *.tiff);;Image Files %1;;All Files (*)").arg(lnm::FILE_PATTERN_IMAGE),
+    "tif", "MainWindow/HighRes",
+    atools::fs::FsPaths::getFilesPath(NavApp::getCurrentSimulatorDb()), tr("Little Navmap Map.tif"));
+
+  if(!imageFile.isEmpty())
+  {
+    if(tileExport.exportImage(imageFile, scale, this))
+    {
+      QSize size = tileExport.getExportSize(scale);
+      setStatusMessage(tr("Map saved as %1 x %2 pixel image.").arg(size.width()).arg(size.height()));
+    }
+    else if(!tileExport.getErrorMessage().isEmpty())
+      QMessageBox::warning(this, QApplication::applicationName(),
+                           tr("Error saving image.\n%1").arg(tileExport.getErrorMessage()));
+  }
+}
+
 /* Selection in flight plan table has changed */
 void MainWindow::routeSelectionChanged(int selected, int total)
 {
@@ -127,6 +127,11 @@ public:
     return weatherReporter;
   }
 
+  PrintSupport *getPrintSupport() const
+  {
+    return printSupport;
+  }
+
   /* Update the window title after switching simulators, flight plan name or change status. */
   void updateWindowTitle();
 
@@ -221,6 +226,7 @@ private:
   void resetMessages();
   void showDatabaseFiles();
   void mapSaveImage();
+  void mapSaveImageHighRes();
   void distanceChanged();
   void showDonationPage();
 
@@ -26,6 +26,7 @@
 #include "gui/widgetstate.h"
 #include "query/mapquery.h"
 #include "query/airportquery.h"
+#include "query/infoquery.h"
 #include "route/route.h"
 #include "settings/settings.h"
 #include "ui_mainwindow.h"
@@ -400,6 +401,9 @@ void InfoController::showInformationInternal(const map::MapSearchResult& result,
     // Remember one airport
     currentSearchResult.airports.append(airport);
 
+    // Load all records needed for the airport tabs at once
+    NavApp::getInfoQuery()->prefetchAirportInformation(airport.id, mapQuery->getAirportNav(airport).id);
+
     updateAirportInternal(true);
 
     html.clear();
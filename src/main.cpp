@@ -37,6 +37,9 @@
 #include "common/maptypes.h"
 #include "common/proctypes.h"
 #include "common/unit.h"
+#include "common/formatter.h"
+#include "mapgui/mapbenchmark.h"
+#include "print/briefingexport.h"
 
 #include <QCommandLineParser>
 #include <QDebug>
@@ -45,6 +48,7 @@
 #include <QStyleFactory>
 #include <QSharedMemory>
 #include <QMessageBox>
+#include <QTimer>
 
 #include <marble/MarbleGlobal.h>
 #include <marble/MarbleDirs.h>
@@ -115,6 +119,38 @@ int main(int argc, char *argv[])
                                       QObject::tr("settings-directory"));
     parser.addOption(settingsDirOpt);
 
+    QCommandLineOption benchmarkOpt({"b", "benchmark"},
+                                    QObject::tr("Run map rendering, query and flight plan calculation benchmark "
+                                                "defined in <benchmark-script> and exit. "
+                                                "Use \"-platform offscreen\" for headless systems."),
+                                    QObject::tr("benchmark-script"));
+    parser.addOption(benchmarkOpt);
+
+    QCommandLineOption benchmarkOutputOpt({"o", "benchmark-output"},
+                                          QObject::tr("Write benchmark results as CSV to <benchmark-output> "
+                                                      "instead of stdout."),
+                                          QObject::tr("benchmark-output"));
+    parser.addOption(benchmarkOutputOpt);
+
+    QCommandLineOption briefingOpt({"f", "briefing"},
+                                   QObject::tr("Create a briefing with map image, HTML and PDF for "
+                                               "<flightplan-file> and exit. Can be given more than once. "
+                                               "Use \"-platform offscreen\" for headless systems."),
+                                   QObject::tr("flightplan-file"));
+    parser.addOption(briefingOpt);
+
+    QCommandLineOption briefingOutputOpt({"d", "briefing-output"},
+                                         QObject::tr("Write briefings into sub directories of "
+                                                     "<briefing-output>. Default is the current directory."),
+                                         QObject::tr("briefing-output"));
+    parser.addOption(briefingOutputOpt);
+
+    QCommandLineOption briefingScaleOpt("briefing-scale",
+                                        QObject::tr("Scale factor for the briefing map image relative to "
+                                                    "the map window size. Default is 2."),
+                                        QObject::tr("briefing-scale"), "2");
+    parser.addOption(briefingScaleOpt);
+
     // Process the actual command line arguments given by the user
     parser.process(*QCoreApplication::instance());
 
@@ -173,6 +209,7 @@ int main(int argc, char *argv[])
 
     /* Avoid static translations and load these dynamically now */
     Unit::initTranslateableTexts();
+    formatter::clearCache();
     map::initTranslateableTexts();
     proc::initTranslateableTexts();
 
@@ -254,6 +291,31 @@ int main(int argc, char *argv[])
       // Hide splash once main window is shown
       NavApp::finishSplashScreen();
 
+      if(parser.isSet(benchmarkOpt))
+      {
+        // Run benchmark after all initialization is done and exit
+        QTimer::singleShot(0, [&mainWindow, &parser, &benchmarkOpt, &benchmarkOutputOpt]() -> void
+        {
+          MapBenchmark benchmark(mainWindow.getMapWidget());
+          bool ok = benchmark.run(parser.value(benchmarkOpt), parser.value(benchmarkOutputOpt));
+          QApplication::exit(ok ? 0 : 1);
+        });
+      }
+      else if(parser.isSet(briefingOpt))
+      {
+        // Create briefings after all initialization is done and exit
+        QTimer::singleShot(0, [&mainWindow, &parser, &briefingOpt, &briefingOutputOpt,
+                               &briefingScaleOpt]() -> void
+        {
+          BriefingExport briefing(&mainWindow);
+          QString outputDir = parser.isSet(briefingOutputOpt) ?
+                              parser.value(briefingOutputOpt) : QDir::currentPath();
+          bool ok = briefing.run(parser.values(briefingOpt), outputDir,
+                                 std::max(1, parser.value(briefingScaleOpt).toInt()));
+          QApplication::exit(ok ? 0 : 1);
+        });
+      }
+
       qDebug() << "Before app.exec()";
       retval = app.exec();
     }
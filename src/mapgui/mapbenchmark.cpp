@@ -0,0 +1,372 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "mapgui/mapbenchmark.h"
+
+#include "navapp.h"
+#include "mapgui/mapwidget.h"
+#include "mapgui/mappaintlayer.h"
+#include "mapgui/mapscreenindex.h"
+#include "query/mapquery.h"
+#include "query/airportquery.h"
+#include "common/maptypesfactory.h"
+#include "route/routefinder.h"
+#include "route/routenetworkairway.h"
+#include "route/routenetworkradio.h"
+#include "sql/sqlquery.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QTextStream>
+#include <QApplication>
+
+#include <marble/ViewportParams.h>
+
+#include <algorithm>
+
+using Marble::GeoDataLatLonBox;
+using atools::sql::SqlQuery;
+
+MapBenchmark::MapBenchmark(MapWidget *mapWidgetParam)
+  : mapWidget(mapWidgetParam)
+{
+
+}
+
+bool MapBenchmark::run(const QString& scriptFile, const QString& outputFile)
+{
+  if(!QFile::exists(scriptFile))
+  {
+    qWarning() << Q_FUNC_INFO << "Benchmark script not found" << scriptFile;
+    return false;
+  }
+
+  QSettings script(scriptFile, QSettings::IniFormat);
+  if(script.status() != QSettings::NoError)
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot read benchmark script" << scriptFile;
+    return false;
+  }
+
+  script.beginGroup("Options");
+  width = script.value("Width", width).toInt();
+  height = script.value("Height", height).toInt();
+  repeat = std::max(1, script.value("Repeat", repeat).toInt());
+  script.endGroup();
+
+  qInfo() << Q_FUNC_INFO << "Running benchmark" << scriptFile << "size" << width << height << "repeat" << repeat;
+
+  // Resize map to requested output size
+  mapWidget->resize(width, height);
+
+  results.clear();
+  runViewports(script);
+  runQueries(script);
+  runRoutes(script);
+  runFactory(script);
+
+  if(outputFile.isEmpty())
+  {
+    QTextStream out(stdout);
+    writeResults(out);
+  }
+  else
+  {
+    QFile file(outputFile);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+      qWarning() << Q_FUNC_INFO << "Cannot open" << outputFile << file.errorString();
+      return false;
+    }
+    QTextStream out(&file);
+    writeResults(out);
+  }
+  return true;
+}
+
+void MapBenchmark::setView(QSettings& script)
+{
+  QString projection = script.value("Projection", "Mercator").toString().toLower();
+  mapWidget->setProjection(projection == "spherical" ? Marble::Spherical : Marble::Mercator);
+
+  QStringList features = script.value("Features",
+                                      "airport,vor,ndb,waypoint,ils,marker,airwayj,airwayv,flightplan").
+                         toString().toLower().split(",", QString::SkipEmptyParts);
+
+  static const QList<std::pair<QString, map::MapObjectTypes> > FEATURES(
+  {
+    {"airport", map::AIRPORT},
+    {"vor", map::VOR},
+    {"ndb", map::NDB},
+    {"waypoint", map::WAYPOINT},
+    {"ils", map::ILS},
+    {"marker", map::MARKER},
+    {"airwayj", map::AIRWAYJ},
+    {"airwayv", map::AIRWAYV},
+    {"airspace", map::AIRSPACE},
+    {"flightplan", map::FLIGHTPLAN}
+  });
+
+  for(const std::pair<QString, map::MapObjectTypes>& feature : FEATURES)
+    mapWidget->setShowMapFeatures(feature.second, features.contains(feature.first.trimmed()));
+
+  mapWidget->setMapDetail(script.value("Detail", 10).toInt());
+  mapWidget->setDistance(script.value("Distance", 100.).toDouble());
+  mapWidget->centerOn(script.value("Lonx", 0.).toDouble(), script.value("Laty", 0.).toDouble(), false);
+}
+
+void MapBenchmark::runViewports(QSettings& script)
+{
+  script.beginGroup("Viewports");
+  for(const QString& name : script.childGroups())
+  {
+    script.beginGroup(name);
+    setView(script);
+    script.endGroup();
+
+    Result result;
+    result.category = "render";
+    result.name = name;
+
+    // First run is done with empty caches
+    NavApp::getMapQuery()->deInitQueries();
+    NavApp::getMapQuery()->initQueries();
+
+    for(int i = 0; i < repeat; i++)
+    {
+      QElapsedTimer timer;
+      timer.start();
+
+      // Renders synchronously using all painters
+      QPixmap pixmap = mapWidget->grab();
+
+      result.timesMs.append(timer.nsecsElapsed() / 1000000.);
+      QApplication::processEvents();
+    }
+    results.append(result);
+  }
+  script.endGroup();
+}
+
+void MapBenchmark::runQueries(QSettings& script)
+{
+  MapQuery *mapQuery = NavApp::getMapQuery();
+
+  script.beginGroup("Queries");
+  for(const QString& name : script.childGroups())
+  {
+    script.beginGroup(name);
+    setView(script);
+    script.endGroup();
+
+    // Render once to update layers and screen index for the view
+    mapWidget->grab();
+
+    const GeoDataLatLonBox rect = mapWidget->viewport()->viewLatLonAltBox();
+    const MapLayer *layer = mapWidget->getPaintLayer()->getMapLayer();
+
+    Result queryResult;
+    queryResult.category = "query";
+    queryResult.name = name;
+
+    for(int i = 0; i < repeat; i++)
+    {
+      // Clear caches to measure database access
+      mapQuery->deInitQueries();
+      mapQuery->initQueries();
+
+      QElapsedTimer timer;
+      timer.start();
+      int objects = mapQuery->getAirports(rect, layer, false)->size();
+      objects += mapQuery->getVors(rect, layer, false)->size();
+      objects += mapQuery->getNdbs(rect, layer, false)->size();
+      objects += mapQuery->getWaypoints(rect, layer, false)->size();
+      objects += mapQuery->getAirways(rect, layer, false)->size();
+      queryResult.timesMs.append(timer.nsecsElapsed() / 1000000.);
+      queryResult.objects = objects;
+    }
+    results.append(queryResult);
+
+    // Lookup on a grid of screen positions like mouse movements do
+    Result indexResult;
+    indexResult.category = "screenindex";
+    indexResult.name = name;
+    MapScreenIndex *screenIndex = mapWidget->getScreenIndex();
+    for(int i = 0; i < repeat; i++)
+    {
+      int objects = 0;
+      QElapsedTimer timer;
+      timer.start();
+      for(int y = 0; y < height; y += 20)
+      {
+        for(int x = 0; x < width; x += 20)
+        {
+          map::MapSearchResult nearest;
+          QList<proc::MapProcedurePoint> procPoints;
+          screenIndex->getAllNearest(x, y, 10, nearest, procPoints);
+          objects += nearest.airports.size() + nearest.vors.size() + nearest.ndbs.size() +
+                     nearest.waypoints.size() + nearest.airways.size();
+        }
+      }
+      indexResult.timesMs.append(timer.nsecsElapsed() / 1000000.);
+      indexResult.objects = objects;
+    }
+    results.append(indexResult);
+  }
+  script.endGroup();
+}
+
+void MapBenchmark::runRoutes(QSettings& script)
+{
+  RouteNetworkAirway networkAirway(NavApp::getDatabaseNav());
+  RouteNetworkRadio networkRadio(NavApp::getDatabaseNav());
+
+  script.beginGroup("Routes");
+  for(const QString& name : script.childGroups())
+  {
+    script.beginGroup(name);
+    QString mode = script.value("Mode", "jet").toString().toLower();
+    int altitude = script.value("Altitude", 0).toInt();
+    map::MapAirport from, to;
+    NavApp::getAirportQueryNav()->getAirportByIdent(from, script.value("From").toString().toUpper());
+    NavApp::getAirportQueryNav()->getAirportByIdent(to, script.value("To").toString().toUpper());
+    script.endGroup();
+
+    if(!from.isValid() || !to.isValid())
+    {
+      qWarning() << Q_FUNC_INFO << "Airports not found for" << name;
+      continue;
+    }
+
+    RouteNetwork *network = &networkAirway;
+    if(mode == "radio")
+    {
+      network = &networkRadio;
+      network->setMode(nw::ROUTE_RADIONAV);
+    }
+    else if(mode == "victor")
+      network->setMode(nw::ROUTE_VICTOR);
+    else if(mode == "both")
+      network->setMode(nw::ROUTE_VICTOR | nw::ROUTE_JET);
+    else
+      network->setMode(nw::ROUTE_JET);
+
+    Result result;
+    result.category = "route";
+    result.name = name;
+
+    for(int i = 0; i < repeat; i++)
+    {
+      QElapsedTimer timer;
+      timer.start();
+
+      RouteFinder routeFinder(network);
+      if(routeFinder.calculateRoute(from.position, to.position, mode == "both" ? altitude : 0))
+      {
+        QVector<rf::RouteEntry> route;
+        float distanceMeter = 0.f;
+        routeFinder.extractRoute(route, distanceMeter);
+        result.objects = route.size();
+      }
+      result.timesMs.append(timer.nsecsElapsed() / 1000000.);
+    }
+    results.append(result);
+  }
+  script.endGroup();
+}
+
+void MapBenchmark::runFactory(QSettings& script)
+{
+  script.beginGroup("Factory");
+  int numWaypoints = script.value("Waypoints", 0).toInt();
+  script.endGroup();
+
+  if(numWaypoints <= 0)
+    return;
+
+  MapTypesFactory factory;
+  SqlQuery query(NavApp::getDatabaseNav());
+  query.prepare("select waypoint_id, ident, region, type, num_victor_airway, num_jet_airway, mag_var, lonx, laty "
+                "from waypoint limit :num");
+  query.bindValue(":num", numWaypoints);
+
+  Result recordResult;
+  recordResult.category = "factory";
+  recordResult.name = "waypoint record";
+
+  Result columnResult;
+  columnResult.category = "factory";
+  columnResult.name = "waypoint columns";
+
+  for(int i = 0; i < repeat; i++)
+  {
+    // Fill by name from a record created for each row
+    QList<map::MapWaypoint> waypoints;
+    waypoints.reserve(numWaypoints);
+    query.exec();
+    QElapsedTimer timer;
+    timer.start();
+    while(query.next())
+    {
+      map::MapWaypoint wp;
+      factory.fillWaypoint(query.record(), wp);
+      waypoints.append(wp);
+    }
+    recordResult.timesMs.append(timer.nsecsElapsed() / 1000000.);
+    recordResult.objects = waypoints.size();
+
+    // Fill by column index directly from the query
+    waypoints.clear();
+    MapTypesFactory::WaypointColumns columns;
+    query.exec();
+    timer.start();
+    while(query.next())
+    {
+      map::MapWaypoint wp;
+      factory.fillWaypoint(&query, columns, wp);
+      waypoints.append(wp);
+    }
+    columnResult.timesMs.append(timer.nsecsElapsed() / 1000000.);
+    columnResult.objects = waypoints.size();
+  }
+  results.append(recordResult);
+  results.append(columnResult);
+}
+
+void MapBenchmark::writeResults(QTextStream& out) const
+{
+  out << "category;name;runs;first_ms;min_ms;max_ms;avg_ms;objects;revision" << endl;
+
+  for(const Result& result : results)
+  {
+    if(result.timesMs.isEmpty())
+      continue;
+
+    double sum = 0.;
+    for(double time : result.timesMs)
+      sum += time;
+
+    out << result.category << ";" << result.name << ";" << result.timesMs.size() << ";"
+        << QString::number(result.timesMs.first(), 'f', 3) << ";"
+        << QString::number(*std::min_element(result.timesMs.begin(), result.timesMs.end()), 'f', 3) << ";"
+        << QString::number(*std::max_element(result.timesMs.begin(), result.timesMs.end()), 'f', 3) << ";"
+        << QString::number(sum / result.timesMs.size(), 'f', 3) << ";"
+        << result.objects << ";" << GIT_REVISION << endl;
+  }
+}
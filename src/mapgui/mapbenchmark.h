@@ -0,0 +1,96 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_MAPBENCHMARK_H
+#define LITTLENAVMAP_MAPBENCHMARK_H
+
+#include <QCoreApplication>
+#include <QVector>
+
+class MapWidget;
+class QSettings;
+class QTextStream;
+
+/*
+ * Runs a scripted set of map renderings, map queries and flight plan calculations using the currently
+ * loaded scenery database and writes timings as CSV. Started by the command line option "--benchmark".
+ *
+ * Rendering is done through the real map widget and all painters. Use "-platform offscreen" to run it
+ * on a headless machine.
+ *
+ * The script is an INI file with the following groups. Each child group defines one scenario:
+ *
+ * [Options]
+ * Width=1600                       Map size in pixel
+ * Height=1000
+ * Repeat=5                         Number of runs for each scenario
+ *
+ * [Viewports/Frankfurt]            Rendering of the whole map
+ * Lonx=8.57
+ * Laty=50.03
+ * Distance=50                      Zoom distance in km
+ * Projection=Mercator              Mercator or Spherical
+ * Detail=10                        Map detail factor 5-15
+ * Features=airport,vor,ndb,waypoint,ils,marker,airwayj,airwayv,airspace,flightplan
+ *
+ * [Queries/Europe]                 Map queries and screen index lookups for a view (same keys as viewports)
+ *
+ * [Routes/EDDF-LIRF]               Flight plan calculation between two airports
+ * From=EDDF
+ * To=LIRF
+ * Mode=jet                         jet, victor, both or radio
+ * Altitude=0                       Altitude for mode both in feet
+ *
+ * [Factory]                        Filling of map objects from the database by record and by column index
+ * Waypoints=50000                  Number of waypoints to read
+ */
+class MapBenchmark
+{
+  Q_DECLARE_TR_FUNCTIONS(MapBenchmark)
+
+public:
+  MapBenchmark(MapWidget *mapWidgetParam);
+
+  /* Run all scenarios from the script file and write results to outputFile or stdout if empty.
+   * Returns false if the script could not be read or output could not be written. */
+  bool run(const QString& scriptFile, const QString& outputFile);
+
+private:
+  /* Timing results of one scenario in milliseconds */
+  struct Result
+  {
+    QString category, name;
+    QVector<double> timesMs;
+    int objects = 0;
+  };
+
+  void runViewports(QSettings& script);
+  void runQueries(QSettings& script);
+  void runRoutes(QSettings& script);
+  void runFactory(QSettings& script);
+
+  /* Set map view from the current script group */
+  void setView(QSettings& script);
+
+  void writeResults(QTextStream& out) const;
+
+  QVector<Result> results;
+  MapWidget *mapWidget;
+  int width = 1600, height = 1000, repeat = 5;
+};
+
+#endif // LITTLENAVMAP_MAPBENCHMARK_H
@@ -36,7 +36,20 @@ void MapLayerSettings::finishAppend()
   std::sort(layers.begin(), layers.end());
 }
 
-const MapLayer *MapLayerSettings::getLayer(float distance, int detailFactor) const
+const MapLayer *MapLayerSettings::getLayer(float distance, int detailFactor, const MapLayer *lastLayer) const
+{
+  const MapLayer *layer = getLayerInternal(distance, detailFactor);
+
+  if(lastLayer != nullptr && layer != lastLayer &&
+     (getLayerInternal(distance * (1.f - LAYER_HYSTERESIS), detailFactor) == lastLayer ||
+      getLayerInternal(distance * (1.f + LAYER_HYSTERESIS), detailFactor) == lastLayer))
+    // Still close to the range of the last layer - keep it
+    return lastLayer;
+
+  return layer;
+}
+
+const MapLayer *MapLayerSettings::getLayerInternal(float distance, int detailFactor) const
 {
   using namespace std::placeholders;
 
@@ -40,12 +40,20 @@ public:
   static Q_DECL_CONSTEXPR int MAP_MAX_DETAIL_FACTOR = 15;
   static Q_DECL_CONSTEXPR int MAP_MIN_DETAIL_FACTOR = 5;
 
-  /* Get a layer for current zoom distance and detail factor */
-  const MapLayer *getLayer(float distance, int detailFactor = MAP_DEFAULT_DETAIL_FACTOR) const;
+  /* Get a layer for current zoom distance and detail factor. If lastLayer is given it is kept as long as the
+   * distance is within LAYER_HYSTERESIS of its range. This avoids switching layers and reloading caches
+   * when zooming back and forth across a layer boundary. */
+  const MapLayer *getLayer(float distance, int detailFactor = MAP_DEFAULT_DETAIL_FACTOR,
+                           const MapLayer *lastLayer = nullptr) const;
+
+  /* Relative distance tolerance before leaving the last layer */
+  static Q_DECL_CONSTEXPR float LAYER_HYSTERESIS = 0.1f;
 
 private:
   friend QDebug operator<<(QDebug out, const MapLayerSettings& record);
 
+  const MapLayer *getLayerInternal(float distance, int detailFactor) const;
+
   bool compare(const MapLayer& layer, float distance) const;
 
   QList<MapLayer> layers;
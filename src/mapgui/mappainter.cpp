@@ -22,6 +22,7 @@
 #include "common/symbolpainter.h"
 #include "geo/calculations.h"
 #include "mapgui/mapwidget.h"
+#include "geo/linestring.h"
 
 #include <marble/GeoDataLineString.h>
 #include <marble/GeoPainter.h>
@@ -53,12 +54,25 @@ void PaintContext::szFont(float scale) const
 }
 
 // =================================================
+uint qHash(const MapPainter::TessellationKey& key)
+{
+  return ::qHash(key.lonX) ^ ::qHash(key.latY) ^ ::qHash(key.value1) ^ ::qHash(key.value2) ^
+         ::qHash(key.numPoints) ^ ::qHash(key.circle);
+}
+
+bool MapPainter::TessellationKey::operator==(const MapPainter::TessellationKey& other) const
+{
+  return circle == other.circle && lonX == other.lonX && latY == other.latY &&
+         value1 == other.value1 && value2 == other.value2 && numPoints == other.numPoints;
+}
+
 MapPainter::MapPainter(MapWidget *parentMapWidget, MapScale *mapScale)
   : CoordinateConverter(parentMapWidget->viewport()), mapWidget(parentMapWidget), scale(mapScale)
 {
   mapQuery = NavApp::getMapQuery();
   airportQuery = NavApp::getAirportQuerySim();
   symbolPainter = new SymbolPainter();
+  tessellationCache.setMaxCost(TESSELLATION_CACHE_SIZE);
 }
 
 MapPainter::~MapPainter()
@@ -75,8 +89,6 @@ void MapPainter::paintCircle(GeoPainter *painter, const Pos& centerPos, int radi
   int pixel = scale->getPixelIntForMeter(nmToMeter(radiusNm));
   int numPoints = std::min(std::max(pixel / (fast ? 20 : 2), CIRCLE_MIN_POINTS), CIRCLE_MAX_POINTS);
 
-  int radiusMeter = nmToMeter(radiusNm);
-
   int step = 360 / numPoints;
   int x1, y1, x2 = -1, y2 = -1;
   xtext = -1;
@@ -85,8 +97,10 @@ void MapPainter::paintCircle(GeoPainter *painter, const Pos& centerPos, int radi
   QVector<int> xtexts;
   QVector<int> ytexts;
 
+  const LineString *circle = circleFromCache(centerPos, radiusNm, step);
+
   // Use north endpoint of radius as start position
-  Pos startPoint = centerPos.endpoint(radiusMeter, 0).normalize();
+  Pos startPoint = circle->first();
   Pos p1 = startPoint;
   bool hidden1 = true, hidden2 = true;
   bool visible1 = wToS(p1, x1, y1, DEFAULT_WTOS_SIZE, &hidden1);
@@ -95,10 +109,10 @@ void MapPainter::paintCircle(GeoPainter *painter, const Pos& centerPos, int radi
   GeoDataLineString ellipse;
   ellipse.setTessellate(true);
   // Draw ring segments and collect potential text positions
-  for(int i = 0; i <= 360; i += step)
+  for(int i = 1; i < circle->size(); i++)
   {
     // Line segment from p1 to p2
-    Pos p2 = centerPos.endpoint(radiusMeter, i).normalize();
+    Pos p2 = circle->at(i);
 
     bool visible2 = wToS(p2, x2, y2, DEFAULT_WTOS_SIZE, &hidden2);
 
@@ -167,6 +181,48 @@ void MapPainter::paintCircle(GeoPainter *painter, const Pos& centerPos, int radi
   }
 }
 
+const LineString *MapPainter::circleFromCache(const Pos& centerPos, int radiusNm, int step)
+{
+  TessellationKey key = {true, centerPos.getLonX(), centerPos.getLatY(), static_cast<float>(radiusNm), 0.f, step};
+
+  LineString *circle = tessellationCache.object(key);
+  if(circle == nullptr)
+  {
+    int radiusMeter = nmToMeter(radiusNm);
+    circle = new LineString;
+
+    // First point is north and repeated at angle 0
+    circle->append(centerPos.endpoint(radiusMeter, 0).normalize());
+    for(int i = 0; i <= 360; i += step)
+      circle->append(centerPos.endpoint(radiusMeter, i).normalize());
+
+    tessellationCache.insert(key, circle);
+  }
+  return circle;
+}
+
+const LineString *MapPainter::rhumbLineFromCache(const Pos& from, const Pos& to, int numPoints)
+{
+  TessellationKey key = {false, from.getLonX(), from.getLatY(), to.getLonX(), to.getLatY(), numPoints};
+
+  LineString *line = tessellationCache.object(key);
+  if(line == nullptr)
+  {
+    float bearing = from.angleDegToRhumb(to);
+    float distanceMeter = from.distanceMeterToRhumb(to);
+    line = new LineString;
+
+    for(float d = 0.f; d < distanceMeter; d += distanceMeter / numPoints)
+      line->append(from.endpointRhumb(d, bearing));
+
+    // Add rest
+    line->append(from.endpointRhumb(distanceMeter, bearing));
+
+    tessellationCache.insert(key, line);
+  }
+  return line;
+}
+
 void MapPainter::drawLineString(const PaintContext *context, const Marble::GeoDataLineString& linestring)
 {
   GeoDataLineString ls;
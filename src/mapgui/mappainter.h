@@ -26,6 +26,7 @@
 #include <marble/MarbleWidget.h>
 #include <QPen>
 #include <QApplication>
+#include <QCache>
 
 namespace atools {
 namespace geo {
@@ -44,6 +45,7 @@ class MapQuery;
 class AirportQuery;
 class MapScale;
 class MapWidget;
+class QRegion;
 
 /* Struct that is passed on each paint event to all painters */
 struct PaintContext
@@ -62,6 +64,8 @@ struct PaintContext
   atools::geo::Rect viewportRect; /* Rectangle of current viewport */
   opts::MapScrollDetail mapScrollDetail; /* Option that indicates the detail level when drawFast is true */
   QFont defaultFont /* Default widget font */;
+  QRegion *dynamicRegion = nullptr; /* Vehicle painters add the screen area of symbols, labels and the last
+                                     * trail segment if not null */
 
   opts::DisplayOptions dispOpts;
 
@@ -149,12 +153,31 @@ public:
 
   virtual void render(PaintContext *context) = 0;
 
+  /* Key for cached tessellations of circles and rhumb lines */
+  struct TessellationKey
+  {
+    bool operator==(const MapPainter::TessellationKey& other) const;
+
+    bool circle;
+    float lonX, latY; /* Circle center or line start */
+    float value1, value2; /* Circle radius in nm or line end */
+    int numPoints; /* Resolution depending on zoom distance */
+  };
+
 protected:
   /* Draw a circle and return text placement hints (xtext and ytext). Number of points used
    * for the circle depends on the zoom distance */
   void paintCircle(Marble::GeoPainter *painter, const atools::geo::Pos& centerPos,
                    int radiusNm, bool fast, int& xtext, int& ytext);
 
+  /* Get circle points starting and ending at the north point. Points are calculated once for each
+   * center, radius and step size in degree. */
+  const atools::geo::LineString *circleFromCache(const atools::geo::Pos& centerPos, int radiusNm, int step);
+
+  /* Get rhumb line points from start to end split into numPoints segments */
+  const atools::geo::LineString *rhumbLineFromCache(const atools::geo::Pos& from, const atools::geo::Pos& to,
+                                                    int numPoints);
+
   void drawLineString(const PaintContext *context, const Marble::GeoDataLineString& linestring);
   void drawLineString(const PaintContext *context, const atools::geo::LineString& linestring);
   void drawLine(const PaintContext *context, const atools::geo::Line& line);
@@ -174,12 +197,21 @@ protected:
   /* Maximum points to use for a circle */
   const int CIRCLE_MAX_POINTS = 72;
 
+  /* Maximum number of cached circles and rhumb lines */
+  static Q_DECL_CONSTEXPR int TESSELLATION_CACHE_SIZE = 500;
+
   SymbolPainter *symbolPainter;
   MapWidget *mapWidget;
   MapQuery *mapQuery;
   AirportQuery *airportQuery;
   MapScale *scale;
 
+private:
+  /* Caches points for range rings and rhumb lines to avoid trigonometry for each frame */
+  QCache<TessellationKey, atools::geo::LineString> tessellationCache;
+
 };
 
+uint qHash(const MapPainter::TessellationKey& key);
+
 #endif // LITTLENAVMAP_MAPPAINTER_H
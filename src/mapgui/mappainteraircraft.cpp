@@ -23,6 +23,7 @@
 #include "util/paintercontextsaver.h"
 
 #include <marble/GeoPainter.h>
+#include <marble/ViewportParams.h>
 
 using atools::fs::sc::SimConnectAircraft;
 
@@ -73,7 +74,7 @@ void MapPainterAircraft::render(PaintContext *context)
       if(pos.isValid())
       {
         if(context->dOpt(opts::ITEM_USER_AIRCRAFT_WIND_POINTER))
-          paintWindPointer(context, userAircraft, context->painter->device()->width() / 2, 0);
+          paintWindPointer(context, userAircraft, context->viewport->width() / 2, 0);
 
         bool hidden = false;
         float x, y;
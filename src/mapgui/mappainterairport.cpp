@@ -32,6 +32,7 @@
 #include "atools.h"
 
 #include <QElapsedTimer>
+#include <QTransform>
 
 #include <marble/GeoPainter.h>
 #include <marble/ViewportParams.h>
@@ -40,6 +41,9 @@ using namespace Marble;
 using namespace atools::geo;
 using namespace map;
 
+/* Surface and pen width in pixel used to group taxiway lines */
+typedef QPair<QString, int> TaxiStyle;
+
 MapPainterAirport::MapPainterAirport(MapWidget *mapWidget, MapScale *mapScale,
                                      const Route *routeParam)
   : MapPainter(mapWidget, mapScale), route(routeParam)
@@ -123,21 +127,27 @@ void MapPainterAirport::render(PaintContext *context)
     }
   }
 
+  // Diagrams are loaded in background - null for airports which are not loaded yet
+  QVector<const MapAirportDiagram *> diagrams(visibleAirports.size(), nullptr);
   if(context->mapLayerEffective->isAirportDiagram())
   {
-    // In diagram mode draw background first to avoid overwriting other airports
-    for(const MapAirport *airport : visibleAirports)
-      drawAirportDiagramBackround(context, *airport);
-  }
+    for(int i = 0; i < visibleAirports.size(); i++)
+      diagrams[i] = airportQuery->getAirportDiagram(visibleAirports.at(i)->id);
 
-  // Draw the diagrams first
-  for(int i = 0; i < visibleAirports.size(); i++)
-  {
-    const MapAirport *airport = visibleAirports.at(i);
+    // In diagram mode draw background first to avoid overwriting other airports
+    for(const MapAirportDiagram *diagram : diagrams)
+    {
+      if(diagram != nullptr)
+        drawAirportDiagramBackround(context, *diagram);
+    }
 
+    // Draw the diagrams first
     // Airport diagram is not influenced by detail level
-    if(context->mapLayerEffective->isAirportDiagram())
-      drawAirportDiagram(context, *airport);
+    for(int i = 0; i < visibleAirports.size(); i++)
+    {
+      if(diagrams.at(i) != nullptr)
+        drawAirportDiagram(context, *visibleAirports.at(i), *diagrams.at(i));
+    }
   }
 
   // Add airport symbols on top of diagrams
@@ -148,8 +158,8 @@ void MapPainterAirport::render(PaintContext *context)
     const MapLayer *layer = context->mapLayer;
 
     // Airport diagram is not influenced by detail level
-    if(!context->mapLayerEffective->isAirportDiagram())
-      // Draw simplified runway lines
+    if(diagrams.at(i) == nullptr)
+      // Draw simplified runway lines - also as placeholder until the diagram is loaded
       drawAirportSymbolOverview(context, *airport, pt.x(), pt.y());
 
     // More detailed symbol will be drawn by the route painter - so skip here
@@ -182,7 +192,7 @@ void MapPainterAirport::render(PaintContext *context)
 
 /* Draws the full airport diagram including runway, taxiways, apron, parking and more */
 void MapPainterAirport::drawAirportDiagramBackround(const PaintContext *context,
-                                                    const map::MapAirport& airport)
+                                                    const map::MapAirportDiagram& diagram)
 {
   Marble::GeoPainter *painter = context->painter;
   atools::util::PainterContextSaver saver(painter);
@@ -196,7 +206,7 @@ void MapPainterAirport::drawAirportDiagramBackround(const PaintContext *context,
                        Qt::SolidLine, Qt::RoundCap));
 
   // Get all runways for this airport
-  const QList<MapRunway> *runways = airportQuery->getRunways(airport.id);
+  const QList<MapRunway> *runways = &diagram.runways;
 
   // Calculate all runway screen coordinates
   QList<QPoint> runwayCenters;
@@ -218,24 +228,24 @@ void MapPainterAirport::drawAirportDiagramBackround(const PaintContext *context,
     }
 
   // For taxipaths
-  const QList<MapTaxiPath> *taxipaths = airportQuery->getTaxiPaths(airport.id);
-  for(const MapTaxiPath& taxipath : *taxipaths)
+  QVector<QLineF> taxiLines;
+  for(const MapTaxiPath& taxipath : diagram.taxipaths)
   {
     bool visible;
-    QPoint start = wToS(taxipath.start, DEFAULT_WTOS_SIZE, &visible);
-    QPoint end = wToS(taxipath.end, DEFAULT_WTOS_SIZE, &visible);
-    painter->drawLine(start, end);
+    taxiLines.append(QLineF(wToS(taxipath.start, DEFAULT_WTOS_SIZE, &visible),
+                            wToS(taxipath.end, DEFAULT_WTOS_SIZE, &visible)));
   }
+  painter->drawLines(taxiLines);
 
   // For aprons
-  const QList<MapApron> *aprons = airportQuery->getAprons(airport.id);
+  const QList<MapApron> *aprons = &diagram.aprons;
   for(const MapApron& apron : *aprons)
   {
     // FSX/P3D geometry
     if(!apron.vertices.isEmpty())
       drawFsApron(context, apron);
-    if(!apron.geometry.boundary.isEmpty())
-      drawXplaneApron(context, apron, true);
+    if(!apron.xplanePath.isEmpty())
+      drawXplaneApron(context, apron);
   }
 }
 
@@ -249,93 +259,27 @@ void MapPainterAirport::drawFsApron(const PaintContext *context, const map::MapA
   context->painter->QPainter::drawPolygon(apronPoints.data(), apronPoints.size());
 }
 
-/* Draw X-Plane aprons including bezier curves */
-QPainterPath MapPainterAirport::pathForBoundary(const atools::fs::common::Boundary& boundaryNodes, bool fast)
+/* Draw X-Plane aprons using the precomputed path in local coordinates */
+void MapPainterAirport::drawXplaneApron(const PaintContext *context, const map::MapApron& apron)
 {
+  // Build an affine transformation from local apron coordinates to screen using three projected points.
+  // Accurate enough for the small extent of an airport.
   bool visible;
-  QPainterPath apronPath;
-  atools::fs::common::Node lastNode;
+  QPointF origin = wToSF(apron.xplaneReference, DEFAULT_WTOS_SIZE, &visible);
+  QPointF east = wToSF(apron.fromLocal(QPointF(APRON_TRANSFORM_METER, 0.)), DEFAULT_WTOS_SIZE, &visible) - origin;
+  QPointF south = wToSF(apron.fromLocal(QPointF(0., APRON_TRANSFORM_METER)), DEFAULT_WTOS_SIZE, &visible) - origin;
 
-  // Create a copy and close the geometry
-  atools::fs::common::Boundary boundary = boundaryNodes;
+  QTransform transform(east.x() / APRON_TRANSFORM_METER, east.y() / APRON_TRANSFORM_METER,
+                       south.x() / APRON_TRANSFORM_METER, south.y() / APRON_TRANSFORM_METER,
+                       origin.x(), origin.y());
 
-  if(!boundary.isEmpty())
-    boundary.append(boundary.first());
-
-  int i = 0;
-  for(const atools::fs::common::Node& node : boundary)
-  {
-    // QPen pen = painter->pen();
-    // painter->setPen(QPen(QColor(200, 200, 200), 1, Qt::SolidLine, Qt::FlatCap));
-    QPointF lastPt = wToSF(lastNode.node, DEFAULT_WTOS_SIZE, &visible);
-    QPointF pt = wToSF(node.node, DEFAULT_WTOS_SIZE, &visible);
-    // painter->drawEllipse(pt, 5, 5);
-    // painter->drawText(pt, QString("%1").arg(i));
-    // if(node.control.isValid())
-    // {
-    // QPointF ctlpt = wToSF(node.control, DEFAULT_WTOS_SIZE, &visible);
-    // painter->drawEllipse(ctlpt, 5, 2);
-    // painter->drawText(ctlpt + QPointF(0, 10), QString("C_%1").arg(i));
-    // painter->drawEllipse(pt + (pt - ctlpt), 2, 5);
-    // painter->drawText(pt + (pt - ctlpt) + QPointF(0, 10), QString("CX_%1").arg(i));
-    // painter->drawLine(ctlpt, pt + (pt - ctlpt));
-    // }
-    // painter->setPen(pen);
-
-    if(i == 0)
-      // Fist point
-      apronPath.moveTo(wToS(node.node, DEFAULT_WTOS_SIZE, &visible));
-    else if(fast)
-      // Use lines only for fast drawing
-      apronPath.lineTo(pt);
-    else
-    {
-      if(lastNode.control.isValid() && node.control.isValid())
-      {
-        // Two successive control points - use cubic curve
-        QPointF ctlpt = wToSF(lastNode.control, DEFAULT_WTOS_SIZE, &visible);
-        QPointF ctlpt2 = wToSF(node.control, DEFAULT_WTOS_SIZE, &visible);
-        apronPath.cubicTo(ctlpt, pt + (pt - ctlpt2), pt);
-      }
-      else if(lastNode.control.isValid())
-      {
-        // One control point - use quad curve
-        if(lastPt != pt)
-          apronPath.quadTo(wToSF(lastNode.control, DEFAULT_WTOS_SIZE, &visible), pt);
-      }
-      else if(node.control.isValid())
-      {
-        // One control point - use quad curve
-        if(lastPt != pt)
-          apronPath.quadTo(pt + (pt - wToSF(node.control, DEFAULT_WTOS_SIZE, &visible)), pt);
-      }
-      else
-        apronPath.lineTo(pt);
-    }
-
-    lastNode = node;
-    i++;
-  }
-  return apronPath;
-}
-
-void MapPainterAirport::drawXplaneApron(const PaintContext *context, const map::MapApron& apron, bool fast)
-{
-  // Create the apron boundary
-  QPainterPath boundaryPath = pathForBoundary(apron.geometry.boundary, fast);
-
-  if(!fast)
-  {
-    // Substract holes
-    for(atools::fs::common::Boundary hole : apron.geometry.holes)
-      boundaryPath = boundaryPath.subtracted(pathForBoundary(hole, fast));
-  }
-
-  context->painter->drawPath(boundaryPath);
+  // Map the path instead of setting a painter transformation to keep pen width and brush pattern unscaled
+  context->painter->drawPath(transform.map(apron.xplanePath));
 }
 
 /* Draws the full airport diagram including runway, taxiways, apron, parking and more */
-void MapPainterAirport::drawAirportDiagram(const PaintContext *context, const map::MapAirport& airport)
+void MapPainterAirport::drawAirportDiagram(const PaintContext *context, const map::MapAirport& airport,
+                                           const map::MapAirportDiagram& diagram)
 {
   Marble::GeoPainter *painter = context->painter;
   atools::util::PainterContextSaver saver(painter);
@@ -346,7 +290,7 @@ void MapPainterAirport::drawAirportDiagram(const PaintContext *context, const ma
   painter->setFont(context->defaultFont);
 
   // Get all runways for this airport
-  const QList<MapRunway> *runways = airportQuery->getRunways(airport.id);
+  const QList<MapRunway> *runways = &diagram.runways;
 
   // Calculate all runway screen coordinates
   QList<QPoint> runwayCenters;
@@ -373,7 +317,7 @@ void MapPainterAirport::drawAirportDiagram(const PaintContext *context, const ma
 
   // Draw aprons ---------------------------------
   painter->setBackground(Qt::transparent);
-  const QList<MapApron> *aprons = airportQuery->getAprons(airport.id);
+  const QList<MapApron> *aprons = &diagram.aprons;
 
   for(const MapApron& apron : *aprons)
   {
@@ -394,81 +338,76 @@ void MapPainterAirport::drawAirportDiagram(const PaintContext *context, const ma
       drawFsApron(context, apron);
 
     // X-Plane geometry
-    if(!apron.geometry.boundary.isEmpty())
-      drawXplaneApron(context, apron, context->drawFast);
+    if(!apron.xplanePath.isEmpty())
+      drawXplaneApron(context, apron);
   }
 
   // Draw taxiways ---------------------------------
   painter->setBackgroundMode(Qt::OpaqueMode);
-  QVector<QPoint> startPts, endPts;
-  QVector<int> pathThickness;
 
-  // Collect coordinates first
-  const QList<MapTaxiPath> *taxipaths = airportQuery->getTaxiPaths(airport.id);
+  // Lines grouped by pen to reduce the number of pen changes and paint calls
+  // Closed and other taxi paths are drawn first to have real taxiways on top
+  // Use a sorted map to get the same drawing order for overlapping taxiways on each paint
+  QMap<TaxiStyle, QVector<QLineF> > closedLines, transparentLines, surfaceLines;
+  QVector<QLineF> centerLines;
+
+  const QList<MapTaxiPath> *taxipaths = &diagram.taxipaths;
   for(const MapTaxiPath& taxipath : *taxipaths)
   {
+    // Cull against the viewport before doing the expensive projection
+    // Include half the width so that wide taxiways are drawn at the viewport edges
+    float halfWidthMeter = feetToMeter(static_cast<float>(taxipath.width)) / 2.f;
+    Rect taxiRect(taxipath.start, halfWidthMeter);
+    taxiRect.extend(Rect(taxipath.end, halfWidthMeter));
+    if(!context->viewportRect.overlaps(taxiRect))
+      continue;
+
     bool visible;
     // Do not do any clipping here
-    startPts.append(wToS(taxipath.start, DEFAULT_WTOS_SIZE, &visible));
-    endPts.append(wToS(taxipath.end, DEFAULT_WTOS_SIZE, &visible));
+    QLineF line(wToS(taxipath.start, DEFAULT_WTOS_SIZE, &visible), wToS(taxipath.end, DEFAULT_WTOS_SIZE, &visible));
+    centerLines.append(line);
 
     if(taxipath.width == 0)
       // Special X-Plane case - width is not given for path
-      pathThickness.append(0);
+      continue;
+
+    TaxiStyle style(taxipath.surface, std::max(2, scale->getPixelIntForFeet(taxipath.width)));
+    if(taxipath.closed)
+      closedLines[style].append(line);
+    else if(!taxipath.drawSurface)
+      transparentLines[style].append(line);
     else
-      pathThickness.append(std::max(2, scale->getPixelIntForFeet(taxipath.width)));
+      surfaceLines[style].append(line);
   }
 
-  // Draw closed and other taxi paths first to have real taxiways on top
-  for(int i = 0; i < taxipaths->size(); i++)
+  for(auto it = closedLines.constBegin(); it != closedLines.constEnd(); ++it)
   {
-    const MapTaxiPath& taxipath = taxipaths->at(i);
-    int thickness = pathThickness.at(i);
-
-    if(thickness > 0)
-    {
-      QColor col = mapcolors::colorForSurface(taxipath.surface);
-
-      const QPoint& start = startPts.at(i);
-      const QPoint& end = endPts.at(i);
-
-      if(taxipath.closed)
-      {
-        painter->setPen(QPen(col, thickness, Qt::SolidLine, Qt::RoundCap));
-        painter->drawLine(start, end);
+    painter->setPen(QPen(mapcolors::colorForSurface(it.key().first), it.key().second, Qt::SolidLine, Qt::RoundCap));
+    painter->drawLines(it.value());
 
-        painter->setPen(QPen(mapcolors::taxiwayClosedBrush, thickness, Qt::SolidLine, Qt::RoundCap));
-        painter->drawLine(start, end);
+    painter->setPen(QPen(mapcolors::taxiwayClosedBrush, it.key().second, Qt::SolidLine, Qt::RoundCap));
+    painter->drawLines(it.value());
+  }
 
-      }
-      else if(!taxipath.drawSurface)
-      {
-        painter->setPen(QPen(QBrush(col, Qt::Dense4Pattern), thickness, Qt::SolidLine, Qt::RoundCap));
-        painter->drawLine(start, end);
-      }
-    }
+  for(auto it = transparentLines.constBegin(); it != transparentLines.constEnd(); ++it)
+  {
+    painter->setPen(QPen(QBrush(mapcolors::colorForSurface(it.key().first), Qt::Dense4Pattern), it.key().second,
+                         Qt::SolidLine, Qt::RoundCap));
+    painter->drawLines(it.value());
   }
 
   // Draw real taxiways
-  for(int i = 0; i < taxipaths->size(); i++)
+  for(auto it = surfaceLines.constBegin(); it != surfaceLines.constEnd(); ++it)
   {
-    const MapTaxiPath& taxipath = taxipaths->at(i);
-    if(!taxipath.closed && taxipath.drawSurface && pathThickness.at(i) > 0)
-    {
-      painter->setPen(QPen(mapcolors::colorForSurface(taxipath.surface),
-                           pathThickness.at(i), Qt::SolidLine, Qt::RoundCap));
-      painter->drawLine(startPts.at(i), endPts.at(i));
-    }
+    painter->setPen(QPen(mapcolors::colorForSurface(it.key().first), it.key().second, Qt::SolidLine, Qt::RoundCap));
+    painter->drawLines(it.value());
   }
 
   // Draw center lines - also for X-Plane on the pavement
   if(!fast && context->mapLayerEffective->isAirportDiagramDetail())
   {
-    for(int i = 0; i < taxipaths->size(); i++)
-    {
-      painter->setPen(QPen(mapcolors::taxiwayNameBackgroundColor, 1, Qt::DashLine, Qt::RoundCap));
-      painter->drawLine(startPts.at(i), endPts.at(i));
-    }
+    painter->setPen(QPen(mapcolors::taxiwayNameBackgroundColor, 1, Qt::DashLine, Qt::RoundCap));
+    painter->drawLines(centerLines);
   }
 
   // Draw taxiway names ---------------------------------
@@ -659,38 +598,55 @@ void MapPainterAirport::drawAirportDiagram(const PaintContext *context, const ma
   }
 
   // Draw parking --------------------------------
-  const QList<MapParking> *parkings = airportQuery->getParkingsForAirport(airport.id);
-  for(const MapParking& parking : *parkings)
+  // Collect by type to change pen and brush only once for each type
+  // Use a sorted map to get the same drawing order for overlapping spots on each paint
+  QMap<QString, QVector<const MapParking *> > parkingsByType;
+  for(const MapParking& parking : diagram.parkings)
   {
-    bool visible;
-    QPoint pt = wToS(parking.position, DEFAULT_WTOS_SIZE, &visible);
-    if(visible)
-    {
-      // Calculate approximate screen width and height
-      int w = scale->getPixelIntForFeet(parking.radius, 90);
-      int h = scale->getPixelIntForFeet(parking.radius, 0);
+    // Cull by the extent of the spot so that partially visible spots are drawn at the viewport edges
+    if(context->viewportRect.overlaps(Rect(parking.position, feetToMeter(static_cast<float>(parking.radius)))))
+      parkingsByType[parking.type].append(&parking);
+  }
 
-      painter->setPen(QPen(mapcolors::colorOutlineForParkingType(parking.type), 2, Qt::SolidLine, Qt::FlatCap));
-      painter->setBrush(mapcolors::colorForParkingType(parking.type));
-      painter->drawEllipse(pt, w, h);
+  QVector<QLineF> tickLines;
+  for(auto it = parkingsByType.constBegin(); it != parkingsByType.constEnd(); ++it)
+  {
+    painter->setPen(QPen(mapcolors::colorOutlineForParkingType(it.key()), 2, Qt::SolidLine, Qt::FlatCap));
+    painter->setBrush(mapcolors::colorForParkingType(it.key()));
+    tickLines.clear();
 
-      if(!fast)
+    for(const MapParking *parking : it.value())
+    {
+      bool visible;
+      QPoint pt = wToS(parking->position, DEFAULT_WTOS_SIZE, &visible);
+      if(visible)
       {
-        if(parking.jetway)
-          // Draw second ring for jetway
-          painter->drawEllipse(pt, w * 3 / 4, h * 3 / 4);
+        // Calculate approximate screen width and height
+        int w = scale->getPixelIntForFeet(parking->radius, 90);
+        int h = scale->getPixelIntForFeet(parking->radius, 0);
 
-        // Draw heading tick mark
-        painter->translate(pt);
-        painter->rotate(parking.heading);
-        painter->drawLine(0, h * 2 / 3, 0, h);
-        painter->resetTransform();
+        painter->drawEllipse(pt, w, h);
+
+        if(!fast)
+        {
+          if(parking->jetway)
+            // Draw second ring for jetway
+            painter->drawEllipse(pt, w * 3 / 4, h * 3 / 4);
+
+          // Heading tick mark from two thirds to the outer ring
+          double angle = atools::geo::toRadians(static_cast<double>(parking->heading));
+          QPointF dir(-std::sin(angle), std::cos(angle));
+          tickLines.append(QLineF(pt + dir * (h * 2 / 3), pt + dir * h));
+        }
       }
     }
+
+    if(!tickLines.isEmpty())
+      painter->drawLines(tickLines);
   }
 
   // Draw helipads ------------------------------------------------
-  const QList<MapHelipad> *helipads = airportQuery->getHelipads(airport.id);
+  const QList<MapHelipad> *helipads = &diagram.helipads;
   if(!helipads->isEmpty())
   {
     for(const MapHelipad& helipad : *helipads)
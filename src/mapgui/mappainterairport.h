@@ -54,13 +54,14 @@ private:
 
   // void drawWindPointer(const PaintContext *context, const maptypes::MapAirport& ap, int x, int y);
 
-  void drawAirportDiagram(const PaintContext *context, const map::MapAirport& airport);
-  void drawAirportDiagramBackround(const PaintContext *context, const map::MapAirport& airport);
+  void drawAirportDiagram(const PaintContext *context, const map::MapAirport& airport,
+                          const map::MapAirportDiagram& diagram);
+  void drawAirportDiagramBackround(const PaintContext *context, const map::MapAirportDiagram& diagram);
   void drawAirportSymbolOverview(const PaintContext *context, const map::MapAirport& ap, float x, float y);
   void runwayCoords(const QList<map::MapRunway> *runways, QList<QPoint> *centers, QList<QRect> *rects,
                     QList<QRect> *innerRects, QList<QRect> *outlineRects);
   void drawFsApron(const PaintContext *context, const map::MapApron& apron);
-  void drawXplaneApron(const PaintContext *context, const map::MapApron& apron, bool fast);
+  void drawXplaneApron(const PaintContext *context, const map::MapApron& apron);
 
   /* All sizes in pixel */
   static Q_DECL_CONSTEXPR int RUNWAY_HEADING_FONT_SIZE = 12;
@@ -69,11 +70,10 @@ private:
   static Q_DECL_CONSTEXPR int TAXIWAY_TEXT_MIN_LENGTH = 20;
   static Q_DECL_CONSTEXPR int RUNWAY_OVERVIEW_MIN_LENGTH_FEET = 8000;
   static Q_DECL_CONSTEXPR float AIRPORT_DIAGRAM_BACKGROUND_METER = 200.f;
+  /* Distance in meter used to find the screen transformation for local apron coordinates */
+  static Q_DECL_CONSTEXPR double APRON_TRANSFORM_METER = 1000.;
   const Route *route;
 
-  QPainterPath pathForBoundary(const atools::fs::common::Boundary& boundaryNodes,
-                               bool fast);
-
 };
 
 #endif // LITTLENAVMAP_MAPPAINTERAIRPORT_H
@@ -32,6 +32,7 @@
 #include "route/routecontroller.h"
 #include "util/paintercontextsaver.h"
 #include "common/textplacement.h"
+#include "geo/linestring.h"
 
 #include <marble/GeoDataLineString.h>
 #include <marble/GeoPainter.h>
@@ -454,12 +455,11 @@ void MapPainterMark::paintDistanceMarkers(const PaintContext *context)
       int pixel = scale->getPixelIntForMeter(distanceMeter);
       int numPoints = std::min(std::max(pixel / (context->drawFast ? 200 : 20), 4), 72);
 
-      Pos p1 = m.from, p2;
-
       // Draw line segments
-      for(float d = 0.f; d < distanceMeter; d += distanceMeter / numPoints)
+      const LineString *points = rhumbLineFromCache(m.from, m.to, numPoints);
+      Pos p1 = m.from;
+      for(const Pos& p2 : *points)
       {
-        p2 = m.from.endpointRhumb(d, bearing);
         GeoDataLineString line;
         line.append(GeoDataCoordinates(p1.getLonX(), p1.getLatY(), 0, DEG));
         line.append(GeoDataCoordinates(p2.getLonX(), p2.getLatY(), 0, DEG));
@@ -467,13 +467,6 @@ void MapPainterMark::paintDistanceMarkers(const PaintContext *context)
         p1 = p2;
       }
 
-      // Draw rest
-      p2 = m.from.endpointRhumb(distanceMeter, bearing);
-      GeoDataLineString line;
-      line.append(GeoDataCoordinates(p1.getLonX(), p1.getLatY(), 0, DEG));
-      line.append(GeoDataCoordinates(p2.getLonX(), p2.getLatY(), 0, DEG));
-      painter->drawPolyline(line);
-
       // Build and draw text
       QStringList texts;
       if(!m.text.isEmpty())
@@ -25,6 +25,7 @@
 #include "util/paintercontextsaver.h"
 #include "mapgui/maplayer.h"
 #include "query/mapquery.h"
+#include "atools.h"
 
 #include <QElapsedTimer>
 
@@ -104,36 +105,77 @@ void MapPainterNav::render(PaintContext *context)
 }
 
 /* Draw airways and texts */
-void MapPainterNav::paintAirways(PaintContext *context, const QList<MapAirway> *airways, bool fast)
+void MapPainterNav::updateAirwayGroups(PaintContext *context, const QList<MapAirway> *airways)
 {
-  QFontMetrics metrics = context->painter->fontMetrics();
+  bool ident = context->mapLayer->isAirwayIdent(), info = context->mapLayer->isAirwayInfo();
 
-  // Keep text placement information for each airway line which can cover multiple texts/airways
-  struct Place
+  if(airwayGroupGeneration == mapQuery->getAirwayCacheGeneration() &&
+     airwayGroupIdent == ident && airwayGroupInfo == info && airwayTexts.size() == airways->size())
+    return;
+
+  airwayGroupGeneration = mapQuery->getAirwayCacheGeneration();
+  airwayGroupIdent = ident;
+  airwayGroupInfo = info;
+  airwayGroups.clear();
+  airwayTexts.clear();
+  airwayTexts.reserve(airways->size());
+
+  // Key is the ordered pair of waypoint ids and value is index into airwayGroups
+  QHash<QPair<int, int>, int> groupIndex;
+
+  for(int i = 0; i < airways->size(); i++)
   {
-    Place()
+    const MapAirway& airway = airways->at(i);
+
+    QString text;
+    if(ident)
+      text += airway.name;
+
+    if(info)
     {
+      text += QString(tr(" / ")) + map::airwayTypeToShortString(airway.type);
+
+      QString altTxt = map::airwayAltTextShort(airway);
+
+      if(!altTxt.isEmpty())
+        text += QString(tr(" / ")) + altTxt;
     }
+    airwayTexts.append(text);
 
-    Place(const QString& text, int initialIndex, bool reversed)
-      : texts(
+    QPair<int, int> key(std::min(airway.fromWaypointId, airway.toWaypointId),
+                        std::max(airway.fromWaypointId, airway.toWaypointId));
+    int index = groupIndex.value(key, -1);
+    if(index == -1)
     {
-      text
-    }), airwayIndexByText({initialIndex}), positionReversed({reversed})
+      AirwayGroup group;
+      group.airwayIndexes.append(i);
+      group.reversed.append(false);
+      airwayGroups.append(group);
+      groupIndex.insert(key, airwayGroups.size() - 1);
+    }
+    else
     {
+      AirwayGroup& group = airwayGroups[index];
+      group.reversed.append(airway.fromWaypointId != airways->at(group.airwayIndexes.first()).fromWaypointId);
+      group.airwayIndexes.append(i);
     }
+  }
+}
 
+void MapPainterNav::paintAirways(PaintContext *context, const QList<MapAirway> *airways, bool fast)
+{
+  QFontMetrics metrics = context->painter->fontMetrics();
+
+  // Keep text placement information for each airway line which can cover multiple texts/airways
+  struct Place
+  {
     QStringList texts; // Prepared airway texts
     QVector<int> airwayIndexByText; // Index into "airways" for each text
     QVector<bool> positionReversed; // Line is reversed for text
   };
 
-  // Used to combine texts of different airway lines with the same coordinates into one text.
-  // Key is line coordinates as text (avoid floating point compare) and
-  // value is index into texts and airwayIndex
-  QHash<QString, int> lines;
-  // Contains combined text for overlapping airway lines and points to index or airway in airway list
-  QVector<Place> textlist;
+  // Airways which were drawn
+  QVector<bool> drawn(airways->size(), false);
 
   for(int i = 0; i < airways->size(); i++)
   {
@@ -172,62 +214,38 @@ void MapPainterNav::paintAirways(PaintContext *context, const QList<MapAirway> *
         return;
 
       drawLine(context, Line(airway.from, airway.to));
+      drawn[i] = true;
+    }
+  }
 
-      if(!fast)
-      {
-        // Build text index
-        QString text;
-        if(context->mapLayer->isAirwayIdent())
-          text += airway.name;
+  if(fast)
+    return;
 
-        if(context->mapLayer->isAirwayInfo())
-        {
-          text += QString(tr(" / ")) + map::airwayTypeToShortString(airway.type);
+  // Combine texts of drawn airways with the same waypoints using the cached groups
+  updateAirwayGroups(context, airways);
 
-          QString altTxt = map::airwayAltTextShort(airway);
+  QVector<Place> textlist;
+  for(const AirwayGroup& group : airwayGroups)
+  {
+    Place place;
+    bool firstReversed = false;
+    for(int j = 0; j < group.airwayIndexes.size(); j++)
+    {
+      int index = group.airwayIndexes.at(j);
+      if(!drawn.at(index) || airwayTexts.at(index).isEmpty())
+        continue;
 
-          if(!altTxt.isEmpty())
-            text += QString(tr(" / ")) + altTxt;
-        }
+      if(place.texts.isEmpty())
+        firstReversed = group.reversed.at(j);
 
-        if(!text.isEmpty())
-        {
-          QString firstCoordStr = airway.from.toString(3, false /*altitude*/);
-          QString toCoordStr = airway.to.toString(3, false /*altitude*/);
-
-          // Create string key for index by using the coordinates
-          QString lineTextKey = firstCoordStr + "|" + toCoordStr;
-
-          bool reversed = false;
-
-          // Does it already exist in the map?
-          int index = lines.value(lineTextKey, -1);
-          if(index == -1)
-          {
-            // Try with reversed coordinates
-            index = lines.value(toCoordStr + "|" + firstCoordStr, -1);
-            reversed = index != -1;
-          }
-
-          // if(reversed)
-          // qDebug() << text << reversed;
-
-          if(index != -1)
-          {
-            // Index already found - add the new text to the present one
-            textlist[index].texts.append(text);
-            textlist[index].airwayIndexByText.append(i);
-            textlist[index].positionReversed.append(reversed);
-          }
-          else if(!text.isEmpty())
-          {
-            // Neither with forward nor reversed coordinates found - insert a new entry
-            textlist.append(Place(text, i, reversed));
-            lines.insert(lineTextKey, textlist.size() - 1);
-          }
-        }
-      }
+      // Reversed is relative to the first text
+      place.texts.append(airwayTexts.at(index));
+      place.airwayIndexByText.append(index);
+      place.positionReversed.append(group.reversed.at(j) ^ firstReversed);
     }
+
+    if(!place.texts.isEmpty())
+      textlist.append(place);
   }
 
   TextPlacement textPlacement(context->painter, this);
@@ -280,17 +298,28 @@ void MapPainterNav::paintWaypoints(PaintContext *context, const QList<MapWaypoin
   bool drawAirwayV = context->mapLayer->isAirwayWaypoint() && context->objectTypes.testFlag(map::AIRWAYV);
   bool drawAirwayJ = context->mapLayer->isAirwayWaypoint() && context->objectTypes.testFlag(map::AIRWAYJ);
 
-  for(const MapWaypoint& waypoint : *waypoints)
+  // Convert all positions in one batch since waypoints are the most numerous navaids
+  int num = waypoints->size();
+  QVector<float> lonX(num), latY(num), xs(num), ys(num);
+  QVector<bool> visible(num);
+  for(int i = 0; i < num; i++)
+  {
+    lonX[i] = waypoints->at(i).position.getLonX();
+    latY[i] = waypoints->at(i).position.getLatY();
+  }
+  wToS(lonX.constData(), latY.constData(), xs.data(), ys.data(), visible.data(), num);
+
+  for(int i = 0; i < num; i++)
   {
+    const MapWaypoint& waypoint = waypoints->at(i);
+
     // If waypoints are off, airways are on and waypoint has no airways skip it
     if(!(drawWaypoint || (drawAirwayV && waypoint.hasVictorAirways) || (drawAirwayJ && waypoint.hasJetAirways)))
       continue;
 
-    int x, y;
-    bool visible = wToS(waypoint.position, x, y);
-
-    if(visible)
+    if(visible.at(i))
     {
+      int x = atools::roundToInt(xs.at(i)), y = atools::roundToInt(ys.at(i));
       if(context->objCount())
         return;
 
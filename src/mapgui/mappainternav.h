@@ -46,6 +46,21 @@ private:
                       bool drawWaypoint, bool drawFast);
   void paintAirways(PaintContext *context, const QList<map::MapAirway> *airways, bool fast);
 
+  /* Rebuild texts and groups if the airway list was reloaded or text options changed */
+  void updateAirwayGroups(PaintContext *context, const QList<map::MapAirway> *airways);
+
+  /* Airways sharing the same from and to waypoints. Texts of these are merged into one. */
+  struct AirwayGroup
+  {
+    QVector<int> airwayIndexes; /* Index into airway list */
+    QVector<bool> reversed; /* From and to swapped compared to the first airway in the group */
+  };
+
+  /* Cached for the current airway list in MapQuery */
+  QVector<AirwayGroup> airwayGroups;
+  QVector<QString> airwayTexts; /* Prepared text for each airway in the list */
+  int airwayGroupGeneration = -1;
+  bool airwayGroupIdent = false, airwayGroupInfo = false;
 };
 
 #endif // LITTLENAVMAP_MAPPAINTERAIRPORT_H
@@ -26,9 +26,12 @@
 #include "common/unit.h"
 #include "util/paintercontextsaver.h"
 #include "settings/settings.h"
+#include "atools.h"
 
 #include <marble/GeoPainter.h>
 
+#include <QRegion>
+
 using namespace Marble;
 using namespace atools::geo;
 using namespace map;
@@ -46,6 +49,34 @@ bool MapPainterVehicle::PixmapKey::operator==(const MapPainterVehicle::PixmapKey
   return type == other.type && ground == other.ground && user == other.user && size == other.size;
 }
 
+/* Add the area of a symbol rotated around x,y to the dynamic region. Radius covers the diagonal and
+ * the enlarged helicopter pixmap. */
+static void addSymbolRegion(const PaintContext *context, float x, float y, int size)
+{
+  if(context->dynamicRegion != nullptr)
+  {
+    int radius = size + 2;
+    *context->dynamicRegion += QRect(atools::roundToInt(x) - radius, atools::roundToInt(y) - radius,
+                                     radius * 2, radius * 2);
+  }
+}
+
+/* Add the area of a text label drawn by SymbolPainter::textBoxF to the dynamic region */
+static void addLabelRegion(const PaintContext *context, SymbolPainter *symbolPainter, const QStringList& texts,
+                           float x, float y, textatt::TextAttributes atts)
+{
+  if(context->dynamicRegion != nullptr && !texts.isEmpty())
+  {
+    QRect rect = symbolPainter->textBoxSize(context->painter, texts, atts);
+
+    // Lines are centered vertically around y - add one line height as margin for ascent and background
+    int lineHeight = rect.height() / texts.size();
+    *context->dynamicRegion += QRect(atools::roundToInt(x) - 2,
+                                     atools::roundToInt(y) - rect.height() / 2 - lineHeight - 2,
+                                     rect.width() + 4, rect.height() + lineHeight * 2 + 4);
+  }
+}
+
 MapPainterVehicle::MapPainterVehicle(MapWidget *mapWidget, MapScale *mapScale)
   : MapPainter(mapWidget, mapScale)
 {
@@ -91,6 +122,7 @@ void MapPainterVehicle::paintAiVehicle(const PaintContext *context,
       context->painter->drawPixmap(offset, offset, *pixmapFromCache(vehicle, size, false));
 
       context->painter->resetTransform();
+      addSymbolRegion(context, x, y, size);
 
       // Build text label
       if(vehicle.getCategory() != atools::fs::sc::BOAT)
@@ -113,7 +145,10 @@ void MapPainterVehicle::paintUserAircraft(const PaintContext *context,
   if(context->dOpt(opts::ITEM_USER_AIRCRAFT_TRACK_LINE) &&
      userAircraft.getGroundSpeedKts() > 30 &&
      userAircraft.getTrackDegTrue() < atools::fs::sc::SC_INVALID_FLOAT)
+  {
     symbolPainter->drawTrackLine(context->painter, x, y, size * 2, userAircraft.getTrackDegTrue());
+    addSymbolRegion(context, x, y, size * 2);
+  }
 
   // Position is visible
   context->painter->translate(x, y);
@@ -122,6 +157,7 @@ void MapPainterVehicle::paintUserAircraft(const PaintContext *context,
   // Draw symbol
   context->painter->drawPixmap(offset, offset, *pixmapFromCache(userAircraft, size, true));
   context->painter->resetTransform();
+  addSymbolRegion(context, x, y, size);
 
   // Build text label
   paintTextLabelUser(context, x, y, size, userAircraft);
@@ -141,15 +177,26 @@ void MapPainterVehicle::paintTrack(const PaintContext *context)
     painter->setPen(mapcolors::aircraftTrailPen(size));
     bool lastVisible = false;
 
-    int x1, y1;
+    // Convert all track points in one batch
+    int num = aircraftTrack.size();
+    QVector<float> lonX(num), latY(num), xs(num), ys(num);
+    QVector<bool> visible(num);
+    for(int i = 0; i < num; i++)
+    {
+      const atools::geo::Pos& pos = aircraftTrack.at(i).pos;
+      lonX[i] = pos.getLonX();
+      latY[i] = pos.getLatY();
+    }
+    wToS(lonX.constData(), latY.constData(), xs.data(), ys.data(), visible.data(), num);
+
+    int x1 = atools::roundToInt(xs.first()), y1 = atools::roundToInt(ys.first());
     int x2 = -1, y2 = -1;
-    QRect vpRect(painter->viewport());
-    wToS(aircraftTrack.first().pos, x1, y1);
+    QRect vpRect(0, 0, context->viewport->width(), context->viewport->height());
 
-    for(int i = 1; i < aircraftTrack.size(); i++)
+    for(int i = 1; i < num; i++)
     {
-      const at::AircraftTrackPos& trackPos = aircraftTrack.at(i);
-      wToS(trackPos.pos, x2, y2);
+      x2 = atools::roundToInt(xs.at(i));
+      y2 = atools::roundToInt(ys.at(i));
 
       QRect rect(QPoint(x1, y1), QPoint(x2, y2));
       rect = rect.normalized();
@@ -189,6 +236,15 @@ void MapPainterVehicle::paintTrack(const PaintContext *context)
     {
       polyline.append(QPoint(x2, y2));
       painter->drawPolyline(polyline);
+
+      if(context->dynamicRegion != nullptr)
+      {
+        // Only the last segments change when a new position is appended - the previous end point is
+        // covered by the region of the last call
+        QPolygon tail = polyline.mid(std::max(polyline.size() - 3, 0));
+        int pad = atools::roundToInt(size) + 2;
+        *context->dynamicRegion += tail.boundingRect().adjusted(-pad, -pad, pad, pad);
+      }
     }
   }
 }
@@ -235,6 +291,7 @@ void MapPainterVehicle::paintTextLabelAi(const PaintContext *context, float x, f
 
     // Draw text label
     symbolPainter->textBoxF(context->painter, texts, QPen(Qt::black), x + size / 2, y + size / 2, atts, 255);
+    addLabelRegion(context, symbolPainter, texts, x + size / 2, y + size / 2, atts);
   }
 }
 
@@ -274,6 +331,7 @@ void MapPainterVehicle::paintTextLabelUser(const PaintContext *context, float x,
 
   // Draw text label
   symbolPainter->textBoxF(context->painter, texts, QPen(Qt::black), x + size / 2.f, y + size / 2.f, atts, 255);
+  addLabelRegion(context, symbolPainter, texts, x + size / 2.f, y + size / 2.f, atts);
 }
 
 const QPixmap *MapPainterVehicle::pixmapFromCache(const SimConnectAircraft& ac, int size,
@@ -404,6 +462,7 @@ void MapPainterVehicle::paintWindPointer(const PaintContext *context,
   if(aircraft.getWindDirectionDegT() < atools::fs::sc::SC_INVALID_FLOAT)
   {
     symbolPainter->drawWindPointer(context->painter, x, y, WIND_POINTER_SIZE, aircraft.getWindDirectionDegT());
+    addSymbolRegion(context, x, y + WIND_POINTER_SIZE / 2, WIND_POINTER_SIZE);
     paintTextLabelWind(context, x, y, WIND_POINTER_SIZE, aircraft);
   }
 }
@@ -429,5 +488,6 @@ void MapPainterVehicle::paintTextLabelWind(const PaintContext *context, int x, i
 
     // Draw text label
     symbolPainter->textBoxF(context->painter, texts, QPen(Qt::black), x + size / 2, y + size / 2, atts, 255);
+    addLabelRegion(context, symbolPainter, texts, x + size / 2, y + size / 2, atts);
   }
 }
@@ -32,6 +32,9 @@
 #include "mapgui/mapscale.h"
 #include "route/route.h"
 #include "options/optiondata.h"
+#include "query/mapquery.h"
+#include "query/airportquery.h"
+#include "query/cachebudget.h"
 
 #include <QElapsedTimer>
 
@@ -132,6 +135,7 @@ void MapPaintLayer::initMapLayerSettings()
   // TODO move to configuration file
   if(layers != nullptr)
     delete layers;
+  mapLayer = mapLayerEffective = nullptr;
 
   // Create a list of map layers that define content for each zoom distance
   layers = new MapLayerSettings();
@@ -330,8 +334,69 @@ void MapPaintLayer::updateLayers()
 {
   float dist = static_cast<float>(mapWidget->distance());
   // Get the uncorrected effective layer - route painting is independent of declutter
-  mapLayerEffective = layers->getLayer(dist);
-  mapLayer = layers->getLayer(dist, detailFactor);
+  mapLayerEffective = layers->getLayer(dist, MapLayerSettings::MAP_DEFAULT_DETAIL_FACTOR, mapLayerEffective);
+
+  const MapLayer *lastLayer = mapLayer;
+  mapLayer = layers->getLayer(dist, detailFactor, mapLayer);
+  if(lastLayer != nullptr && lastLayer != mapLayer)
+    layerChanges++;
+}
+
+void MapPaintLayer::initPaintContext(PaintContext& context, GeoPainter *painter, ViewportParams *viewport,
+                                     opts::MapScrollDetail mapScrollDetail)
+{
+  context.mapLayer = mapLayer;
+  context.mapLayerEffective = mapLayerEffective;
+  context.painter = painter;
+  context.viewport = viewport;
+  context.objectTypes = objectTypes;
+  context.airspaceFilterByLayer = getShownAirspacesTypesByLayer();
+  context.viewContext = mapWidget->viewContext();
+  context.drawFast = (mapScrollDetail == opts::FULL || mapScrollDetail == opts::HIGHER) ?
+                     false : mapWidget->viewContext() == Marble::Animation;
+  context.lazyUpdate = mapScrollDetail == opts::FULL ? false : mapWidget->viewContext() == Marble::Animation;
+  context.mapScrollDetail = mapScrollDetail;
+
+  // Copy default font
+  context.defaultFont = painter->font();
+  context.defaultFont.setBold(true);
+  painter->setFont(context.defaultFont);
+
+  const GeoDataLatLonAltBox& box = viewport->viewLatLonAltBox();
+  context.viewportRect = atools::geo::Rect(box.west(GeoDataCoordinates::Degree),
+                                           box.north(GeoDataCoordinates::Degree),
+                                           box.east(GeoDataCoordinates::Degree),
+                                           box.south(GeoDataCoordinates::Degree));
+
+  const OptionData& od = OptionData::instance();
+
+  context.symbolSizeAircraftAi = od.getDisplaySymbolSizeAircraftAi() / 100.f;
+  context.symbolSizeAircraftUser = od.getDisplaySymbolSizeAircraftUser() / 100.f;
+  context.symbolSizeAirport = od.getDisplaySymbolSizeAirport() / 100.f;
+  context.symbolSizeNavaid = od.getDisplaySymbolSizeNavaid() / 100.f;
+  context.textSizeAircraftAi = od.getDisplayTextSizeAircraftAi() / 100.f;
+  context.textSizeAircraftUser = od.getDisplayTextSizeAircraftUser() / 100.f;
+  context.textSizeAirport = od.getDisplayTextSizeAirport() / 100.f;
+  context.textSizeFlightplan = od.getDisplayTextSizeFlightplan() / 100.f;
+  context.textSizeNavaid = od.getDisplayTextSizeNavaid() / 100.f;
+  context.thicknessFlightplan = od.getDisplayThicknessFlightplan() / 100.f;
+  context.thicknessTrail = od.getDisplayThicknessTrail() / 100.f;
+  context.thicknessRangeDistance = od.getDisplayThicknessRangeDistance() / 100.f;
+
+  context.dispOpts = od.getDisplayOptions();
+
+  if(mapWidget->viewContext() == Marble::Still)
+  {
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    painter->setRenderHint(QPainter::TextAntialiasing, true);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+  }
+  else if(mapWidget->viewContext() == Marble::Animation)
+  {
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    painter->setRenderHint(QPainter::TextAntialiasing, false);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+  }
 }
 
 bool MapPaintLayer::render(GeoPainter *painter, ViewportParams *viewport,
@@ -353,114 +418,203 @@ bool MapPaintLayer::render(GeoPainter *painter, ViewportParams *viewport,
     {
       updateLayers();
 
+      // Limit queries to the visible part of the globe
+      mapQuery->updateVisibleCap(viewport);
+
       PaintContext context;
-      context.mapLayer = mapLayer;
-      context.mapLayerEffective = mapLayerEffective;
-      context.painter = painter;
-      context.viewport = viewport;
-      context.objectTypes = objectTypes;
-      context.airspaceFilterByLayer = getShownAirspacesTypesByLayer();
-      context.viewContext = mapWidget->viewContext();
-      context.drawFast = (mapScrollDetail == opts::FULL || mapScrollDetail == opts::HIGHER) ?
-                         false : mapWidget->viewContext() == Marble::Animation;
-      context.lazyUpdate = mapScrollDetail == opts::FULL ? false : mapWidget->viewContext() == Marble::Animation;
-      context.mapScrollDetail = mapScrollDetail;
-
-      // Copy default font
-      context.defaultFont = painter->font();
-      context.defaultFont.setBold(true);
-      painter->setFont(context.defaultFont);
-
-      const GeoDataLatLonAltBox& box = viewport->viewLatLonAltBox();
-      context.viewportRect = atools::geo::Rect(box.west(GeoDataCoordinates::Degree),
-                                               box.north(GeoDataCoordinates::Degree),
-                                               box.east(GeoDataCoordinates::Degree),
-                                               box.south(GeoDataCoordinates::Degree));
-
-      const OptionData& od = OptionData::instance();
-
-      context.symbolSizeAircraftAi = od.getDisplaySymbolSizeAircraftAi() / 100.f;
-      context.symbolSizeAircraftUser = od.getDisplaySymbolSizeAircraftUser() / 100.f;
-      context.symbolSizeAirport = od.getDisplaySymbolSizeAirport() / 100.f;
-      context.symbolSizeNavaid = od.getDisplaySymbolSizeNavaid() / 100.f;
-      context.textSizeAircraftAi = od.getDisplayTextSizeAircraftAi() / 100.f;
-      context.textSizeAircraftUser = od.getDisplayTextSizeAircraftUser() / 100.f;
-      context.textSizeAirport = od.getDisplayTextSizeAirport() / 100.f;
-      context.textSizeFlightplan = od.getDisplayTextSizeFlightplan() / 100.f;
-      context.textSizeNavaid = od.getDisplayTextSizeNavaid() / 100.f;
-      context.thicknessFlightplan = od.getDisplayThicknessFlightplan() / 100.f;
-      context.thicknessTrail = od.getDisplayThicknessTrail() / 100.f;
-      context.thicknessRangeDistance = od.getDisplayThicknessRangeDistance() / 100.f;
-
-      context.dispOpts = od.getDisplayOptions();
-
-      if(mapWidget->viewContext() == Marble::Still)
-      {
-        painter->setRenderHint(QPainter::Antialiasing, true);
-        painter->setRenderHint(QPainter::TextAntialiasing, true);
-        painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
-      }
-      else if(mapWidget->viewContext() == Marble::Animation)
-      {
-        painter->setRenderHint(QPainter::Antialiasing, false);
-        painter->setRenderHint(QPainter::TextAntialiasing, false);
-        painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
-      }
+      initPaintContext(context, painter, viewport, mapScrollDetail);
+
+      QElapsedTimer frameTimer;
+      frameTimer.start();
+      painterStatistics.clear();
 
-      mapPainterShip->render(&context);
+      // Vehicles are drawn into a separate overlay by renderDynamic
+      if(!dynamicSeparate)
+        renderPainter(mapPainterShip, &context, "Ship");
 
       if(mapWidget->distance() < layer::DISTANCE_CUT_OFF_LIMIT)
       {
         if(!context.isOverflow())
-          mapPainterAirspace->render(&context);
+          renderPainter(mapPainterAirspace, &context, "Airspace");
 
         if(context.mapLayerEffective->isAirportDiagram())
         {
           // Put ILS below and navaids on top of airport diagram
-          mapPainterIls->render(&context);
+          renderPainter(mapPainterIls, &context, "ILS");
 
           if(!context.isOverflow())
-            mapPainterAirport->render(&context);
+            renderPainter(mapPainterAirport, &context, "Airport");
 
           if(!context.isOverflow())
-            mapPainterNav->render(&context);
+            renderPainter(mapPainterNav, &context, "Nav");
         }
         else
         {
           // Airports on top of all
           if(!context.isOverflow())
-            mapPainterIls->render(&context);
+            renderPainter(mapPainterIls, &context, "ILS");
 
           if(!context.isOverflow())
-            mapPainterNav->render(&context);
+            renderPainter(mapPainterNav, &context, "Nav");
 
           if(!context.isOverflow())
-            mapPainterAirport->render(&context);
+            renderPainter(mapPainterAirport, &context, "Airport");
         }
       }
 
       // if(!context.isOverflow()) always paint route even if number of objets is too large
-      mapPainterRoute->render(&context);
+      renderPainter(mapPainterRoute, &context, "Route");
 
       // if(!context.isOverflow())
-      mapPainterMark->render(&context);
+      renderPainter(mapPainterMark, &context, "Mark");
 
-      mapPainterAircraft->render(&context);
+      if(!dynamicSeparate)
+        renderPainter(mapPainterAircraft, &context, "Aircraft");
 
       if(context.isOverflow())
         overflow = PaintContext::MAX_OBJECT_COUNT;
       else
         overflow = 0;
-    }
 
-    // Dim the map by drawing a semi-transparent black rectangle
-    if(OptionData::instance().isGuiStyleDark())
-    {
-      int dim = OptionData::instance().getGuiStyleMapDimming();
-      QColor col = QColor::fromRgb(0, 0, 0, 255 - (255 * dim / 100));
-      painter->fillRect(QRect(0, 0, painter->device()->width(), painter->device()->height()), col);
+      if(showRenderStatistics)
+      {
+        qint64 frameNs = frameTimer.nsecsElapsed();
+        drawRenderStatistics(painter, frameNs);
+
+        if(mapWidget->viewContext() == Marble::Still)
+          logRenderStatistics(frameNs);
+      }
     }
 
+    // Dim the map by drawing a semi-transparent black rectangle
+    dimMap(painter, viewport);
   }
   return true;
 }
+
+void MapPaintLayer::renderDynamic(GeoPainter *painter, ViewportParams *viewport, QRegion& region)
+{
+  if(databaseLoadStatus || mapLayer == nullptr)
+    return;
+
+  PaintContext context;
+  initPaintContext(context, painter, viewport, OptionData::instance().getMapScrollDetail());
+  context.dynamicRegion = &region;
+
+  mapPainterShip->render(&context);
+  mapPainterAircraft->render(&context);
+
+  // Dim only the painted vehicles and leave the transparent part of the overlay untouched
+  painter->setCompositionMode(QPainter::CompositionMode_SourceAtop);
+  dimMap(painter, viewport);
+}
+
+void MapPaintLayer::dimMap(GeoPainter *painter, ViewportParams *viewport)
+{
+  if(OptionData::instance().isGuiStyleDark())
+  {
+    int dim = OptionData::instance().getGuiStyleMapDimming();
+    QColor col = QColor::fromRgb(0, 0, 0, 255 - (255 * dim / 100));
+    painter->fillRect(QRect(0, 0, viewport->width(), viewport->height()), col);
+  }
+}
+
+void MapPaintLayer::renderPainter(MapPainter *painter, PaintContext *context, const QString& name)
+{
+  if(!showRenderStatistics)
+  {
+    painter->render(context);
+    return;
+  }
+
+  AirportQuery *airportQuery = NavApp::getAirportQuerySim();
+  mapQuery->resetQueryStatistics();
+  airportQuery->resetQueryStatistics();
+  int objects = context->objectCount;
+
+  QElapsedTimer timer;
+  timer.start();
+  painter->render(context);
+
+  PainterStatistics stats;
+  stats.name = name;
+  stats.totalNs = timer.nsecsElapsed();
+  stats.objects = context->objectCount - objects;
+  stats.queries = mapQuery->getQueryStatistics();
+  stats.queries += airportQuery->getQueryStatistics();
+  painterStatistics.append(stats);
+  sessionStatistics += stats.queries;
+}
+
+QStringList MapPaintLayer::renderStatisticsText(qint64 frameNs) const
+{
+  QueryStatistics total;
+  int totalObjects = 0;
+  for(const PainterStatistics& stats : painterStatistics)
+  {
+    total += stats.queries;
+    totalObjects += stats.objects;
+  }
+
+  QStringList lines;
+  lines.append(QString("Frame %1 ms, query %2 ms, paint %3 ms, objects %4, cache hits %5/%6").
+               arg(frameNs / 1000000., 0, 'f', 1).
+               arg(total.queryNs / 1000000., 0, 'f', 1).
+               arg((frameNs - total.queryNs) / 1000000., 0, 'f', 1).
+               arg(totalObjects).
+               arg(total.cacheHits).arg(total.cacheHits + total.cacheMisses));
+
+  for(const PainterStatistics& stats : painterStatistics)
+    lines.append(QString("%1 %2 ms, query %3 ms, paint %4 ms, objects %5, cache hits %6/%7").
+                 arg(stats.name, -8).
+                 arg(stats.totalNs / 1000000., 6, 'f', 1).
+                 arg(stats.queries.queryNs / 1000000., 6, 'f', 1).
+                 arg((stats.totalNs - stats.queries.queryNs) / 1000000., 6, 'f', 1).
+                 arg(stats.objects, 5).
+                 arg(stats.queries.cacheHits).arg(stats.queries.cacheHits + stats.queries.cacheMisses));
+
+  // Totals since statistics were enabled to check cache behavior over a zoom session
+  lines.append(QString("Session layer changes %1, cache reloads %2, restored %3, query %4 ms").
+               arg(layerChanges).
+               arg(sessionStatistics.cacheReloads).
+               arg(sessionStatistics.cacheRestores).
+               arg(sessionStatistics.queryNs / 1000000., 0, 'f', 1));
+
+  // Largest query caches
+  lines.append(CacheBudget::instance().getUsageText(5));
+  return lines;
+}
+
+void MapPaintLayer::drawRenderStatistics(GeoPainter *painter, qint64 frameNs)
+{
+  QStringList lines = renderStatisticsText(frameNs);
+
+  painter->save();
+  QFont font("Monospace");
+  font.setStyleHint(QFont::TypeWriter);
+  font.setPointSizeF(painter->font().pointSizeF());
+  painter->setFont(font);
+
+  QFontMetrics metrics(font);
+  int width = 0;
+  for(const QString& line : lines)
+    width = std::max(width, metrics.width(line));
+
+  // Semi-transparent background for readability on all map themes
+  painter->fillRect(QRect(0, 0, width + 10, metrics.height() * lines.size() + 10), QColor(255, 255, 255, 200));
+
+  painter->setPen(Qt::black);
+  int y = 5 + metrics.ascent();
+  for(const QString& line : lines)
+  {
+    painter->drawText(5, y, line);
+    y += metrics.height();
+  }
+  painter->restore();
+}
+
+void MapPaintLayer::logRenderStatistics(qint64 frameNs)
+{
+  for(const QString& line : renderStatisticsText(frameNs))
+    qInfo() << Q_FUNC_INFO << line;
+}
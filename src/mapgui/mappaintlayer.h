@@ -19,8 +19,11 @@
 #define LITTLENAVMAP_MAPPAINTLAYER_H
 
 #include "mapgui/mappainter.h"
+#include "query/querystatistics.h"
 
 #include <QPen>
+#include <QRegion>
+#include <QVector>
 
 #include <marble/LayerInterface.h>
 
@@ -103,9 +106,54 @@ public:
     return overflow;
   }
 
+  /* Draw an overlay with painter times, object counts and cache hits and write it to the log for still
+   * frames. Does not repaint. */
+  void setShowRenderStatistics(bool show)
+  {
+    showRenderStatistics = show;
+    sessionStatistics = QueryStatistics();
+    layerChanges = 0;
+  }
+
+  bool isShowRenderStatistics() const
+  {
+    return showRenderStatistics;
+  }
+
+  /* If true ships and aircraft are omitted from the normal map rendering and have to be drawn using
+   * renderDynamic. Used to cache the static map as background for aircraft updates. */
+  void setDynamicSeparate(bool value)
+  {
+    dynamicSeparate = value;
+  }
+
+  /* Draw ships, aircraft and trail only and add their screen area to region. Uses the layers of the
+   * last map rendering. */
+  void renderDynamic(Marble::GeoPainter *painter, Marble::ViewportParams *viewport, QRegion& region);
+
 private:
+  /* Time, drawn objects and query counters of one painter for the last frame */
+  struct PainterStatistics
+  {
+    QString name;
+    qint64 totalNs = 0; /* Query and paint time */
+    int objects = 0;
+    QueryStatistics queries;
+  };
+
+  /* Call render of the painter and collect statistics if enabled */
+  void renderPainter(MapPainter *painter, PaintContext *context, const QString& name);
+
+  /* Draw statistics of the last frame into the top left corner */
+  void drawRenderStatistics(Marble::GeoPainter *painter, qint64 frameNs);
+  void logRenderStatistics(qint64 frameNs);
+  QStringList renderStatisticsText(qint64 frameNs) const;
+
   void initMapLayerSettings();
   void updateLayers();
+  void initPaintContext(PaintContext& context, Marble::GeoPainter *painter, Marble::ViewportParams *viewport,
+                        opts::MapScrollDetail mapScrollDetail);
+  void dimMap(Marble::GeoPainter *painter, Marble::ViewportParams *viewport);
 
   /* Implemented from LayerInterface: We  draw above all but below user tools */
   virtual QStringList renderPosition() const override
@@ -145,6 +193,13 @@ private:
   const MapLayer *mapLayer = nullptr, *mapLayerEffective = nullptr;
   int overflow = 0;
 
+  bool showRenderStatistics = false, dynamicSeparate = false;
+  QVector<PainterStatistics> painterStatistics;
+
+  /* Accumulated since render statistics were enabled */
+  QueryStatistics sessionStatistics;
+  int layerChanges = 0;
+
 };
 
 #endif // LITTLENAVMAP_MAPPAINTLAYER_H
@@ -347,6 +347,44 @@ void MapScreenIndex::getAllNearest(int xs, int ys, int maxDistance, map::MapSear
       airportQuery->getAirportById(obj, obj.getId());
 }
 
+void MapScreenIndex::resolveSearchResult(int xs, int ys, map::MapSearchResult& result)
+{
+  using maptools::insertSortedByDistance;
+
+  CoordinateConverter conv(mapWidget->viewport());
+  for(const map::MapObjectRef& ref : result.refs)
+  {
+    // Ids are already in the sets - pass null to avoid the duplicate check
+    if(ref.type == map::AIRPORT)
+    {
+      map::MapAirport airport;
+      airportQuery->getAirportById(airport, ref.id);
+      if(airport.isValid())
+        insertSortedByDistance(conv, result.airports, nullptr, xs, ys, airport);
+    }
+    else if(ref.type == map::VOR)
+    {
+      map::MapVor vor = mapQuery->getVorById(ref.id);
+      if(vor.isValid())
+        insertSortedByDistance(conv, result.vors, nullptr, xs, ys, vor);
+    }
+    else if(ref.type == map::NDB)
+    {
+      map::MapNdb ndb = mapQuery->getNdbById(ref.id);
+      if(ndb.isValid())
+        insertSortedByDistance(conv, result.ndbs, nullptr, xs, ys, ndb);
+    }
+    else if(ref.type == map::WAYPOINT)
+    {
+      map::MapWaypoint waypoint = mapQuery->getWaypointById(ref.id);
+      if(waypoint.isValid())
+        insertSortedByDistance(conv, result.waypoints, nullptr, xs, ys, waypoint);
+    }
+  }
+  result.refs.clear();
+  result.idsOnly = false;
+}
+
 void MapScreenIndex::getNearestHighlights(int xs, int ys, int maxDistance, map::MapSearchResult& result)
 {
   CoordinateConverter conv(mapWidget->viewport());
@@ -57,6 +57,10 @@ public:
   void getAllNearest(int xs, int ys, int maxDistance, map::MapSearchResult& result,
                      QList<proc::MapProcedurePoint>& procPoints);
 
+  /* Load full objects for all references of a result filled in id only mode and insert them sorted by
+   * distance to xs/ys. Result is in normal mode afterwards. */
+  void resolveSearchResult(int xs, int ys, map::MapSearchResult& result);
+
   /* Get nearest distance measurement line index (only the endpoint)
    * or -1 if nothing was found near the cursor position. Index points into the list of getDistanceMarks */
   int getNearestDistanceMarkIndex(int xs, int ys, int maxDistance);
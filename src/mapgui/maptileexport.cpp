@@ -0,0 +1,382 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "mapgui/maptileexport.h"
+
+#include "mapgui/mapwidget.h"
+#include "print/printsupport.h"
+#include "geo/calculations.h"
+
+#include <QDebug>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageWriter>
+#include <QPainter>
+#include <QProgressDialog>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+
+#include <marble/ViewportParams.h>
+#include <marble/MarbleModel.h>
+
+/*
+ * Writes an uncompressed baseline RGB TIFF file strip by strip. All offsets are known in advance, so
+ * the image directory is written first and image rows can be appended as they are rendered.
+ */
+class TiffStreamWriter
+{
+public:
+  TiffStreamWriter(QIODevice *device, int imageWidth, int imageHeight, int stripRows)
+    : out(device), width(imageWidth), height(imageHeight), rowsPerStrip(stripRows)
+  {
+    out.setByteOrder(QDataStream::LittleEndian);
+  }
+
+  /* Write header and image file directory */
+  bool writeHeader();
+
+  /* Append image rows from top to bottom */
+  bool writeRows(const QImage& image);
+
+  /* Maximum size for classic TIFF using 32 bit offsets */
+  static Q_DECL_CONSTEXPR qint64 MAX_FILE_SIZE = 0xFFFFFFF0L;
+
+  static qint64 fileSize(int width, int height)
+  {
+    return 4096L + static_cast<qint64>(width) * height * 3;
+  }
+
+private:
+  /* Field types */
+  static Q_DECL_CONSTEXPR quint16 SHORT = 3;
+  static Q_DECL_CONSTEXPR quint16 LONG = 4;
+  static Q_DECL_CONSTEXPR quint16 RATIONAL = 5;
+
+  void writeEntry(quint16 tag, quint16 type, quint32 count, quint32 value)
+  {
+    out << tag << type << count;
+    if(type == SHORT && count == 1)
+      // Short value is left justified in the four bytes
+      out << static_cast<quint16>(value) << static_cast<quint16>(0);
+    else
+      out << value;
+  }
+
+  QDataStream out;
+  int width, height, rowsPerStrip;
+};
+
+bool TiffStreamWriter::writeHeader()
+{
+  const quint16 NUM_ENTRIES = 12;
+  const quint32 numStrips = static_cast<quint32>((height + rowsPerStrip - 1) / rowsPerStrip);
+  const quint32 stripBytes = static_cast<quint32>(rowsPerStrip * width * 3);
+
+  // Layout: header, directory, bits per sample, resolution, strip offsets, strip byte counts, image data
+  const quint32 ifdOffset = 8;
+  const quint32 bitsOffset = ifdOffset + 2 + NUM_ENTRIES * 12 + 4;
+  const quint32 xResOffset = bitsOffset + 3 * 2;
+  const quint32 yResOffset = xResOffset + 8;
+  const quint32 stripOffsetsOffset = yResOffset + 8;
+  const quint32 stripCountsOffset = stripOffsetsOffset + numStrips * 4;
+  const quint32 dataOffset = stripCountsOffset + numStrips * 4;
+
+  // Little endian header
+  out << static_cast<quint8>('I') << static_cast<quint8>('I') << static_cast<quint16>(42) << ifdOffset;
+
+  // Entries have to be sorted by tag
+  out << NUM_ENTRIES;
+  writeEntry(256, LONG, 1, static_cast<quint32>(width)); // ImageWidth
+  writeEntry(257, LONG, 1, static_cast<quint32>(height)); // ImageLength
+  writeEntry(258, SHORT, 3, bitsOffset); // BitsPerSample
+  writeEntry(259, SHORT, 1, 1); // Compression none
+  writeEntry(262, SHORT, 1, 2); // PhotometricInterpretation RGB
+  // Single values are stored inline
+  writeEntry(273, LONG, numStrips, numStrips == 1 ? dataOffset : stripOffsetsOffset); // StripOffsets
+  writeEntry(277, SHORT, 1, 3); // SamplesPerPixel
+  writeEntry(278, LONG, 1, static_cast<quint32>(rowsPerStrip)); // RowsPerStrip
+  writeEntry(279, LONG, numStrips,
+             numStrips == 1 ? static_cast<quint32>(height * width * 3) : stripCountsOffset); // StripByteCounts
+  writeEntry(282, RATIONAL, 1, xResOffset); // XResolution
+  writeEntry(283, RATIONAL, 1, yResOffset); // YResolution
+  writeEntry(296, SHORT, 1, 2); // ResolutionUnit inch
+  out << static_cast<quint32>(0); // No next directory
+
+  out << static_cast<quint16>(8) << static_cast<quint16>(8) << static_cast<quint16>(8);
+  out << static_cast<quint32>(72) << static_cast<quint32>(1);
+  out << static_cast<quint32>(72) << static_cast<quint32>(1);
+
+  // Strip arrays are always written to keep the data offset simple
+  for(quint32 i = 0; i < numStrips; i++)
+    out << dataOffset + i * stripBytes;
+
+  for(quint32 i = 0; i < numStrips; i++)
+  {
+    quint32 rows = std::min(static_cast<quint32>(rowsPerStrip),
+                            static_cast<quint32>(height) - i * static_cast<quint32>(rowsPerStrip));
+    out << rows * static_cast<quint32>(width) * 3;
+  }
+
+  return out.status() == QDataStream::Ok;
+}
+
+bool TiffStreamWriter::writeRows(const QImage& image)
+{
+  QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+
+  // Scan lines are padded to 32 bit - write only the pixels
+  for(int y = 0; y < rgb.height(); y++)
+    out.writeRawData(reinterpret_cast<const char *>(rgb.constScanLine(y)), rgb.width() * 3);
+
+  return out.status() == QDataStream::Ok;
+}
+
+// =======================================================================================
+MapTileExport::MapTileExport(MapWidget *mapWidgetParam)
+  : mapWidget(mapWidgetParam)
+{
+
+}
+
+QSize MapTileExport::getExportSize(int scale) const
+{
+  return mapWidget->size() * scale;
+}
+
+int MapTileExport::tileMargin() const
+{
+  // Avoid tiles without content for small map windows
+  return std::min(static_cast<int>(TILE_MARGIN), std::min(tileSize.width(), tileSize.height()) / 4);
+}
+
+bool MapTileExport::isTiff(const QString& filename) const
+{
+  QString suffix = QFileInfo(filename).suffix().toLower();
+  return suffix == "tif" || suffix == "tiff";
+}
+
+bool MapTileExport::isSizeSupported(const QString& filename, int scale) const
+{
+  QSize size = getExportSize(scale);
+  if(isTiff(filename))
+    return TiffStreamWriter::fileSize(size.width(), size.height()) < TiffStreamWriter::MAX_FILE_SIZE;
+  else
+    return static_cast<qint64>(size.width()) * size.height() < MAX_PIXELS_IN_MEMORY;
+}
+
+bool MapTileExport::exportImage(const QString& filename, int scale, QWidget *parent)
+{
+  errorMessage.clear();
+
+  if(!isSizeSupported(filename, scale))
+  {
+    errorMessage = tr("Image is too large for this file format.");
+    return false;
+  }
+
+  QSize size = getExportSize(scale);
+  tileSize = mapWidget->size();
+
+  qDebug() << Q_FUNC_INFO << filename << "scale" << scale << "size" << size << "tile size" << tileSize;
+
+  // Remember view to restore it later
+  Marble::Projection projection = mapWidget->projection();
+  qreal centerLon = mapWidget->centerLongitude(), centerLat = mapWidget->centerLatitude();
+  int radius = mapWidget->radius();
+
+  // Viewport for the full image with the same center but higher zoom
+  Marble::ViewportParams viewport(Marble::Mercator,
+                                  atools::geo::toRadians(centerLon), atools::geo::toRadians(centerLat),
+                                  radius * scale, size);
+
+  int margin = tileMargin();
+  int stepWidth = tileSize.width() - 2 * margin, stepHeight = tileSize.height() - 2 * margin;
+  int numTiles = ((size.width() + stepWidth - 1) / stepWidth) * ((size.height() + stepHeight - 1) / stepHeight);
+
+  QProgressDialog progress(tr("Rendering map ..."), tr("&Cancel"), 0, numTiles, parent);
+  progress.setWindowModality(Qt::WindowModal);
+  progress.setMinimumDuration(0);
+
+  QFile file(filename);
+  QImage fullImage;
+  TiffStreamWriter *tiffWriter = nullptr;
+  bool tiff = isTiff(filename);
+
+  if(tiff)
+  {
+    if(!file.open(QIODevice::WriteOnly))
+    {
+      errorMessage = tr("Cannot open file \"%1\". Reason: %2").arg(filename).arg(file.errorString());
+      return false;
+    }
+    tiffWriter = new TiffStreamWriter(&file, size.width(), size.height(), stepHeight);
+    if(!tiffWriter->writeHeader())
+      errorMessage = tr("Cannot write file \"%1\". Reason: %2").arg(filename).arg(file.errorString());
+  }
+  else
+    fullImage = QImage(size, QImage::Format_RGB32);
+
+  // Track loading of base map tiles while rendering
+  renderStatus = Marble::Complete;
+  QMetaObject::Connection statusConnection =
+    QObject::connect(mapWidget, &MapWidget::renderStatusChanged, [this](Marble::RenderStatus status) -> void
+  {
+    renderStatus = status;
+  });
+
+  // Keep tiles out of the history and leave the stored view state untouched
+  mapWidget->setHistoryRecording(false);
+  mapWidget->showOverlays(false);
+  mapWidget->setProjection(Marble::Mercator);
+  mapWidget->setRadius(radius * scale);
+
+  int tilesDone = 0;
+  for(int y = 0; y < size.height() && errorMessage.isEmpty(); y += stepHeight)
+  {
+    QImage band(size.width(), std::min(stepHeight, size.height() - y), QImage::Format_RGB32);
+    if(!renderBand(band, viewport, y, progress, tilesDone))
+      break;
+
+    if(y + stepHeight >= size.height())
+    {
+      // Last band - add program information at the bottom left corner of the image
+      QPainter painter(&band);
+      PrintSupport::drawWatermark(QPoint(0, band.height()), &painter);
+    }
+
+    if(tiffWriter != nullptr)
+    {
+      if(!tiffWriter->writeRows(band))
+        errorMessage = tr("Cannot write file \"%1\". Reason: %2").arg(filename).arg(file.errorString());
+    }
+    else
+    {
+      QPainter painter(&fullImage);
+      painter.drawImage(0, y, band);
+    }
+  }
+
+  bool canceled = progress.wasCanceled();
+  progress.reset();
+
+  // Restore view
+  mapWidget->setProjection(projection);
+  mapWidget->setRadius(radius);
+  mapWidget->centerOn(centerLon, centerLat, false);
+  mapWidget->showOverlays(true);
+  mapWidget->setHistoryRecording(true);
+  QObject::disconnect(statusConnection);
+
+  delete tiffWriter;
+
+  if(tiff)
+  {
+    file.close();
+    if(canceled || !errorMessage.isEmpty())
+      file.remove();
+  }
+  else if(!canceled && errorMessage.isEmpty())
+  {
+    QImageWriter writer(filename);
+    if(!writer.write(fullImage))
+      errorMessage = tr("Cannot write file \"%1\". Reason: %2").arg(filename).arg(writer.errorString());
+  }
+
+  return !canceled && errorMessage.isEmpty();
+}
+
+bool MapTileExport::renderBand(QImage& band, const Marble::ViewportParams& viewport, int y,
+                               QProgressDialog& progress, int& tilesDone)
+{
+  int margin = tileMargin();
+  int stepWidth = tileSize.width() - 2 * margin;
+
+  band.fill(QColor(Qt::white));
+  QPainter painter(&band);
+
+  for(int x = 0; x < band.width(); x += stepWidth)
+  {
+    progress.setValue(tilesDone++);
+    QApplication::processEvents();
+    if(progress.wasCanceled())
+      return false;
+
+    // Center of the widget including margins in full image coordinates
+    int centerX = x - margin + tileSize.width() / 2;
+    int centerY = y - margin + tileSize.height() / 2;
+
+    qreal lon, lat;
+    if(!viewport.geoCoordinates(centerX, centerY, lon, lat, Marble::GeoDataCoordinates::Degree))
+      // Outside of the Mercator projection
+      continue;
+
+    mapWidget->centerOn(lon, lat, false);
+
+    QPixmap tile = grabTile();
+    if(tile.size() != tileSize)
+      // Adjust for high DPI screens
+      tile = tile.scaled(tileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    tile.setDevicePixelRatio(1.);
+
+    // Copy only the inner part without margins
+    painter.drawPixmap(QPoint(x, 0), tile, QRect(margin, margin, tileSize.width() - 2 * margin,
+                                                 tileSize.height() - 2 * margin));
+  }
+  return true;
+}
+
+QPixmap MapTileExport::grabTile()
+{
+  // Renders synchronously using all painters
+  QPixmap tile = mapWidget->grab();
+
+  if(mapWidget->model()->workOffline())
+    // Nothing will be downloaded
+    return tile;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Base map tiles are loaded or downloaded in the background - render again until all are available
+  QEventLoop eventLoop;
+  QTimer pollTimer;
+  QObject::connect(&pollTimer, &QTimer::timeout, &eventLoop, [&]() -> void
+  {
+    if(timer.elapsed() > TILE_LOAD_TIMEOUT_MS)
+      eventLoop.quit();
+    else
+    {
+      tile = mapWidget->grab();
+      if(renderStatus != Marble::WaitingForUpdate && renderStatus != Marble::WaitingForData)
+        eventLoop.quit();
+    }
+  });
+
+  if(renderStatus == Marble::WaitingForUpdate || renderStatus == Marble::WaitingForData)
+  {
+    pollTimer.start(100);
+    eventLoop.exec();
+
+    if(renderStatus == Marble::WaitingForUpdate || renderStatus == Marble::WaitingForData)
+      qWarning() << Q_FUNC_INFO << "Timeout waiting for map tiles";
+  }
+  return tile;
+}
@@ -0,0 +1,98 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_MAPTILEEXPORT_H
+#define LITTLENAVMAP_MAPTILEEXPORT_H
+
+#include <QCoreApplication>
+#include <QSize>
+
+#include <marble/MarbleGlobal.h>
+
+class MapWidget;
+class QImage;
+class QProgressDialog;
+
+namespace Marble {
+class ViewportParams;
+}
+
+/*
+ * Exports the current map view as an image which is larger than the map widget.
+ *
+ * The full image covers the same area as the visible map but is rendered at a higher zoom level using
+ * the scale factor. It is split into tiles of the widget size which are rendered one after the other by
+ * centering the map widget on the tile and using all map painters. Tiles overlap by a margin to avoid
+ * clipped symbols and labels at the tile borders.
+ *
+ * Rendering is always done in Mercator projection since only this allows to stitch tiles seamlessly.
+ * Each tile is rendered again until Marble has loaded all map tiles for the view or a timeout is reached.
+ *
+ * TIFF files are written band by band so only one row of tiles is kept in memory. Other formats
+ * are assembled in memory and are limited in size.
+ */
+class MapTileExport
+{
+  Q_DECLARE_TR_FUNCTIONS(MapTileExport)
+
+public:
+  MapTileExport(MapWidget *mapWidgetParam);
+
+  /* Render and save image. Format is determined by file extension. Shows a progress dialog
+   * using parent. Returns false on error or if canceled. */
+  bool exportImage(const QString& filename, int scale, QWidget *parent);
+
+  /* Get size of the exported image for scale */
+  QSize getExportSize(int scale) const;
+
+  /* Check if the image size is supported for the file format */
+  bool isSizeSupported(const QString& filename, int scale) const;
+
+  const QString& getErrorMessage() const
+  {
+    return errorMessage;
+  }
+
+private:
+  /* Render one row of tiles starting at full image coordinate y into band */
+  bool renderBand(QImage& band, const Marble::ViewportParams& viewport, int y, QProgressDialog& progress,
+                  int& tilesDone);
+
+  /* Render the map widget and repeat until all base map tiles are loaded or downloaded */
+  QPixmap grabTile();
+
+  bool isTiff(const QString& filename) const;
+  int tileMargin() const;
+
+  /* Overlap of tiles in pixel on each side */
+  static Q_DECL_CONSTEXPR int TILE_MARGIN = 100;
+
+  /* Maximum time to wait for base map tiles for one export tile */
+  static Q_DECL_CONSTEXPR int TILE_LOAD_TIMEOUT_MS = 10000;
+
+  /* Maximum number of pixels for formats which are not streamed */
+  static Q_DECL_CONSTEXPR qint64 MAX_PIXELS_IN_MEMORY = 100000000L;
+
+  MapWidget *mapWidget;
+  QSize tileSize;
+  QString errorMessage;
+
+  /* Last status sent by the map widget while rendering */
+  Marble::RenderStatus renderStatus = Marble::Complete;
+};
+
+#endif // LITTLENAVMAP_MAPTILEEXPORT_H
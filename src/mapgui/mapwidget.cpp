@@ -51,11 +51,13 @@
 #include <QRubberBand>
 #include <QMessageBox>
 #include <QPainter>
+#include <QElapsedTimer>
 
 #include <marble/MarbleLocale.h>
 #include <marble/MarbleWidgetInputHandler.h>
 #include <marble/MarbleModel.h>
 #include <marble/AbstractFloatItem.h>
+#include <marble/GeoPainter.h>
 
 // Default zoom distance if start position was not set (usually first start after installation */
 const int DEFAULT_MAP_DISTANCE = 7000;
@@ -63,6 +65,12 @@ const int DEFAULT_MAP_DISTANCE = 7000;
 // Get elevation when mouse is still
 const int ALTITUDE_UPDATE_TIMEOUT = 200;
 
+/* Paint events are captured as history snapshot until the map is idle for this time */
+const int HISTORY_SNAPSHOT_TIMEOUT = 1000;
+
+/* Snapshots are reduced in size by this factor */
+const int HISTORY_SNAPSHOT_SCALE = 2;
+
 /* If width and height of a bounding rect are smaller than this use show point */
 const float POS_IS_POINT_EPSILON = 0.0001f;
 
@@ -139,6 +147,12 @@ MapWidget::MapWidget(MainWindow *parent)
   elevationDisplayTimer.setInterval(ALTITUDE_UPDATE_TIMEOUT);
   elevationDisplayTimer.setSingleShot(true);
   connect(&elevationDisplayTimer, &QTimer::timeout, this, &MapWidget::elevationDisplayTimerTimeout);
+
+  historySnapshots.setMaxCost(atools::settings::Settings::instance().getAndStoreValue(
+                                lnm::MAP_HISTORY_SNAPSHOT_CACHE_KB, 20000).toInt());
+  historySnapshotTimer.setInterval(HISTORY_SNAPSHOT_TIMEOUT);
+  historySnapshotTimer.setSingleShot(true);
+  connect(&historySnapshotTimer, &QTimer::timeout, this, &MapWidget::historySnapshotTimeout);
 }
 
 MapWidget::~MapWidget()
@@ -217,6 +231,7 @@ void MapWidget::optionsChanged()
   screenSearchDistanceTooltip = OptionData::instance().getMapTooltipSensitivity();
 
   updateCacheSizes();
+  invalidateHistorySnapshots();
   update();
 }
 
@@ -244,6 +259,7 @@ void MapWidget::updateMapObjectsShown()
                  (currentComboIndex == MapWidget::SIMPLE || currentComboIndex == MapWidget::PLAIN
                   || currentComboIndex == MapWidget::ATLAS));
   setShowGrid(ui->actionMapShowGrid->isChecked());
+  paintLayer->setShowRenderStatistics(ui->actionMapShowRenderStatistics->isChecked());
 
   setPropertyValue("hillshading", ui->actionMapShowHillshading->isChecked() &&
                    (currentComboIndex == MapWidget::OPENSTREETMAP ||
@@ -305,6 +321,8 @@ void MapWidget::updateMapObjectsShown()
 
   emit shownMapFeaturesChanged(paintLayer->getShownMapObjects());
 
+  invalidateHistorySnapshots();
+
   // Update widget
   update();
 }
@@ -333,6 +351,7 @@ void MapWidget::setShowMapAirspaces(map::MapAirspaceFilter types)
 {
   paintLayer->setShowAirspaces(types);
   // setShowMapFeatures(map::AIRSPACE, types & map::AIRSPACE_ALL);
+  invalidateHistorySnapshots();
   updateVisibleObjectsStatusBar();
   screenIndex->updateAirspaceScreenGeometry(currentViewBoundingBox);
 }
@@ -341,6 +360,7 @@ void MapWidget::setDetailLevel(int factor)
 {
   qDebug() << "setDetailFactor" << factor;
   paintLayer->setDetailFactor(factor);
+  invalidateHistorySnapshots();
   updateVisibleObjectsStatusBar();
   screenIndex->updateAirwayScreenGeometry(currentViewBoundingBox);
   screenIndex->updateAirspaceScreenGeometry(currentViewBoundingBox);
@@ -379,6 +399,7 @@ void MapWidget::postDatabaseLoad()
 {
   databaseLoadStatus = false;
   paintLayer->postDatabaseLoad();
+  historySnapshots.clear();
   screenIndex->updateAirwayScreenGeometry(currentViewBoundingBox);
   screenIndex->updateAirspaceScreenGeometry(currentViewBoundingBox);
   screenIndex->updateRouteScreenGeometry(currentViewBoundingBox);
@@ -391,6 +412,7 @@ void MapWidget::historyNext()
   const MapPosHistoryEntry& entry = history.next();
   if(entry.isValid())
   {
+    showHistoryPreview(entry);
     setDistance(entry.getDistance());
     centerOn(entry.getPos().getLonX(), entry.getPos().getLatY(), false);
     changedByHistory = true;
@@ -404,6 +426,7 @@ void MapWidget::historyBack()
   const MapPosHistoryEntry& entry = history.back();
   if(entry.isValid())
   {
+    showHistoryPreview(entry);
     setDistance(entry.getDistance());
     centerOn(entry.getPos().getLonX(), entry.getPos().getLatY(), false);
     changedByHistory = true;
@@ -412,6 +435,78 @@ void MapWidget::historyBack()
   }
 }
 
+void MapWidget::showHistoryPreview(const MapPosHistoryEntry& entry)
+{
+  QPixmap *snapshot = historySnapshots.object(historyKey(entry.getPos(), entry.getDistance()));
+  if(snapshot != nullptr)
+    historyPreview = *snapshot;
+}
+
+void MapWidget::historySnapshotTimeout()
+{
+  // Last paint event contains the final map including all loaded tiles
+  historySnapshotCapture = false;
+}
+
+void MapWidget::invalidateHistorySnapshots()
+{
+  historySnapshots.clear();
+
+  if(historySnapshots.maxCost() > 0)
+  {
+    historySnapshotCapture = true;
+    historySnapshotTimer.start();
+  }
+}
+
+bool MapWidget::isHistorySnapshotWanted(QPaintEvent *paintEvent)
+{
+  // Only full paint events of the real widget
+  return historySnapshotCapture && historyRecording && viewContext() == Marble::Still &&
+         paintEvent->rect() == rect() && redirected(nullptr) == nullptr;
+}
+
+void MapWidget::paintWithHistorySnapshot(QPaintEvent *paintEvent)
+{
+  Q_UNUSED(paintEvent);
+
+  qreal ratio = devicePixelRatioF();
+  QPixmap frame(size() * ratio);
+  frame.setDevicePixelRatio(ratio);
+
+  // Render map into the frame - calls paintEvent recursively
+  renderingOffscreen = true;
+  render(&frame, QPoint(), QRegion(), QWidget::DrawWindowBackground);
+  renderingOffscreen = false;
+
+  QPainter painter(this);
+  painter.drawPixmap(0, 0, frame);
+
+  saveHistorySnapshot(frame);
+}
+
+void MapWidget::saveHistorySnapshot(const QPixmap& frame)
+{
+  const MapPosHistoryEntry& entry = history.current();
+  if(!entry.isValid())
+    return;
+
+  // Check if the view still matches the history entry
+  QString key = historyKey(entry.getPos(), entry.getDistance());
+  if(key != historyKey(Pos(centerLongitude(), centerLatitude()), distance()))
+    return;
+
+  // Replace previous snapshot of this view which might miss tiles that were loaded later
+  QPixmap *snapshot = new QPixmap(frame.scaled(frame.size() / HISTORY_SNAPSHOT_SCALE,
+                                               Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+  historySnapshots.insert(key, snapshot, snapshot->width() * snapshot->height() * snapshot->depth() / 8 / 1024);
+}
+
+QString MapWidget::historyKey(const atools::geo::Pos& pos, double distance)
+{
+  return QString("%1 %2 %3").arg(pos.getLonX(), 0, 'f', 5).arg(pos.getLatY(), 0, 'f', 5).arg(distance, 0, 'f', 3);
+}
+
 void MapWidget::saveState()
 {
   atools::settings::Settings& s = atools::settings::Settings::instance();
@@ -625,6 +720,7 @@ void MapWidget::overlayStateToMenu()
 void MapWidget::overlayStateFromMenu()
 {
   qDebug() << Q_FUNC_INFO;
+  invalidateHistorySnapshots();
 
   for(const QString& name : mapOverlays.keys())
   {
@@ -878,6 +974,7 @@ void MapWidget::routeChanged(bool geometryChanged)
   {
     cancelDragAll();
     screenIndex->updateRouteScreenGeometry(currentViewBoundingBox);
+    invalidateHistorySnapshots();
     update();
   }
 }
@@ -903,6 +1000,16 @@ void MapWidget::simDataChanged(const atools::fs::sc::SimConnectData& simulatorDa
   screenIndex->updateSimData(simulatorData);
   const atools::fs::sc::SimConnectUserAircraft& lastUserAircraft = screenIndex->getLastUserAircraft();
 
+  // The route controller receives the sim data first and updates the active leg. The active leg is
+  // painted into the cached background which has to be rendered again if the leg changes.
+  int activeLegIndex = NavApp::getRoute().getActiveLegIndex();
+  if(activeLegIndex != lastActiveLegIndex)
+  {
+    lastActiveLegIndex = activeLegIndex;
+    dynamicBackgroundValid = false;
+    update();
+  }
+
   CoordinateConverter conv(viewport());
   QPointF curPos = conv.wToSF(userAircraft.getPosition());
   QPointF diff = curPos - conv.wToSF(lastUserAircraft.getPosition());
@@ -985,7 +1092,8 @@ void MapWidget::simDataChanged(const atools::fs::sc::SimConnectData& simulatorDa
             setDistance(savedDistance);
           }
           else
-            update();
+            // Repaint only the area of aircraft and trail if possible
+            updateDynamicLayer(trackPruned);
         }
       }
     }
@@ -996,11 +1104,145 @@ void MapWidget::simDataChanged(const atools::fs::sc::SimConnectData& simulatorDa
     if(!lastUserAircraft.getPosition().isValid() || diff.manhattanLength() > 4)
     {
       screenIndex->updateLastSimData(simulatorData);
-      update();
+      updateDynamicLayer(trackPruned);
     }
   }
 }
 
+bool MapWidget::isDynamicLayerActive()
+{
+  // Not used when painting into a pixmap by grab() since the nested render would reset the redirection
+  return NavApp::isConnected() && viewContext() == Marble::Still && mouseState == mw::NONE &&
+         redirected(nullptr) == nullptr &&
+         paintLayer->getShownMapObjects() & (map::AIRCRAFT | map::AIRCRAFT_AI | map::AIRCRAFT_AI_SHIP |
+                                             map::AIRCRAFT_TRACK);
+}
+
+void MapWidget::updateDynamicLayer(bool full)
+{
+  if(full || !dynamicBackgroundValid || !isDynamicLayerActive())
+    update();
+  else
+  {
+    // Erase vehicles at the old position and draw them at the new one
+    QRegion region = dynamicRegion;
+    renderDynamicOverlay();
+    region += dynamicRegion;
+
+    dynamicDirty += region;
+    update(region);
+  }
+}
+
+void MapWidget::renderDynamicOverlay()
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  qreal ratio = devicePixelRatioF();
+  QSize pixelSize = size() * ratio;
+  if(dynamicOverlay.size() != pixelSize)
+  {
+    dynamicOverlay = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+    dynamicOverlay.setDevicePixelRatio(ratio);
+  }
+  dynamicOverlay.fill(Qt::transparent);
+  dynamicRegion = QRegion();
+
+  {
+    GeoPainter painter(&dynamicOverlay, viewport(), mapQuality());
+    paintLayer->renderDynamic(&painter, viewport(), dynamicRegion);
+  }
+  dynamicOverlayNs += timer.nsecsElapsed();
+}
+
+void MapWidget::paintDynamic(QPaintEvent *paintEvent)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  qreal ratio = devicePixelRatioF();
+  QSize pixelSize = size() * ratio;
+
+  if(dynamicBackgroundValid && dynamicBackground.size() == pixelSize &&
+     (paintEvent->region() - dynamicDirty).isEmpty())
+  {
+    // Only vehicles have changed - painting is clipped to the changed areas
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, dynamicBackground);
+    painter.drawImage(0, 0, dynamicOverlay);
+
+    dynamicFastPaints++;
+    dynamicFastNs += timer.nsecsElapsed();
+    const QRegion& region = paintEvent->region();
+    for(auto it = region.begin(); it != region.end(); ++it)
+      dynamicFastPixels += it->width() * it->height();
+  }
+  else
+  {
+    if(dynamicBackground.size() != pixelSize)
+    {
+      dynamicBackground = QPixmap(pixelSize);
+      dynamicBackground.setDevicePixelRatio(ratio);
+    }
+
+    // Render map without vehicles into the background - calls paintEvent recursively.
+    // The background includes Marble float items and user tools, so vehicles are drawn on top of these
+    // and on top of all other map objects while the dynamic layer is active.
+    renderingOffscreen = true;
+    paintLayer->setDynamicSeparate(true);
+    render(&dynamicBackground, QPoint(), QRegion(), QWidget::DrawWindowBackground);
+    paintLayer->setDynamicSeparate(false);
+    renderingOffscreen = false;
+    dynamicBackgroundValid = true;
+
+    renderDynamicOverlay();
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, dynamicBackground);
+    painter.drawImage(0, 0, dynamicOverlay);
+
+    if(isHistorySnapshotWanted(paintEvent))
+    {
+      QPixmap frame(dynamicBackground);
+      QPainter framePainter(&frame);
+      framePainter.drawImage(0, 0, dynamicOverlay);
+      framePainter.end();
+      saveHistorySnapshot(frame);
+    }
+
+    dynamicFullPaints++;
+    dynamicFullNs += timer.nsecsElapsed();
+  }
+  dynamicDirty = QRegion();
+
+  logDynamicStatistics();
+}
+
+void MapWidget::logDynamicStatistics()
+{
+  if(!paintLayer->isShowRenderStatistics())
+    return;
+
+  int paints = dynamicFastPaints + dynamicFullPaints;
+  if(paints >= 100)
+  {
+    // Time used for painting per second if each paint is caused by a simulator update at 10 Hz
+    qint64 totalNs = dynamicFastNs + dynamicFullNs + dynamicOverlayNs;
+    qDebug() << Q_FUNC_INFO
+             << "fast paints" << dynamicFastPaints
+             << "avg ms" << (dynamicFastPaints > 0 ? dynamicFastNs / dynamicFastPaints / 1000000. : 0.)
+             << "avg pixels" << (dynamicFastPaints > 0 ? dynamicFastPixels / dynamicFastPaints : 0)
+             << "full paints" << dynamicFullPaints
+             << "avg ms" << (dynamicFullPaints > 0 ? dynamicFullNs / dynamicFullPaints / 1000000. : 0.)
+             << "overlay total ms" << dynamicOverlayNs / 1000000.
+             << "ms per second at 10 Hz" << totalNs / paints * 10 / 1000000.;
+
+    dynamicFastPaints = dynamicFullPaints = 0;
+    dynamicFastNs = dynamicFullNs = dynamicOverlayNs = dynamicFastPixels = 0;
+  }
+}
+
 void MapWidget::highlightProfilePoint(const atools::geo::Pos& pos)
 {
   if(pos.isValid())
@@ -1051,6 +1293,7 @@ bool MapWidget::addKmlFile(const QString& kmlFile)
   {
     // Add to the list of files that will be reloaded on startup
     kmlFilePaths.append(kmlFile);
+    invalidateHistorySnapshots();
     // Successfully loaded
     return true;
   }
@@ -1064,6 +1307,7 @@ void MapWidget::clearKmlFiles()
   for(const QString& file : kmlFilePaths)
     model()->removeGeoData(file);
   kmlFilePaths.clear();
+  invalidateHistorySnapshots();
 }
 
 const map::MapSearchResult& MapWidget::getSearchHighlights() const
@@ -1112,19 +1356,16 @@ void MapWidget::updateRouteFromDrag(QPoint newPoint, mw::MouseStates state, int
   qDebug() << "End route drag" << newPoint << "state" << state << "leg" << leg << "point" << point;
 
   // Get all objects where the mouse button was released
+  // Fetch only ids of navaids from the cache which is sufficient if there are less than two results
   map::MapSearchResult result;
+  result.idsOnly = true;
   QList<proc::MapProcedurePoint> procPoints;
   screenIndex->getAllNearest(newPoint.x(), newPoint.y(), screenSearchDistance, result, procPoints);
 
   CoordinateConverter conv(viewport());
 
-  // Get objects from cache - already present objects will be skipped
-  mapQuery->getNearestObjects(conv, paintLayer->getMapLayer(), false,
-                              paintLayer->getShownMapObjects() &
-                              (map::AIRPORT_ALL | map::VOR | map::NDB | map::WAYPOINT),
-                              newPoint.x(), newPoint.y(), screenSearchDistance, result);
-
-  int totalSize = result.airports.size() + result.vors.size() + result.ndbs.size() + result.waypoints.size();
+  int totalSize = result.airports.size() + result.vors.size() + result.ndbs.size() + result.waypoints.size() +
+                  result.refs.size();
 
   int id = -1;
   map::MapObjectTypes type = map::NONE;
@@ -1140,7 +1381,12 @@ void MapWidget::updateRouteFromDrag(QPoint newPoint, mw::MouseStates state, int
     // Only one entry at the position - add single navaid without menu
     qDebug() << "add navaid";
 
-    if(!result.airports.isEmpty())
+    if(!result.refs.isEmpty())
+    {
+      id = result.refs.first().id;
+      type = result.refs.first().type;
+    }
+    else if(!result.airports.isEmpty())
     {
       id = result.airports.first().id;
       type = map::AIRPORT;
@@ -1167,6 +1413,9 @@ void MapWidget::updateRouteFromDrag(QPoint newPoint, mw::MouseStates state, int
     mouseState |= mw::DRAG_POST_MENU;
 
     // Multiple entries - build a menu with icons
+    // Load full objects for the menu texts
+    screenIndex->resolveSearchResult(newPoint.x(), newPoint.y(), result);
+
     // Add id and type to actions
     const int ICON_SIZE = 20;
     qDebug() << "add navaids" << totalSize;
@@ -2723,6 +2972,13 @@ void MapWidget::updateVisibleObjectsStatusBar()
 
 void MapWidget::paintEvent(QPaintEvent *paintEvent)
 {
+  if(renderingOffscreen)
+  {
+    // Nested call from paintDynamic or paintWithHistorySnapshot - paint the map only
+    MarbleWidget::paintEvent(paintEvent);
+    return;
+  }
+
   if(!active)
   {
     QPainter painter(this);
@@ -2730,10 +2986,21 @@ void MapWidget::paintEvent(QPaintEvent *paintEvent)
     return;
   }
 
+  if(!historyPreview.isNull())
+  {
+    // Show the cached snapshot after jumping in history and do the full rendering in the next event loop cycle
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawPixmap(rect(), historyPreview);
+    historyPreview = QPixmap();
+    QTimer::singleShot(0, this, static_cast<void (QWidget::*)()>(&QWidget::update));
+    return;
+  }
+
   bool changed = false;
   const GeoDataLatLonAltBox visibleLatLonAltBox = viewport()->viewLatLonAltBox();
 
-  if(viewContext() == Marble::Still &&
+  if(historyRecording && viewContext() == Marble::Still &&
      (zoom() != currentZoom || visibleLatLonAltBox != currentViewBoundingBox))
   {
     // This paint event has changed zoom or the visible bounding box
@@ -2749,9 +3016,26 @@ void MapWidget::paintEvent(QPaintEvent *paintEvent)
 
     changedByHistory = false;
     changed = true;
+
+    if(historySnapshots.maxCost() > 0)
+    {
+      historySnapshotCapture = true;
+      historySnapshotTimer.start();
+    }
   }
 
-  MarbleWidget::paintEvent(paintEvent);
+  if(isDynamicLayerActive())
+    paintDynamic(paintEvent);
+  else if(isHistorySnapshotWanted(paintEvent))
+  {
+    dynamicBackgroundValid = false;
+    paintWithHistorySnapshot(paintEvent);
+  }
+  else
+  {
+    dynamicBackgroundValid = false;
+    MarbleWidget::paintEvent(paintEvent);
+  }
 
   if(changed)
   {
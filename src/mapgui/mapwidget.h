@@ -23,6 +23,10 @@
 #include "fs/sc/simconnectdata.h"
 #include "common/aircrafttrack.h"
 
+#include <QCache>
+#include <QImage>
+#include <QPixmap>
+#include <QRegion>
 #include <QTimer>
 #include <QWidget>
 
@@ -244,6 +248,17 @@ public:
     return mainWindow;
   }
 
+  /* Layer containing all painters */
+  MapPaintLayer *getPaintLayer() const
+  {
+    return paintLayer;
+  }
+
+  MapScreenIndex *getScreenIndex() const
+  {
+    return screenIndex;
+  }
+
   const QStringList& getKmlFiles() const
   {
     return kmlFilePaths;
@@ -257,6 +272,13 @@ public:
 
   void showOverlays(bool show);
 
+  /* Disable recording of view changes in the history and snapshots while the view is changed temporarily
+   * like in tile export. The last recorded view is kept and has to be restored by the caller. */
+  void setHistoryRecording(bool enable)
+  {
+    historyRecording = enable;
+  }
+
   /* Stores delta values depending on fast or slow update. User aircraft is only updated if
    * delta values are exceeded. */
   struct SimUpdateDelta
@@ -363,6 +385,37 @@ private:
   void cancelDragRoute();
   void elevationDisplayTimerTimeout();
 
+  /* true if vehicles are drawn into a separate overlay on top of a cached map background */
+  bool isDynamicLayerActive();
+
+  /* Repaint only the changed vehicle areas if the background is valid. Otherwise or if full is true
+   * the whole map is updated. */
+  void updateDynamicLayer(bool full);
+
+  /* Use a snapshot for the history entry if available for the next paint event */
+  void showHistoryPreview(const atools::gui::MapPosHistoryEntry& entry);
+
+  /* Stop capturing snapshots once the map is idle */
+  void historySnapshotTimeout();
+  static QString historyKey(const atools::geo::Pos& pos, double distance);
+
+  /* Drop all snapshots after changes of the map content and capture the current view again */
+  void invalidateHistorySnapshots();
+
+  /* true if the paint event should be rendered offscreen to save a snapshot for the history */
+  bool isHistorySnapshotWanted(QPaintEvent *paintEvent);
+
+  /* Render the map into a pixmap, draw it and save a downscaled copy for the current history entry */
+  void paintWithHistorySnapshot(QPaintEvent *paintEvent);
+  void saveHistorySnapshot(const QPixmap& frame);
+
+  /* Draw vehicles and trail into the overlay image and update dynamicRegion */
+  void renderDynamicOverlay();
+
+  /* Paint the map from background and overlay. Background is rendered again if needed. */
+  void paintDynamic(QPaintEvent *paintEvent);
+  void logDynamicStatistics();
+
   /* Defines amount of objects and other attributes on the map. min 5, max 15, default 10. */
   int mapDetailLevel;
 
@@ -418,6 +471,20 @@ private:
   /* Need to check if the zoom and position was changed by the map history to avoid recursion */
   bool changedByHistory = false;
 
+  /* false while the view is changed temporarily */
+  bool historyRecording = true;
+
+  /* Downscaled map snapshots for history entries with cost in kB. Key is built from position and distance.
+   * Disabled if the cache size is 0. */
+  QCache<QString, QPixmap> historySnapshots;
+  QTimer historySnapshotTimer;
+
+  /* Paint events are rendered offscreen and saved as snapshot while true */
+  bool historySnapshotCapture = false;
+
+  /* Shown instead of a full rendering once after jumping in history */
+  QPixmap historyPreview;
+
   /* Values used to check if view has changed */
   Marble::GeoDataLatLonAltBox currentViewBoundingBox;
 
@@ -428,6 +495,25 @@ private:
 
   /* Delay display of elevation display to avoid lagging mouse movements */
   QTimer elevationDisplayTimer;
+
+  /* Static map without vehicles and transparent overlay with vehicles and trail for fast updates.
+   * The overlay is drawn above the whole map including float items like the compass or scale bar. */
+  QPixmap dynamicBackground;
+  QImage dynamicOverlay;
+
+  /* Screen area covered by vehicles in the overlay and area that was updated since the last paint event */
+  QRegion dynamicRegion, dynamicDirty;
+  bool dynamicBackgroundValid = false;
+
+  /* Active flight plan leg painted into the background */
+  int lastActiveLegIndex = -1;
+
+  /* Set while the map is rendered into a pixmap by a nested paint event */
+  bool renderingOffscreen = false;
+
+  /* Paint times for the render statistics log */
+  int dynamicFastPaints = 0, dynamicFullPaints = 0;
+  qint64 dynamicFastNs = 0, dynamicFullNs = 0, dynamicOverlayNs = 0, dynamicFastPixels = 0;
 };
 
 Q_DECLARE_TYPEINFO(MapWidget::SimUpdateDelta, Q_PRIMITIVE_TYPE);
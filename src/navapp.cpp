@@ -30,6 +30,7 @@
 #include "common/elevationprovider.h"
 #include "fs/common/magdecreader.h"
 #include "common/updatehandler.h"
+#include "common/magdecgrid.h"
 
 #include "ui_mainwindow.h"
 
@@ -53,6 +54,7 @@ atools::fs::db::DatabaseMeta *NavApp::databaseMetaNav = nullptr;
 QSplashScreen *NavApp::splashScreen = nullptr;
 
 atools::fs::common::MagDecReader *NavApp::magDecReader = nullptr;
+MagDecGrid *NavApp::magDecGrid = nullptr;
 UpdateHandler *NavApp::updateHandler = nullptr;
 
 bool NavApp::shuttingDown = false;
@@ -86,6 +88,12 @@ void NavApp::init(MainWindow *mainWindowParam)
   magDecReader = new atools::fs::common::MagDecReader();
   magDecReader->readFromTable(*databaseManager->getDatabaseSim());
 
+  magDecGrid = new MagDecGrid();
+  magDecGrid->init(*magDecReader);
+#ifdef DEBUG_MAGDEC_BENCHMARK
+  magDecGrid->benchmark(*magDecReader);
+#endif
+
   mapQuery = new MapQuery(mainWindow, databaseManager->getDatabaseSim(), databaseManager->getDatabaseNav());
   mapQuery->initQueries();
 
@@ -166,6 +174,10 @@ void NavApp::deInit()
   delete magDecReader;
   magDecReader = nullptr;
 
+  qDebug() << Q_FUNC_INFO << "delete magDecGrid";
+  delete magDecGrid;
+  magDecGrid = nullptr;
+
   qDebug() << Q_FUNC_INFO << "delete splashScreen";
   delete splashScreen;
   splashScreen = nullptr;
@@ -206,6 +218,7 @@ void NavApp::postDatabaseLoad()
   databaseMetaNav = new atools::fs::db::DatabaseMeta(getDatabaseNav());
 
   magDecReader->readFromTable(*getDatabaseSim());
+  magDecGrid->init(*magDecReader);
   airportQuerySim->initQueries();
   airportQueryNav->initQueries();
   mapQuery->initQueries();
@@ -420,12 +433,21 @@ void NavApp::setShuttingDown(bool value)
 
 float NavApp::getMagVar(const atools::geo::Pos& pos, float defaultValue)
 {
-  if(magDecReader != nullptr && magDecReader->isValid())
-    return magDecReader->getMagVar(pos);
+  if(magDecGrid != nullptr && magDecGrid->isValid())
+    return magDecGrid->getMagVar(pos);
   else
     return defaultValue;
 }
 
+void NavApp::getMagVars(QVector<float>& magvars, const QVector<atools::geo::Pos>& positions,
+                        float defaultValue)
+{
+  if(magDecGrid != nullptr && magDecGrid->isValid())
+    magDecGrid->getMagVars(magvars, positions);
+  else
+    magvars.fill(defaultValue, positions.size());
+}
+
 UpdateHandler *NavApp::getUpdateHandler()
 {
   return updateHandler;
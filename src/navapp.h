@@ -23,6 +23,8 @@
 #include "common/mapflags.h"
 #include "fs/fspaths.h"
 
+#include <QVector>
+
 class AirportQuery;
 class MapQuery;
 class InfoQuery;
@@ -39,6 +41,7 @@ class ElevationProvider;
 class AircraftTrack;
 class QSplashScreen;
 class UpdateHandler;
+class MagDecGrid;
 
 namespace atools {
 
@@ -161,8 +164,13 @@ public:
   static bool isShuttingDown();
   static void setShuttingDown(bool value);
 
+  /* Magnetic variance interpolated from the declination grid */
   static float getMagVar(const atools::geo::Pos& pos, float defaultValue = 0.f);
 
+  /* Batch version of the method above. magvars is resized to the size of positions. */
+  static void getMagVars(QVector<float>& magvars, const QVector<atools::geo::Pos>& positions,
+                         float defaultValue = 0.f);
+
   static UpdateHandler *getUpdateHandler();
 
 private:
@@ -176,6 +184,7 @@ private:
   static ConnectClient *connectClient;
   static DatabaseManager *databaseManager;
   static atools::fs::common::MagDecReader *magDecReader;
+  static MagDecGrid *magDecGrid;
 
   /* Main window is not aggregated */
   static MainWindow *mainWindow;
@@ -0,0 +1,233 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "print/briefingexport.h"
+
+#include "navapp.h"
+#include "gui/mainwindow.h"
+#include "mapgui/mapwidget.h"
+#include "mapgui/maptileexport.h"
+#include "print/printsupport.h"
+#include "route/routecontroller.h"
+#include "common/unit.h"
+#include "common/weatherreporter.h"
+#include "exception.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QTextDocument>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QApplication>
+#include <QtPrintSupport/QPrinter>
+#include <QtConcurrent/QtConcurrentRun>
+
+using atools::fs::pln::Flightplan;
+
+BriefingExport::BriefingExport(MainWindow *mainWindowParam)
+  : mainWindow(mainWindowParam)
+{
+
+}
+
+bool BriefingExport::run(const QStringList& flightplanFiles, const QString& outputDir, int scale)
+{
+  qInfo() << Q_FUNC_INFO << "Creating" << flightplanFiles.size() << "briefings in" << outputDir;
+
+  bool ok = true;
+  for(const QString& file : flightplanFiles)
+  {
+    QString dir = QDir(outputDir).filePath(QFileInfo(file).completeBaseName());
+    if(!createBriefing(file, dir, scale))
+    {
+      qWarning() << Q_FUNC_INFO << "Briefing failed for" << file;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool BriefingExport::loadFlightplan(const QString& flightplanFile)
+{
+  try
+  {
+    // Load here to avoid error dialogs on headless systems
+    Flightplan flightplan;
+    flightplan.load(flightplanFile);
+
+    // Convert altitude to local unit
+    flightplan.setCruisingAltitude(atools::roundToInt(Unit::altFeetF(flightplan.getCruisingAltitude())));
+
+    NavApp::getRouteController()->loadFlightplan(flightplan, flightplanFile, true /*quiet*/,
+                                                 false /*changed*/, false /*adjust alt*/,
+                                                 flightplan.getProperties().value(
+                                                   atools::fs::pln::SPEED).toFloat());
+  }
+  catch(atools::Exception& e)
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot load" << flightplanFile << e.what();
+    return false;
+  }
+  catch(...)
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot load" << flightplanFile;
+    return false;
+  }
+
+  // Failed FLP files leave the previous flight plan in place
+  return NavApp::getRouteController()->getCurrentRouteFilename() == flightplanFile;
+}
+
+void BriefingExport::waitForWeather()
+{
+  WeatherReporter *weatherReporter = NavApp::getWeatherReporter();
+  if(!weatherReporter->hasPendingRequests())
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Poll since failed requests do not emit a signal
+  QEventLoop eventLoop;
+  QTimer pollTimer;
+  QObject::connect(&pollTimer, &QTimer::timeout, &eventLoop, [&]() -> void
+  {
+    if(!weatherReporter->hasPendingRequests() || timer.elapsed() > WEATHER_TIMEOUT_MS)
+      eventLoop.quit();
+  });
+  pollTimer.start(100);
+  eventLoop.exec();
+
+  if(weatherReporter->hasPendingRequests())
+    qWarning() << Q_FUNC_INFO << "Timeout waiting for weather";
+}
+
+bool BriefingExport::createBriefing(const QString& flightplanFile, const QString& outputDir, int scale)
+{
+  qInfo() << Q_FUNC_INFO << flightplanFile << "to" << outputDir;
+
+  if(!QDir().mkpath(outputDir))
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot create directory" << outputDir;
+    return false;
+  }
+
+  if(!loadFlightplan(flightplanFile))
+    return false;
+
+  const Route& route = NavApp::getRoute();
+  if(route.isEmpty())
+  {
+    qWarning() << Q_FUNC_INFO << "Flight plan is empty" << flightplanFile;
+    return false;
+  }
+
+  PrintSupport *printSupport = mainWindow->getPrintSupport();
+  QDir dir(outputDir);
+
+  // Start online weather requests which are fetched in background while the map is rendered
+  printSupport->fillWeatherCache();
+
+  // Map showing the whole flight plan =============================
+  MapWidget *mapWidget = mainWindow->getMapWidget();
+  mapWidget->showRect(route.getBoundingRect(), false);
+  QApplication::processEvents();
+
+  bool ok = true;
+  MapTileExport tileExport(mapWidget);
+  if(!tileExport.exportImage(dir.filePath("map.png"), scale, mainWindow))
+  {
+    qWarning() << Q_FUNC_INFO << "Map export failed" << tileExport.getErrorMessage();
+    ok = false;
+  }
+
+  // Weather has to be complete before creating the pages to get the same result on each run
+  waitForWeather();
+
+  // Flight plan and airport information =============================
+  prt::PrintFlightPlanOpts opts = prt::FLIGHTPLAN | prt::DEPARTURE_ANY | prt::DEPARTURE_RUNWAYS_DETAIL |
+                                  prt::DESTINATION_ANY | prt::DESTINATION_RUNWAYS_DETAIL;
+  QFont font;
+  QStringList pages = printSupport->createFlightplanHtml(font, opts, 100);
+
+  // Layout document in background while the HTML file is written
+  bool threaded = QFontDatabase::supportsThreadedFontRendering();
+  QFuture<QTextDocument *> documentFuture;
+  if(threaded)
+    documentFuture = QtConcurrent::run(&PrintSupport::createFlightplanDocument,
+                                       font, pages, QThread::currentThread());
+
+  QString title = tr("%1 Briefing %2").arg(QApplication::applicationName()).
+                  arg(QFileInfo(flightplanFile).completeBaseName());
+  if(!writeHtml(dir.filePath("briefing.html"), title, pages))
+    ok = false;
+
+  QTextDocument *document = threaded ? documentFuture.result() :
+                            // Platform cannot use fonts outside the GUI thread
+                            PrintSupport::createFlightplanDocument(font, pages, QThread::currentThread());
+  if(!writePdf(dir.filePath("briefing.pdf"), document))
+    ok = false;
+  delete document;
+
+  return ok;
+}
+
+bool BriefingExport::writeHtml(const QString& filename, const QString& title, const QStringList& pages)
+{
+  QFile file(filename);
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+  {
+    qWarning() << Q_FUNC_INFO << "Cannot open" << filename << file.errorString();
+    return false;
+  }
+
+  QTextStream out(&file);
+  out.setCodec("UTF-8");
+  out << "<!DOCTYPE html>" << endl
+      << "<html><head><meta charset=\"UTF-8\"/><title>" << title.toHtmlEscaped() << "</title></head>" << endl
+      << "<body>" << endl
+      << "<p><img src=\"map.png\" style=\"max-width: 100%;\"/></p>" << endl;
+
+  for(const QString& page : pages)
+    out << "<div style=\"page-break-before: always;\">" << endl << page << endl << "</div>" << endl;
+
+  out << "</body></html>" << endl;
+
+  file.close();
+  return file.error() == QFileDevice::NoError;
+}
+
+bool BriefingExport::writePdf(const QString& filename, QTextDocument *document)
+{
+  if(document == nullptr)
+    return false;
+
+  QPrinter printer(QPrinter::HighResolution);
+  printer.setOutputFormat(QPrinter::PdfFormat);
+  printer.setOutputFileName(filename);
+  document->print(&printer);
+
+  bool ok = QFileInfo(filename).exists();
+  if(!ok)
+    qWarning() << Q_FUNC_INFO << "Cannot write" << filename;
+  return ok;
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_BRIEFINGEXPORT_H
+#define LITTLENAVMAP_BRIEFINGEXPORT_H
+
+#include <QCoreApplication>
+
+class MainWindow;
+class QTextDocument;
+
+/*
+ * Creates briefing packages for a list of flight plan files without user interaction.
+ * Started by the command line option "--briefing". Use "-platform offscreen" to run it on a headless machine.
+ *
+ * Each flight plan is loaded into the route controller and the following files are written into a
+ * sub directory of the output directory named after the flight plan file:
+ *
+ * map.png          Map showing the whole flight plan rendered in tiles at the given scale
+ * briefing.html    Flight plan table, departure and destination information including weather
+ * briefing.pdf     Same as HTML as printed document
+ *
+ * Online weather is requested first and fetched in background while the map is rendered. Pending requests
+ * are awaited with a timeout before the flight plan pages are created. Layout of the print document is done
+ * in a worker thread while the HTML file is written if the platform supports it.
+ */
+class BriefingExport
+{
+  Q_DECLARE_TR_FUNCTIONS(BriefingExport)
+
+public:
+  BriefingExport(MainWindow *mainWindowParam);
+
+  /* Create briefings for all files. Returns false if one or more briefings failed. */
+  bool run(const QStringList& flightplanFiles, const QString& outputDir, int scale);
+
+private:
+  bool createBriefing(const QString& flightplanFile, const QString& outputDir, int scale);
+  bool loadFlightplan(const QString& flightplanFile);
+
+  /* Process events until all online weather requests are finished or the timeout is exceeded */
+  void waitForWeather();
+  bool writeHtml(const QString& filename, const QString& title, const QStringList& pages);
+  bool writePdf(const QString& filename, QTextDocument *document);
+
+  MainWindow *mainWindow;
+
+  /* Maximum time to wait for online weather */
+  static Q_DECL_CONSTEXPR int WEATHER_TIMEOUT_MS = 20000;
+};
+
+#endif // LITTLENAVMAP_BRIEFINGEXPORT_H
@@ -29,6 +29,10 @@
 #include "common/weatherreporter.h"
 #include "connect/connectclient.h"
 #include "gui/mainwindow.h"
+#include "query/infoquery.h"
+#include "query/mapquery.h"
+#include "common/formatter.h"
+#include "common/unit.h"
 
 #include <QPainter>
 #include <QtPrintSupport/QPrintPreviewDialog>
@@ -43,6 +47,9 @@
 #include <QTextDocumentWriter>
 #include <QThread>
 #include <QMainWindow>
+#include <QTimer>
+#include <QFontDatabase>
+#include <QtConcurrent/QtConcurrentRun>
 
 using atools::settings::Settings;
 using atools::util::HtmlBuilder;
@@ -56,10 +63,20 @@ PrintSupport::PrintSupport(MainWindow *parent)
           this, &PrintSupport::printPreviewFlightplanClicked);
   connect(printFlightplanDialog, &PrintDialog::printClicked,
           this, &PrintSupport::printFlightplanClicked);
+  connect(&documentWatcher, &QFutureWatcher<QTextDocument *>::finished,
+          this, &PrintSupport::flightplanDocumentFinished);
 }
 
 PrintSupport::~PrintSupport()
 {
+  if(documentResultPending)
+  {
+    // Worker is still running or finished signal was not delivered yet
+    documentWatcher.waitForFinished();
+    delete documentWatcher.result();
+  }
+
+  delete flightPlanPrinter;
   delete printFlightplanDialog;
   delete mapScreenPrintPixmap;
   delete flightPlanPrintDocument;
@@ -85,7 +102,9 @@ void PrintSupport::printFlightplan()
 {
   qDebug() << Q_FUNC_INFO;
 
-  fillWeatherCache();
+  // Fill weather cache once the dialog is shown - NOAA and VATSIM requests run in background
+  // while the user is selecting options
+  QTimer::singleShot(0, this, &PrintSupport::fillWeatherCache);
 
   printFlightplanDialog->exec();
 }
@@ -109,33 +128,8 @@ void PrintSupport::printPreviewFlightplanClicked()
 {
   qDebug() << Q_FUNC_INFO;
 
-  QString cssContent;
-  // QString css = atools::settings::Settings::getOverloadedPath(":/littlenavmap/resources/css/print.css");
-  // QFile f(css);
-  // if(f.open(QIODevice::ReadOnly | QIODevice::Text))
-  // {
-  // QTextStream in(&f);
-  // cssContent = in.readAll();
-  // }
-
-  createFlightplanDocuments();
-
-  QPrintPreviewDialog *print = buildPreviewDialog(printFlightplanDialog);
-  connect(print, &QPrintPreviewDialog::paintRequested, this, &PrintSupport::paintRequestedFlightplan);
-  print->exec();
-  disconnect(print, &QPrintPreviewDialog::paintRequested, this, &PrintSupport::paintRequestedFlightplan);
-  deletePreviewDialog(print);
-
-  // QFile f2("/home/alex/Temp/lnm_route_export.html");
-  // if(f2.open(QIODevice::Text | QIODevice::WriteOnly))
-  // {
-  // QTextStream ds(&f2);
-  // ds << html.getHtml();
-  // f2.close();
-  // QDesktopServices::openUrl(QUrl::fromLocalFile("/home/alex/Temp/lnm_route_export.html"));
-  // }
-
-  deleteFlightplanDocuments();
+  // Preview is opened once the document is ready
+  startFlightplanDocument(PREVIEW);
 }
 
 /* Open print dialog for printing (no preview). Called from PrintDialog  */
@@ -143,36 +137,154 @@ void PrintSupport::printFlightplanClicked()
 {
   qDebug() << Q_FUNC_INFO;
 
-  QPrinter printer;
+  if(documentWatcher.isRunning())
+    return;
+
+  delete flightPlanPrinter;
+  flightPlanPrinter = new QPrinter;
   // printer.setOutputFormat(QPrinter::NativeFormat);
   // printer.setOutputFileName("LittleNavmapFlightplan");
-  QPrintDialog dialog(&printer, printFlightplanDialog);
+  QPrintDialog dialog(flightPlanPrinter, printFlightplanDialog);
 
   dialog.setWindowTitle(tr("Print Flight Plan"));
   if(dialog.exec() == QDialog::Accepted)
+    // Printing is done once the document is ready
+    startFlightplanDocument(PRINT);
+  else
+  {
+    delete flightPlanPrinter;
+    flightPlanPrinter = nullptr;
+  }
+}
+
+void PrintSupport::startFlightplanDocument(DocumentAction action)
+{
+  if(documentWatcher.isRunning())
+  {
+    qDebug() << Q_FUNC_INFO << "Document creation already running";
+    return;
+  }
+
+  deleteFlightplanDocuments();
+  documentAction = action;
+
+  QFont font;
+  QStringList pages = createFlightplanHtml(font, printFlightplanDialog->getPrintOptions(),
+                                           printFlightplanDialog->getPrintTextSize());
+
+  QGuiApplication::setOverrideCursor(Qt::WaitCursor);
+
+  if(QFontDatabase::supportsThreadedFontRendering())
+  {
+    // Parsing the HTML and layout of the document is done in background - document is moved
+    // back to the GUI thread when finished
+    documentWatcher.setFuture(QtConcurrent::run(&PrintSupport::createFlightplanDocument,
+                                                font, pages, QThread::currentThread()));
+    documentResultPending = true;
+  }
+  else
+  {
+    // Platform cannot use fonts outside the GUI thread
+    flightPlanPrintDocument = createFlightplanDocument(font, pages, QThread::currentThread());
+    flightplanDocumentFinished();
+  }
+}
+
+void PrintSupport::flightplanDocumentFinished()
+{
+  if(documentAction == NONE)
+    return;
+
+  QGuiApplication::restoreOverrideCursor();
+
+  if(documentResultPending)
+  {
+    // Created in background
+    flightPlanPrintDocument = documentWatcher.result();
+    documentResultPending = false;
+  }
+
+  DocumentAction action = documentAction;
+  documentAction = NONE;
+
+  if(flightPlanPrintDocument == nullptr)
+    return;
+
+  if(action == PREVIEW)
+    showFlightplanPreview();
+  else if(action == PRINT && flightPlanPrinter != nullptr)
   {
-    createFlightplanDocuments();
-    paintRequestedFlightplan(&printer);
-    deleteFlightplanDocuments();
+    paintRequestedFlightplan(flightPlanPrinter);
 
     // Close settings dialog if the user printed
     printFlightplanDialog->hide();
   }
+
+  deleteFlightplanDocuments();
+  delete flightPlanPrinter;
+  flightPlanPrinter = nullptr;
 }
 
-/* Fill the flightPlanDocument with HTML code depending on selected options */
-void PrintSupport::createFlightplanDocuments()
+void PrintSupport::showFlightplanPreview()
 {
-  deleteFlightplanDocuments();
-  flightPlanPrintDocument = new QTextDocument();
+  QPrintPreviewDialog *print = buildPreviewDialog(printFlightplanDialog);
+  connect(print, &QPrintPreviewDialog::paintRequested, this, &PrintSupport::paintRequestedFlightplan);
+  print->exec();
+  disconnect(print, &QPrintPreviewDialog::paintRequested, this, &PrintSupport::paintRequestedFlightplan);
+  deletePreviewDialog(print);
+}
+
+QTextDocument *PrintSupport::createFlightplanDocument(const QFont& font, const QStringList& pages,
+                                                      QThread *targetThread)
+{
+  // Document is owned by the calling thread until moved
+  QTextDocument *document = new QTextDocument();
+  document->setDefaultFont(font);
+
+  // Create a cursor to append html and page breaks
+  QTextCursor cursor(document);
+
+  // Create a block format inserting page breakss
+  QTextBlockFormat pageBreakBlock;
+  pageBreakBlock.setPageBreakPolicy(QTextFormat::PageBreak_AlwaysBefore);
+
+  for(int i = 0; i < pages.size(); i++)
+  {
+    // Add to document and add a page feed, if needed
+    cursor.movePosition(QTextCursor::End, QTextCursor::MoveAnchor);
+    if(i > 0)
+      cursor.insertBlock(pageBreakBlock);
+    cursor.insertHtml(pages.at(i));
+  }
+
+  document->adjustSize();
+
+  // QFile file(QStandardPaths::standardLocations(
+  // QStandardPaths::TempLocation).first() + QDir::separator() + "little_navmap_print.html");
+  // if(file.open(QIODevice::WriteOnly))
+  // {
+  // qDebug() << "Writing print to" << file.fileName();
+  // QTextDocumentWriter writer(&file, "HTML");
+  // writer.write(flightPlanDocument);
+  // QDesktopServices::openUrl(QUrl::fromLocalFile(file.fileName()));
+  // file.close();
+  // }
+
+  if(document->thread() != targetThread)
+    document->moveToThread(targetThread);
+  return document;
+}
 
-  QFont font = flightPlanPrintDocument->defaultFont();
+/* Create HTML for all pages depending on selected options */
+QStringList PrintSupport::createFlightplanHtml(QFont& font, prt::PrintFlightPlanOpts opts, int printTextSize)
+{
+  QStringList pages;
+
+  font = QTextDocument().defaultFont();
   qDebug() << "font pixel size" << font.pixelSize() << "font point size" << font.pointSizeF();
 
 #ifdef Q_OS_MACOS
-  int printTextSize = printFlightplanDialog->getPrintTextSize() / 2;
-#else
-  int printTextSize = printFlightplanDialog->getPrintTextSize();
+  printTextSize /= 2;
 #endif
 
   // Adjust font size according to dialog setting
@@ -183,16 +295,6 @@ void PrintSupport::createFlightplanDocuments()
   else
     qWarning() << "Unable to set font size";
 
-  flightPlanPrintDocument->setDefaultFont(font);
-
-  // Create a cursor to append html and page breaks
-  QTextCursor cursor(flightPlanPrintDocument);
-
-  // Create a block format inserting page breakss
-  QTextBlockFormat pageBreakBlock;
-  pageBreakBlock.setPageBreakPolicy(QTextFormat::PageBreak_AlwaysBefore);
-
-  prt::PrintFlightPlanOpts opts = printFlightplanDialog->getPrintOptions();
   atools::util::HtmlBuilder html(false);
 
   const Route& route = NavApp::getRoute();
@@ -207,11 +309,8 @@ void PrintSupport::createFlightplanDocuments()
     QFontMetricsF metrics(font);
 
     // Print the flight plan table
-    html.append(NavApp::getRouteController()->flightplanTableAsHtml(metrics.height()));
-
-    addHeader(cursor);
-    cursor.movePosition(QTextCursor::End, QTextCursor::MoveAnchor);
-    cursor.insertHtml(html.getHtml());
+    pages.append(headerHtml() + NavApp::getRouteController()->flightplanTableAsHtml(metrics.height()) +
+                 routeAirspacesHtml(route));
   }
 
   HtmlInfoBuilder builder(mainWindow, true /*info*/, true /*print*/);
@@ -223,6 +322,9 @@ void PrintSupport::createFlightplanDocuments()
     // print start and destination information if these are airports
     if(printAnyDeparture)
     {
+      // Load all records needed for the airport at once
+      NavApp::getInfoQuery()->prefetchAirportInformation(
+        route.first().getAirport().id, mapQuery->getAirportNav(route.first().getAirport()).id);
 
       // Create HTML fragments
       html.clear().table();
@@ -272,16 +374,14 @@ void PrintSupport::createFlightplanDocuments()
       html.trEnd();
       html.tableEnd();
 
-      // Add to document and add a page feed, if needed
-      cursor.movePosition(QTextCursor::End, QTextCursor::MoveAnchor);
-      if(printFlightplan)
-        cursor.insertBlock(pageBreakBlock);
-      addHeader(cursor);
-      cursor.insertHtml(html.getHtml());
+      pages.append(headerHtml() + html.getHtml());
     }
 
     if(printAnyDestination)
     {
+      NavApp::getInfoQuery()->prefetchAirportInformation(
+        route.last().getAirport().id, mapQuery->getAirportNav(route.last().getAirport()).id);
+
       // Create HTML fragments
       html.clear().table();
       HtmlBuilder destinationHtml(true);
@@ -332,31 +432,15 @@ void PrintSupport::createFlightplanDocuments()
       html.trEnd();
       html.tableEnd();
 
-      // Add to document and add a page feed, if needed
-      cursor.movePosition(QTextCursor::End, QTextCursor::MoveAnchor);
-      if(printAnyDeparture || printFlightplan)
-        cursor.insertBlock(pageBreakBlock);
-      addHeader(cursor);
-      cursor.insertHtml(html.getHtml());
+      pages.append(headerHtml() + html.getHtml());
     }
   }
 
-  flightPlanPrintDocument->adjustSize();
-
-  // QFile file(QStandardPaths::standardLocations(
-  // QStandardPaths::TempLocation).first() + QDir::separator() + "little_navmap_print.html");
-  // if(file.open(QIODevice::WriteOnly))
-  // {
-  // qDebug() << "Writing print to" << file.fileName();
-  // QTextDocumentWriter writer(&file, "HTML");
-  // writer.write(flightPlanDocument);
-  // QDesktopServices::openUrl(QUrl::fromLocalFile(file.fileName()));
-  // file.close();
-  // }
+  return pages;
 }
 
-/* Add header paragraph at cursor position */
-void PrintSupport::addHeader(QTextCursor& cursor)
+/* Get header paragraph */
+QString PrintSupport::headerHtml()
 {
   atools::util::HtmlBuilder html(true);
   html.p(tr("%1 Version %2 (revision %3) on %4 ").
@@ -364,7 +448,42 @@ void PrintSupport::addHeader(QTextCursor& cursor)
          arg(QApplication::applicationVersion()).
          arg(GIT_REVISION).
          arg(QLocale().toString(QDateTime::currentDateTime()))).br().br();
-  cursor.insertHtml(html.getHtml());
+  return html.getHtml();
+}
+
+QString PrintSupport::routeAirspacesHtml(const Route& route)
+{
+  atools::geo::LineString line;
+  for(int i = 0; i < route.size(); i++)
+    line.append(route.getPositionAt(i));
+
+  // Ignore altitude to include airspaces passed in climb and descent
+  QList<map::MapAirspace> airspaces;
+  mapQuery->getAirspacesForLine(airspaces, line, -1.f);
+  if(airspaces.isEmpty())
+    return QString();
+
+  atools::util::HtmlBuilder html(true);
+  html.br().h4(tr("Airspaces"));
+  html.table();
+  for(const map::MapAirspace& airspace : airspaces)
+  {
+    QString minAlt = airspace.minAltitudeType.isEmpty() ? tr("Unknown") :
+                     Unit::altFeet(airspace.minAltitude) + " " + airspace.minAltitudeType;
+
+    QString maxAlt;
+    if(airspace.maxAltitudeType.isEmpty())
+      maxAlt = tr("Unknown");
+    else if(airspace.maxAltitudeType == "UL")
+      maxAlt = tr("Unlimited");
+    else
+      maxAlt = Unit::altFeet(airspace.maxAltitude) + " " + airspace.maxAltitudeType;
+
+    html.row2(tr("%1 (%2)").arg(formatter::capNavString(airspace.name)).
+              arg(map::airspaceTypeToString(airspace.type)), tr("%1 to %2").arg(minAlt).arg(maxAlt));
+  }
+  html.tableEnd();
+  return html.getHtml();
 }
 
 void PrintSupport::deleteFlightplanDocuments()
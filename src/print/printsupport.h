@@ -18,7 +18,11 @@
 #ifndef LITTLENAVMAP_PRINTSUPPORT_H
 #define LITTLENAVMAP_PRINTSUPPORT_H
 
+#include "print/printdialog.h"
+
 #include <QCoreApplication>
+#include <QFutureWatcher>
+#include <QFont>
 
 class MainWindow;
 class QPrinter;
@@ -26,10 +30,11 @@ class QPixmap;
 class QPainter;
 class QPrintPreviewDialog;
 class QTextDocument;
-class PrintDialog;
 class MapQuery;
 class InfoQuery;
 class QTextCursor;
+class QThread;
+class Route;
 
 namespace atools {
 namespace util {
@@ -58,6 +63,17 @@ public:
   void saveState();
   void restoreState();
 
+  /* Create HTML fragments for all pages including header using the given options and text size in percent.
+   * Returns font adjusted by text size. */
+  QStringList createFlightplanHtml(QFont& font, prt::PrintFlightPlanOpts opts, int printTextSize);
+
+  /* Create and layout document from HTML pages. Can be called from a worker thread. The document is
+   * moved to targetThread after creation. */
+  static QTextDocument *createFlightplanDocument(const QFont& font, const QStringList& pages, QThread *targetThread);
+
+  /* Request weather for departure and destination. Online weather is fetched in background. */
+  void fillWeatherCache();
+
   /* Draw program name, version and date into an image */
   static void drawWatermark(const QPoint& pos, QPainter *painter);
   static void drawWatermark(const QPoint& pos, QPixmap *pixmap);
@@ -70,10 +86,25 @@ private:
   void deletePreviewDialog(QPrintPreviewDialog *print);
   void printPreviewFlightplanClicked();
   void printFlightplanClicked();
-  void createFlightplanDocuments();
+  /* What to do once the document is ready */
+  enum DocumentAction
+  {
+    NONE,
+    PREVIEW,
+    PRINT
+  };
+
+  /* Start creation of flight plan document. HTML fragments are created here in the GUI thread and
+   * document assembly and layout is done in a worker thread. Calls flightplanDocumentFinished when done. */
+  void startFlightplanDocument(DocumentAction action);
+  void flightplanDocumentFinished();
+
+  void showFlightplanPreview();
   void deleteFlightplanDocuments();
-  void addHeader(QTextCursor& cursor);
-  void fillWeatherCache();
+  QString headerHtml();
+
+  /* Table of all airspaces crossed by the flight plan at any altitude. Empty if none. */
+  QString routeAirspacesHtml(const Route& route);
 
   MainWindow *mainWindow;
   PrintDialog *printFlightplanDialog = nullptr;
@@ -82,6 +113,16 @@ private:
   QTextDocument *flightPlanPrintDocument = nullptr;
   QPixmap *mapScreenPrintPixmap = nullptr;
 
+  /* Worker creating the flight plan document and action to execute after it is done */
+  QFutureWatcher<QTextDocument *> documentWatcher;
+  DocumentAction documentAction = NONE;
+
+  /* Document of the worker is not taken yet and has to be deleted if this object is destroyed */
+  bool documentResultPending = false;
+
+  /* Printer selected in dialog for action PRINT */
+  QPrinter *flightPlanPrinter = nullptr;
+
 };
 
 #endif // LITTLENAVMAP_PRINTSUPPORT_H
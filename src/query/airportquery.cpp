@@ -24,11 +24,18 @@
 #include "sql/sqlquery.h"
 #include "sql/sqldatabase.h"
 #include "common/maptools.h"
+#include "query/cachebudget.h"
 #include "settings/settings.h"
 #include "fs/common/xpgeometry.h"
+#include "exception.h"
 
 #include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QRegularExpression>
+#include <QThread>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
 
 using namespace Marble;
 using namespace atools::sql;
@@ -42,24 +49,72 @@ using map::MapIls;
 using map::MapParking;
 using map::MapHelipad;
 
+/* Airport diagram queries which are used by the cached getters and the diagram loader thread */
+static const QString PARKING_QUERY_BASE(
+  "parking_id, airport_id, type, name, airline_codes, number, radius, heading, has_jetway, lonx, laty ");
+
+static const QString APRON_QUERY("select * from apron where airport_id = :airportId");
+
+static const QString PARKING_QUERY("select " + PARKING_QUERY_BASE + " from parking where airport_id = :airportId");
+
+// Start positions ordered by type (runway, helipad) and name
+static const QString START_QUERY(
+  "select s.start_id, s.airport_id, s.type, s.heading, s.number, s.runway_name, s.altitude, s.lonx, s.laty "
+  "from start s where s.airport_id = :airportId "
+  "order by s.type desc, s.runway_name");
+
+static const QString HELIPAD_QUERY(
+  "select h.helipad_id, h.start_id, h.surface, h.type, h.length, h.width, h.airport_id, "
+  " h.heading, h.is_transparent, h.is_closed, h.lonx, h.laty, s.number as start_number, s.runway_name as runway_name "
+  " from helipad h "
+  " left outer join start s on s.start_id = h.start_id "
+  " where h.airport_id = :airportId");
+
+static const QString TAXIPATH_QUERY(
+  "select type, surface, width, name, is_draw_surface, start_type, end_type, "
+  "start_lonx, start_laty, end_lonx, end_laty "
+  "from taxi_path where airport_id = :airportId");
+
+// Runway joined with both runway ends
+static const QString RUNWAYS_QUERY(
+  "select r.*, p.name as primary_name, s.name as secondary_name, "
+  "p.name as primary_name, s.name as secondary_name, "
+  "r.primary_end_id, r.secondary_end_id, "
+  "r.edge_light, "
+  "p.offset_threshold as primary_offset_threshold,  p.has_closed_markings as primary_closed_markings, "
+  "s.offset_threshold as secondary_offset_threshold,  s.has_closed_markings as secondary_closed_markings,"
+  "p.blast_pad as primary_blast_pad,  p.overrun as primary_overrun, "
+  "s.blast_pad as secondary_blast_pad,  s.overrun as secondary_overrun,"
+  "r.primary_lonx, r.primary_laty, r.secondary_lonx, r.secondary_laty "
+  "from runway r "
+  "join runway_end p on r.primary_end_id = p.runway_end_id "
+  "join runway_end s on r.secondary_end_id = s.runway_end_id "
+  "where r.airport_id = :airportId");
+
 AirportQuery::AirportQuery(QObject *parent, atools::sql::SqlDatabase *sqlDb, bool nav)
   : QObject(parent), navdata(nav), db(sqlDb)
 {
   mapTypesFactory = new MapTypesFactory();
-  atools::settings::Settings& settings = atools::settings::Settings::instance();
 
-  runwayCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "RunwayCache", 2000).toInt());
-  apronCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "ApronCache", 1000).toInt());
-  taxipathCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "TaxipathCache", 1000).toInt());
-  parkingCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "ParkingCache", 1000).toInt());
-  startCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "StartCache", 1000).toInt());
-  helipadCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "HelipadCache", 1000).toInt());
-  airportIdCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "AirportIdCache", 1000).toInt());
-  airportIdentCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "AirportIdentCache", 1000).toInt());
+  QString prefix = navdata ? "Nav " : "Sim ";
+  CacheBudget& budget = CacheBudget::instance();
+  budget.registerCache(this, prefix + "runways", &runwayCache);
+  budget.registerCache(this, prefix + "aprons", &apronCache);
+  budget.registerCache(this, prefix + "taxipaths", &taxipathCache);
+  budget.registerCache(this, prefix + "parking", &parkingCache);
+  budget.registerCache(this, prefix + "starts", &startCache);
+  budget.registerCache(this, prefix + "helipads", &helipadCache);
+  budget.registerCache(this, prefix + "airports by id", &airportIdCache);
+  budget.registerCache(this, prefix + "airports by ident", &airportIdentCache);
+  budget.registerCache(this, prefix + "airport diagrams", &diagramCache);
+
+  connect(&diagramWatcher, &QFutureWatcher<AirportDiagramLoad>::finished,
+          this, &AirportQuery::airportDiagramLoadFinished);
 }
 
 AirportQuery::~AirportQuery()
 {
+  CacheBudget::instance().unregisterCaches(this);
   deInitQueries();
   delete mapTypesFactory;
 }
@@ -101,7 +156,7 @@ void AirportQuery::getAirportById(map::MapAirport& airport, int airportId)
     airportByIdQuery->finish();
 
     airport = *ap;
-    airportIdCache.insert(airportId, ap);
+    CacheBudget::instance().insert(airportIdCache, airportId, ap);
   }
 }
 
@@ -122,7 +177,7 @@ void AirportQuery::getAirportByIdent(map::MapAirport& airport, const QString& id
     airportByIdentQuery->finish();
 
     airport = *ap;
-    airportIdentCache.insert(ident, ap);
+    CacheBudget::instance().insert(airportIdentCache, ident, ap);
   }
 }
 
@@ -214,60 +269,111 @@ void AirportQuery::getRunwayEndByNames(map::MapSearchResult& result, const QStri
 const QList<map::MapApron> *AirportQuery::getAprons(int airportId)
 {
   if(apronCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return apronCache.object(airportId);
+  }
   else
   {
-    apronQuery->bindValue(":airportId", airportId);
-    apronQuery->exec();
-
+    QElapsedTimer timer;
+    timer.start();
     QList<map::MapApron> *aprons = new QList<map::MapApron>;
-    while(apronQuery->next())
-    {
-      map::MapApron ap;
+    readAprons(apronQuery, airportId, *aprons);
+    CacheBudget::instance().insert(apronCache, airportId, aprons);
+    queryStatistics.miss(timer.nsecsElapsed());
+    return aprons;
+  }
+}
+
+void AirportQuery::buildXplaneApronPath(map::MapApron& apron)
+{
+  if(apron.geometry.boundary.isEmpty())
+    return;
+
+  apron.xplaneReference = apron.geometry.boundary.first().node;
+  apron.xplanePath = pathForBoundary(apron, apron.geometry.boundary);
+
+  // Expensive boolean operations are done only once here - result contains only straight lines
+  for(const atools::fs::common::Boundary& hole : apron.geometry.holes)
+    apron.xplanePath = apron.xplanePath.subtracted(pathForBoundary(apron, hole));
+
+  if(apron.geometry.holes.isEmpty())
+  {
+    // Flatten bezier curves
+    QPainterPath flatPath;
+    for(const QPolygonF& polygon : apron.xplanePath.toSubpathPolygons())
+      flatPath.addPolygon(polygon);
+    apron.xplanePath = flatPath;
+  }
+}
+
+/* Create a path for X-Plane boundary including bezier curves in local metric coordinates of the apron */
+QPainterPath AirportQuery::pathForBoundary(const map::MapApron& apron,
+                                           const atools::fs::common::Boundary& boundaryNodes)
+{
+  QPainterPath path;
+  atools::fs::common::Node lastNode;
 
-      ap.surface = apronQuery->value("surface").toString();
-      ap.drawSurface = apronQuery->value("is_draw_surface").toInt() > 0;
+  // Create a copy and close the geometry
+  atools::fs::common::Boundary boundary = boundaryNodes;
+  if(!boundary.isEmpty())
+    boundary.append(boundary.first());
 
-      if(apronQuery->hasField("geometry"))
+  int i = 0;
+  for(const atools::fs::common::Node& node : boundary)
+  {
+    QPointF lastPt = apron.toLocal(lastNode.node);
+    QPointF pt = apron.toLocal(node.node);
+
+    if(i == 0)
+      // Fist point
+      path.moveTo(pt);
+    else
+    {
+      if(lastNode.control.isValid() && node.control.isValid())
       {
-        // X-Plane specific - contains bezier points for apron and taxiways.
-        atools::fs::common::XpGeometry geo(apronQuery->value("geometry").toByteArray());
-        ap.geometry = geo.getGeometry();
+        // Two successive control points - use cubic curve
+        QPointF ctlpt = apron.toLocal(lastNode.control);
+        QPointF ctlpt2 = apron.toLocal(node.control);
+        path.cubicTo(ctlpt, pt + (pt - ctlpt2), pt);
       }
-
-      // Decode vertices into a position list - FSX/P3D
-      if(!apronQuery->isNull("vertices"))
+      else if(lastNode.control.isValid())
       {
-        atools::fs::common::BinaryGeometry geo(apronQuery->value("vertices").toByteArray());
-        geo.swapGeometry(ap.vertices);
+        // One control point - use quad curve
+        if(lastPt != pt)
+          path.quadTo(apron.toLocal(lastNode.control), pt);
       }
-
-      aprons->append(ap);
+      else if(node.control.isValid())
+      {
+        // One control point - use quad curve
+        if(lastPt != pt)
+          path.quadTo(pt + (pt - apron.toLocal(node.control)), pt);
+      }
+      else
+        path.lineTo(pt);
     }
-    apronCache.insert(airportId, aprons);
-    return aprons;
+
+    lastNode = node;
+    i++;
   }
+  return path;
 }
 
 const QList<map::MapParking> *AirportQuery::getParkingsForAirport(int airportId)
 {
   if(parkingCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return parkingCache.object(airportId);
+  }
   else
   {
-    parkingQuery->bindValue(":airportId", airportId);
-    parkingQuery->exec();
-
+    QElapsedTimer timer;
+    timer.start();
     QList<map::MapParking> *ps = new QList<map::MapParking>;
-    while(parkingQuery->next())
-    {
-      map::MapParking p;
-
-      // Vehicle paths are filtered out in the compiler
-      mapTypesFactory->fillParking(parkingQuery->record(), p);
-      ps->append(p);
-    }
-    parkingCache.insert(airportId, ps);
+    readParkings(parkingQuery, mapTypesFactory, airportId, *ps);
+    CacheBudget::instance().insert(parkingCache, airportId, ps);
+    queryStatistics.miss(timer.nsecsElapsed());
     return ps;
   }
 }
@@ -275,20 +381,18 @@ const QList<map::MapParking> *AirportQuery::getParkingsForAirport(int airportId)
 const QList<map::MapStart> *AirportQuery::getStartPositionsForAirport(int airportId)
 {
   if(startCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return startCache.object(airportId);
+  }
   else
   {
-    startQuery->bindValue(":airportId", airportId);
-    startQuery->exec();
-
+    QElapsedTimer timer;
+    timer.start();
     QList<map::MapStart> *ps = new QList<map::MapStart>;
-    while(startQuery->next())
-    {
-      map::MapStart p;
-      mapTypesFactory->fillStart(startQuery->record(), p);
-      ps->append(p);
-    }
-    startCache.insert(airportId, ps);
+    readStarts(startQuery, mapTypesFactory, airportId, *ps);
+    CacheBudget::instance().insert(startCache, airportId, ps);
+    queryStatistics.miss(timer.nsecsElapsed());
     return ps;
   }
 }
@@ -458,20 +562,18 @@ void AirportQuery::getParkingByName(QList<map::MapParking>& parkings, int airpor
 const QList<map::MapHelipad> *AirportQuery::getHelipads(int airportId)
 {
   if(helipadCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return helipadCache.object(airportId);
+  }
   else
   {
-    helipadQuery->bindValue(":airportId", airportId);
-    helipadQuery->exec();
-
+    QElapsedTimer timer;
+    timer.start();
     QList<map::MapHelipad> *hs = new QList<map::MapHelipad>;
-    while(helipadQuery->next())
-    {
-      map::MapHelipad hp;
-      mapTypesFactory->fillHelipad(helipadQuery->record(), hp);
-      hs->append(hp);
-    }
-    helipadCache.insert(airportId, hs);
+    readHelipads(helipadQuery, mapTypesFactory, airportId, *hs);
+    CacheBudget::instance().insert(helipadCache, airportId, hs);
+    queryStatistics.miss(timer.nsecsElapsed());
     return hs;
   }
 }
@@ -479,28 +581,18 @@ const QList<map::MapHelipad> *AirportQuery::getHelipads(int airportId)
 const QList<map::MapTaxiPath> *AirportQuery::getTaxiPaths(int airportId)
 {
   if(taxipathCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return taxipathCache.object(airportId);
+  }
   else
   {
-    taxiparthQuery->bindValue(":airportId", airportId);
-    taxiparthQuery->exec();
-
+    QElapsedTimer timer;
+    timer.start();
     QList<map::MapTaxiPath> *tps = new QList<map::MapTaxiPath>;
-    while(taxiparthQuery->next())
-    {
-      // TODO should be moved to MapTypesFactory
-      map::MapTaxiPath tp;
-      tp.closed = taxiparthQuery->value("type").toString() == "CLOSED";
-      tp.drawSurface = taxiparthQuery->value("is_draw_surface").toInt() > 0;
-      tp.start = Pos(taxiparthQuery->value("start_lonx").toFloat(), taxiparthQuery->value("start_laty").toFloat());
-      tp.end = Pos(taxiparthQuery->value("end_lonx").toFloat(), taxiparthQuery->value("end_laty").toFloat());
-      tp.surface = taxiparthQuery->value("surface").toString();
-      tp.name = taxiparthQuery->value("name").toString();
-      tp.width = taxiparthQuery->value("width").toInt();
-
-      tps->append(tp);
-    }
-    taxipathCache.insert(airportId, tps);
+    readTaxiPaths(taxiparthQuery, airportId, *tps);
+    CacheBudget::instance().insert(taxipathCache, airportId, tps);
+    queryStatistics.miss(timer.nsecsElapsed());
     return tps;
   }
 }
@@ -508,29 +600,267 @@ const QList<map::MapTaxiPath> *AirportQuery::getTaxiPaths(int airportId)
 const QList<map::MapRunway> *AirportQuery::getRunways(int airportId)
 {
   if(runwayCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return runwayCache.object(airportId);
+  }
   else
   {
-    runwaysQuery->bindValue(":airportId", airportId);
-    runwaysQuery->exec();
-
+    QElapsedTimer timer;
+    timer.start();
     QList<map::MapRunway> *rs = new QList<map::MapRunway>;
-    while(runwaysQuery->next())
+    readRunways(runwaysQuery, mapTypesFactory, airportId, *rs);
+    CacheBudget::instance().insert(runwayCache, airportId, rs);
+    queryStatistics.miss(timer.nsecsElapsed());
+    return rs;
+  }
+}
+
+void AirportQuery::readRunways(SqlQuery *query, MapTypesFactory *factory, int airportId,
+                               QList<map::MapRunway>& runways)
+{
+  query->bindValue(":airportId", airportId);
+  query->exec();
+  while(query->next())
+  {
+    map::MapRunway runway;
+    factory->fillRunway(query->record(), runway, false);
+    runways.append(runway);
+  }
+
+  // Sort to draw the hard/better runways last on top of other grass, turf, etc.
+  std::sort(runways.begin(), runways.end(), &AirportQuery::runwayCompare);
+}
+
+void AirportQuery::readAprons(SqlQuery *query, int airportId, QList<map::MapApron>& aprons)
+{
+  query->bindValue(":airportId", airportId);
+  query->exec();
+  while(query->next())
+  {
+    map::MapApron ap;
+
+    ap.surface = query->value("surface").toString();
+    ap.drawSurface = query->value("is_draw_surface").toInt() > 0;
+
+    if(query->hasField("geometry"))
     {
-      map::MapRunway runway;
-      mapTypesFactory->fillRunway(runwaysQuery->record(), runway, false);
-      rs->append(runway);
+      // X-Plane specific - contains bezier points for apron and taxiways.
+      atools::fs::common::XpGeometry geo(query->value("geometry").toByteArray());
+      ap.geometry = geo.getGeometry();
+      buildXplaneApronPath(ap);
     }
 
-    // Sort to draw the hard/better runways last on top of other grass, turf, etc.
-    using namespace std::placeholders;
-    std::sort(rs->begin(), rs->end(), std::bind(&AirportQuery::runwayCompare, this, _1, _2));
+    // Decode vertices into a position list - FSX/P3D
+    if(!query->isNull("vertices"))
+    {
+      atools::fs::common::BinaryGeometry geo(query->value("vertices").toByteArray());
+      geo.swapGeometry(ap.vertices);
+    }
 
-    runwayCache.insert(airportId, rs);
-    return rs;
+    aprons.append(ap);
+  }
+}
+
+void AirportQuery::readTaxiPaths(SqlQuery *query, int airportId, QList<map::MapTaxiPath>& taxipaths)
+{
+  query->bindValue(":airportId", airportId);
+  query->exec();
+  while(query->next())
+  {
+    // TODO should be moved to MapTypesFactory
+    map::MapTaxiPath tp;
+    tp.closed = query->value("type").toString() == "CLOSED";
+    tp.drawSurface = query->value("is_draw_surface").toInt() > 0;
+    tp.start = Pos(query->value("start_lonx").toFloat(), query->value("start_laty").toFloat());
+    tp.end = Pos(query->value("end_lonx").toFloat(), query->value("end_laty").toFloat());
+    tp.surface = query->value("surface").toString();
+    tp.name = query->value("name").toString();
+    tp.width = query->value("width").toInt();
+
+    taxipaths.append(tp);
   }
 }
 
+void AirportQuery::readParkings(SqlQuery *query, MapTypesFactory *factory, int airportId,
+                                QList<map::MapParking>& parkings)
+{
+  query->bindValue(":airportId", airportId);
+  query->exec();
+  while(query->next())
+  {
+    map::MapParking p;
+
+    // Vehicle paths are filtered out in the compiler
+    factory->fillParking(query->record(), p);
+    parkings.append(p);
+  }
+}
+
+void AirportQuery::readStarts(SqlQuery *query, MapTypesFactory *factory, int airportId,
+                              QList<map::MapStart>& starts)
+{
+  query->bindValue(":airportId", airportId);
+  query->exec();
+  while(query->next())
+  {
+    map::MapStart p;
+    factory->fillStart(query->record(), p);
+    starts.append(p);
+  }
+}
+
+void AirportQuery::readHelipads(SqlQuery *query, MapTypesFactory *factory, int airportId,
+                                QList<map::MapHelipad>& helipads)
+{
+  query->bindValue(":airportId", airportId);
+  query->exec();
+  while(query->next())
+  {
+    map::MapHelipad hp;
+    factory->fillHelipad(query->record(), hp);
+    helipads.append(hp);
+  }
+}
+
+const map::MapAirportDiagram *AirportQuery::getAirportDiagram(int airportId)
+{
+  map::MapAirportDiagram *diagram = diagramCache.object(airportId);
+  if(diagram != nullptr)
+  {
+    queryStatistics.hit();
+    return diagram;
+  }
+
+  if(diagramFailed.contains(airportId))
+  {
+    queryStatistics.miss(0);
+    return nullptr;
+  }
+
+  // Diagram was evicted shortly after loading - wait before loading again
+  qint64 loadTimeMs = diagramLoadTimeMs.value(airportId, 0);
+  bool delayed = loadTimeMs > 0 && QDateTime::currentMSecsSinceEpoch() - loadTimeMs < DIAGRAM_RELOAD_DELAY_MS;
+
+  if(!diagramLoading.contains(airportId) && !delayed)
+  {
+    diagramLoadQueue.insert(airportId);
+
+    if(!diagramLoadScheduled)
+    {
+      // Collect all requests of the current paint event before starting the thread
+      diagramLoadScheduled = true;
+      QTimer::singleShot(0, this, &AirportQuery::startAirportDiagramLoad);
+    }
+  }
+  queryStatistics.miss(0);
+  return nullptr;
+}
+
+void AirportQuery::startAirportDiagramLoad()
+{
+  diagramLoadScheduled = false;
+
+  if(diagramWatcher.isRunning() || diagramLoadQueue.isEmpty() || db == nullptr || !db->isOpen())
+    // Will be called again when the thread is finished
+    return;
+
+  QVector<int> ids;
+  for(int id : diagramLoadQueue)
+    ids.append(id);
+  diagramLoading = diagramLoadQueue;
+  diagramLoadQueue.clear();
+
+  diagramWatcher.setFuture(QtConcurrent::run(&AirportQuery::loadAirportDiagramsThread,
+                                             db->databaseName(), ids, diagramGeneration));
+}
+
+void AirportQuery::airportDiagramLoadFinished()
+{
+  AirportDiagramLoad load = diagramWatcher.result();
+  diagramLoading.clear();
+
+  if(load.generation != diagramGeneration)
+    // Caches were cleared or database was changed while loading
+    return;
+
+  for(int airportId : load.failedIds)
+    diagramFailed.insert(airportId);
+
+  int inserted = 0;
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  for(const map::MapAirportDiagram& diagram : load.diagrams)
+  {
+    diagramLoadTimeMs.insert(diagram.airportId, now);
+    if(CacheBudget::instance().insert(diagramCache, diagram.airportId, new map::MapAirportDiagram(diagram)))
+      inserted++;
+  }
+
+  // Load diagrams requested in the meantime
+  startAirportDiagramLoad();
+
+  if(inserted > 0)
+    // Repaint only if something new can be drawn to avoid a load and repaint loop
+    emit airportDiagramsLoaded();
+}
+
+AirportQuery::AirportDiagramLoad AirportQuery::loadAirportDiagramsThread(QString databaseFile,
+                                                                         QVector<int> airportIds, int generation)
+{
+  QThread::currentThread()->setPriority(QThread::LowPriority);
+
+  AirportDiagramLoad load;
+  load.generation = generation;
+
+  // Connection names have to be unique for each thread
+  QString connectionName = QString("LNMDIAGRAM%1").arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+  SqlDatabase::addDatabase("QSQLITE", connectionName);
+
+  try
+  {
+    SqlDatabase threadDb(connectionName);
+    threadDb.setDatabaseName(databaseFile);
+    threadDb.setReadonly();
+    threadDb.open();
+
+    {
+      MapTypesFactory factory;
+      SqlQuery runwayQuery(&threadDb), apronQuery(&threadDb), taxipathQuery(&threadDb), parkingQuery(&threadDb),
+               startQuery(&threadDb), helipadQuery(&threadDb);
+      runwayQuery.prepare(RUNWAYS_QUERY);
+      apronQuery.prepare(APRON_QUERY);
+      taxipathQuery.prepare(TAXIPATH_QUERY);
+      parkingQuery.prepare(PARKING_QUERY);
+      startQuery.prepare(START_QUERY);
+      helipadQuery.prepare(HELIPAD_QUERY);
+
+      for(int airportId : airportIds)
+      {
+        map::MapAirportDiagram diagram;
+        diagram.airportId = airportId;
+        readRunways(&runwayQuery, &factory, airportId, diagram.runways);
+        readAprons(&apronQuery, airportId, diagram.aprons);
+        readTaxiPaths(&taxipathQuery, airportId, diagram.taxipaths);
+        readParkings(&parkingQuery, &factory, airportId, diagram.parkings);
+        readStarts(&startQuery, &factory, airportId, diagram.starts);
+        readHelipads(&helipadQuery, &factory, airportId, diagram.helipads);
+        load.diagrams.append(diagram);
+      }
+    }
+    threadDb.close();
+  }
+  catch(atools::Exception& e)
+  {
+    // Do not show a dialog from this thread
+    qWarning() << Q_FUNC_INFO << "Error loading airport diagrams" << e.what();
+    load.diagrams.clear();
+    load.failedIds = airportIds;
+  }
+
+  SqlDatabase::removeDatabase(connectionName);
+  return load;
+}
+
 QStringList AirportQuery::getRunwayNames(int airportId)
 {
   const QList<map::MapRunway> *aprunways = getRunways(airportId);
@@ -625,9 +955,6 @@ void AirportQuery::initQueries()
   static const QString ndbQueryBase(
     "ndb_id, ident, name, region, type, name, frequency, range, mag_var, altitude, lonx, laty ");
 
-  static const QString parkingQueryBase(
-    "parking_id, airport_id, type, name, airline_codes, number, radius, heading, has_jetway, lonx, laty ");
-
   static const QString ilsQueryBase(
     "ils_id, ident, name, mag_var, loc_heading, gs_pitch, frequency, range, dme_range, loc_width, "
     "end1_lonx, end1_laty, end_mid_lonx, end_mid_laty, end2_lonx, end2_laty, altitude, lonx, laty");
@@ -669,18 +996,13 @@ void AirportQuery::initQueries()
     "from runway where airport_id = :airportId and length > 4000 " + whereLimit);
 
   apronQuery = new SqlQuery(db);
-  apronQuery->prepare(
-    "select * from apron where airport_id = :airportId");
+  apronQuery->prepare(APRON_QUERY);
 
   parkingQuery = new SqlQuery(db);
-  parkingQuery->prepare("select " + parkingQueryBase + " from parking where airport_id = :airportId");
+  parkingQuery->prepare(PARKING_QUERY);
 
-  // Start positions ordered by type (runway, helipad) and name
   startQuery = new SqlQuery(db);
-  startQuery->prepare(
-    "select s.start_id, s.airport_id, s.type, s.heading, s.number, s.runway_name, s.altitude, s.lonx, s.laty "
-    "from start s where s.airport_id = :airportId "
-    "order by s.type desc, s.runway_name");
+  startQuery->prepare(START_QUERY);
 
   startByIdQuery = new SqlQuery(db);
   startByIdQuery->prepare(
@@ -689,47 +1011,35 @@ void AirportQuery::initQueries()
 
   parkingTypeAndNumberQuery = new SqlQuery(db);
   parkingTypeAndNumberQuery->prepare(
-    "select " + parkingQueryBase +
+    "select " + PARKING_QUERY_BASE +
     " from parking where airport_id = :airportId and name like :name and number = :number order by radius desc");
 
   parkingNameQuery = new SqlQuery(db);
-  parkingNameQuery->prepare("select " + parkingQueryBase +
+  parkingNameQuery->prepare("select " + PARKING_QUERY_BASE +
                             " from parking where airport_id = :airportId and name like :name order by radius desc");
 
   helipadQuery = new SqlQuery(db);
-  helipadQuery->prepare(
-    "select h.helipad_id, h.start_id, h.surface, h.type, h.length, h.width, h.airport_id, "
-    " h.heading, h.is_transparent, h.is_closed, h.lonx, h.laty, s.number as start_number, s.runway_name as runway_name "
-    " from helipad h "
-    " left outer join start s on s.start_id = h.start_id "
-    " where h.airport_id = :airportId");
+  helipadQuery->prepare(HELIPAD_QUERY);
 
   taxiparthQuery = new SqlQuery(db);
-  taxiparthQuery->prepare(
-    "select type, surface, width, name, is_draw_surface, start_type, end_type, "
-    "start_lonx, start_laty, end_lonx, end_laty "
-    "from taxi_path where airport_id = :airportId");
+  taxiparthQuery->prepare(TAXIPATH_QUERY);
 
-  // Runway joined with both runway ends
   runwaysQuery = new SqlQuery(db);
-  runwaysQuery->prepare(
-    "select r.*, p.name as primary_name, s.name as secondary_name, "
-    "p.name as primary_name, s.name as secondary_name, "
-    "r.primary_end_id, r.secondary_end_id, "
-    "r.edge_light, "
-    "p.offset_threshold as primary_offset_threshold,  p.has_closed_markings as primary_closed_markings, "
-    "s.offset_threshold as secondary_offset_threshold,  s.has_closed_markings as secondary_closed_markings,"
-    "p.blast_pad as primary_blast_pad,  p.overrun as primary_overrun, "
-    "s.blast_pad as secondary_blast_pad,  s.overrun as secondary_overrun,"
-    "r.primary_lonx, r.primary_laty, r.secondary_lonx, r.secondary_laty "
-    "from runway r "
-    "join runway_end p on r.primary_end_id = p.runway_end_id "
-    "join runway_end s on r.secondary_end_id = s.runway_end_id "
-    "where r.airport_id = :airportId");
+  runwaysQuery->prepare(RUNWAYS_QUERY);
 }
 
 void AirportQuery::deInitQueries()
 {
+  // Wait for the diagram thread which uses an own connection to the same database file
+  diagramWatcher.waitForFinished();
+  diagramGeneration++;
+  mapTypesFactory->clearInternedStrings();
+  diagramCache.clear();
+  diagramLoadQueue.clear();
+  diagramLoading.clear();
+  diagramFailed.clear();
+  diagramLoadTimeMs.clear();
+
   runwayCache.clear();
   apronCache.clear();
   taxipathCache.clear();
@@ -800,6 +1110,12 @@ QHash<int, QList<map::MapParking> > AirportQuery::getParkingCache() const
   for(int key : parkingCache.keys())
     retval.insert(key, *parkingCache.object(key));
 
+  for(int key : diagramCache.keys())
+  {
+    if(!retval.contains(key))
+      retval.insert(key, diagramCache.object(key)->parkings);
+  }
+
   return retval;
 }
 
@@ -810,5 +1126,11 @@ QHash<int, QList<map::MapHelipad> > AirportQuery::getHelipadCache() const
   for(int key : helipadCache.keys())
     retval.insert(key, *helipadCache.object(key));
 
+  for(int key : diagramCache.keys())
+  {
+    if(!retval.contains(key))
+      retval.insert(key, diagramCache.object(key)->helipads);
+  }
+
   return retval;
 }
@@ -20,8 +20,12 @@
 
 #include "common/maptypes.h"
 #include "mapgui/maplayer.h"
+#include "query/querystatistics.h"
 
 #include <QCache>
+#include <QFutureWatcher>
+#include <QSet>
+#include <QVector>
 #include <QList>
 
 #include <functional>
@@ -119,6 +123,10 @@ public:
 
   map::MapRunwayEnd getRunwayEndById(int id);
 
+  /* Get all objects needed to draw the airport diagram from the cache. Returns null if the diagram is not
+   * loaded yet and schedules loading in a background thread. airportDiagramsLoaded is emitted when done. */
+  const map::MapAirportDiagram *getAirportDiagram(int airportId);
+
   /* Close all query objects thus disconnecting from the database */
   void initQueries();
 
@@ -131,12 +139,60 @@ public:
 
   static QStringList airportColumns(const atools::sql::SqlDatabase *db);
 
+  /* Statistics for airport diagram caches since last call of resetQueryStatistics() */
+  const QueryStatistics& getQueryStatistics() const
+  {
+    return queryStatistics;
+  }
+
+  void resetQueryStatistics()
+  {
+    queryStatistics = QueryStatistics();
+  }
+
+signals:
+  /* Diagrams requested by getAirportDiagram are loaded. Map needs a repaint. */
+  void airportDiagramsLoaded();
+
 private:
+  /* Result of the background loader */
+  struct AirportDiagramLoad
+  {
+    int generation = 0;
+    QVector<map::MapAirportDiagram> diagrams;
+    QVector<int> failedIds; /* Airports which could not be loaded due to errors */
+  };
+
+  /* Start thread for all airport ids queued by getAirportDiagram */
+  void startAirportDiagramLoad();
+  void airportDiagramLoadFinished();
+
+  /* Runs in background thread. Opens an own read-only connection to the database file since connections
+   * cannot be shared between threads. */
+  static AirportDiagramLoad loadAirportDiagramsThread(QString databaseFile, QVector<int> airportIds,
+                                                      int generation);
+
+  /* Execute query which must have the bind variable :airportId and fill the list */
+  static void readRunways(atools::sql::SqlQuery *query, MapTypesFactory *factory, int airportId,
+                          QList<map::MapRunway>& runways);
+  static void readAprons(atools::sql::SqlQuery *query, int airportId, QList<map::MapApron>& aprons);
+  static void readTaxiPaths(atools::sql::SqlQuery *query, int airportId, QList<map::MapTaxiPath>& taxipaths);
+  static void readParkings(atools::sql::SqlQuery *query, MapTypesFactory *factory, int airportId,
+                           QList<map::MapParking>& parkings);
+  static void readStarts(atools::sql::SqlQuery *query, MapTypesFactory *factory, int airportId,
+                         QList<map::MapStart>& starts);
+  static void readHelipads(atools::sql::SqlQuery *query, MapTypesFactory *factory, int airportId,
+                           QList<map::MapHelipad>& helipads);
+
   const QList<map::MapAirport> *fetchAirports(const Marble::GeoDataLatLonBox& rect,
                                               atools::sql::SqlQuery *query, bool reverse,
                                               bool lazy, bool overview);
 
-  bool runwayCompare(const map::MapRunway& r1, const map::MapRunway& r2);
+  static bool runwayCompare(const map::MapRunway& r1, const map::MapRunway& r2);
+
+  /* Flatten X-Plane apron boundary and holes into local metric coordinates and subtract holes */
+  static void buildXplaneApronPath(map::MapApron& apron);
+  static QPainterPath pathForBoundary(const map::MapApron& apron, const atools::fs::common::Boundary& boundaryNodes);
 
   const int queryRowLimit = 5000;
 
@@ -146,6 +202,8 @@ private:
   MapTypesFactory *mapTypesFactory;
   atools::sql::SqlDatabase *db;
 
+  QueryStatistics queryStatistics;
+
   /* ID/object caches */
   QCache<int, QList<map::MapRunway> > runwayCache;
   QCache<int, QList<map::MapApron> > apronCache;
@@ -157,6 +215,25 @@ private:
   QCache<QString, map::MapAirport> airportIdentCache;
   QCache<int, map::MapAirport> airportIdCache;
 
+  /* Complete airport diagrams. Cost is memory size in bytes. */
+  QCache<int, map::MapAirportDiagram> diagramCache;
+  QSet<int> diagramLoadQueue, diagramLoading;
+
+  /* Airports that failed to load. Not requested again until the caches are cleared. */
+  QSet<int> diagramFailed;
+
+  /* Time in milliseconds since epoch when a diagram was loaded. Used to avoid reloading diagrams
+   * evicted by the cache budget in a loop. */
+  QHash<int, qint64> diagramLoadTimeMs;
+  QFutureWatcher<AirportDiagramLoad> diagramWatcher;
+  bool diagramLoadScheduled = false;
+
+  /* Increased when clearing caches to drop results of a running thread */
+  int diagramGeneration = 0;
+
+  /* Minimum time before a diagram evicted from the cache is loaded again */
+  static Q_DECL_CONSTEXPR qint64 DIAGRAM_RELOAD_DELAY_MS = 5000;
+
   /* Database queries */
   atools::sql::SqlQuery *runwayOverviewQuery = nullptr, *apronQuery = nullptr,
                         *parkingQuery = nullptr, *startQuery = nullptr, *startByIdQuery = nullptr,
@@ -0,0 +1,160 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "query/airportranking.h"
+
+#include <QDebug>
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+
+void AirportRanking::build(const QList<map::MapAirport>& airportList)
+{
+  clear();
+
+  // Calculate importance once and sort indexes by decreasing importance and id for a stable order
+  QVector<std::pair<float, int> > ranks;
+  ranks.reserve(airportList.size());
+  for(int i = 0; i < airportList.size(); i++)
+    ranks.append(std::make_pair(importance(airportList.at(i)), i));
+
+  std::sort(ranks.begin(), ranks.end(),
+            [&airportList](const std::pair<float, int>& r1, const std::pair<float, int>& r2) -> bool
+  {
+    if(r1.first == r2.first)
+      return airportList.at(r1.second).id < airportList.at(r2.second).id;
+    else
+      return r1.first > r2.first;
+  });
+
+  airports.reserve(ranks.size());
+  for(const std::pair<float, int>& rank : ranks)
+    airports.append(airportList.at(rank.second));
+
+  for(int level = 0; level <= MAX_LEVEL; level++)
+  {
+    // Airports are visited by decreasing importance - first ones fill the cells
+    QHash<quint32, int> cellCounts;
+    QVector<Entry> entries;
+    for(int i = 0; i < airports.size(); i++)
+    {
+      const atools::geo::Pos& pos = airports.at(i).position;
+      quint32 key = cellKey(cellX(pos.getLonX(), level), cellY(pos.getLatY(), level));
+
+      int& count = cellCounts[key];
+      if(count < AIRPORTS_PER_CELL)
+      {
+        entries.append({key, i});
+        count++;
+      }
+    }
+
+    // Stable sort keeps the importance order within a cell
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& e1, const Entry& e2) -> bool
+    {
+      return e1.cell < e2.cell;
+    });
+    levels.append(entries);
+  }
+
+  qDebug() << Q_FUNC_INFO << "airports" << airports.size() << "levels" << levels.size()
+           << "entries in finest level" << levels.last().size();
+}
+
+void AirportRanking::clear()
+{
+  airports.clear();
+  levels.clear();
+}
+
+int AirportRanking::levelForWidth(float widthDeg)
+{
+  if(widthDeg <= 0.f)
+    return MAX_LEVEL;
+
+  int level = static_cast<int>(std::round(std::log2(360.f * CELLS_PER_VIEW / widthDeg)));
+  return std::max(0, std::min(level, static_cast<int>(MAX_LEVEL)));
+}
+
+void AirportRanking::getAirports(QList<map::MapAirport>& result, float west, float south, float east, float north,
+                                 int level) const
+{
+  if(levels.isEmpty())
+    return;
+
+  level = std::max(0, std::min(level, static_cast<int>(MAX_LEVEL)));
+  const QVector<Entry>& entries = levels.at(level);
+
+  int x1 = cellX(west, level), x2 = cellX(east, level);
+  int y1 = cellY(south, level), y2 = cellY(north, level);
+
+  // Cells of a row are consecutive in the sorted entries
+  for(int y = y1; y <= y2; y++)
+  {
+    quint32 first = cellKey(x1, y), last = cellKey(x2, y);
+    auto it = std::lower_bound(entries.begin(), entries.end(), first, [](const Entry& e, quint32 key) -> bool
+    {
+      return e.cell < key;
+    });
+
+    for(; it != entries.end() && it->cell <= last; ++it)
+    {
+      const map::MapAirport& airport = airports.at(it->index);
+      const atools::geo::Pos& pos = airport.position;
+
+      // Cells at the border are only partially covered
+      if(pos.getLonX() >= west && pos.getLonX() <= east && pos.getLatY() >= south && pos.getLatY() <= north)
+        result.append(airport);
+    }
+  }
+}
+
+float AirportRanking::importance(const map::MapAirport& airport)
+{
+  // Longest runway in thousands of feet as base
+  float value = airport.longestRunwayLength / 1000.f;
+
+  if(airport.rating > 0)
+    value += airport.rating;
+
+  if(airport.addon())
+    value += 3.f;
+
+  if(airport.tower())
+    value += 2.f;
+
+  if(airport.hard())
+    value += 1.f;
+
+  if(airport.closed())
+    value -= 10.f;
+
+  return value;
+}
+
+int AirportRanking::cellX(float lonX, int level)
+{
+  int num = 1 << level;
+  return std::max(0, std::min(static_cast<int>((lonX + 180.f) / 360.f * num), num - 1));
+}
+
+int AirportRanking::cellY(float latY, int level)
+{
+  int num = 1 << level;
+  return std::max(0, std::min(static_cast<int>((latY + 90.f) / 180.f * num), num - 1));
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_AIRPORTRANKING_H
+#define LITTLENAVMAP_AIRPORTRANKING_H
+
+#include "common/maptypes.h"
+
+#include <QVector>
+
+/*
+ * Hierarchical ranking of airports for the overview map layers.
+ *
+ * Each level divides the world into a grid of 2^level by 2^level cells. A cell keeps only the most important
+ * airports inside. Entries of a level are sorted by cell so a map rectangle can be read with one range scan per
+ * cell row. Since cells of a level are contained in cells of the previous level an airport is present in all
+ * levels below its first one.
+ */
+class AirportRanking
+{
+public:
+  /* Builds the ranking for all given airports which are copied */
+  void build(const QList<map::MapAirport>& airportList);
+  void clear();
+
+  bool isEmpty() const
+  {
+    return airports.isEmpty();
+  }
+
+  /* Level giving about CELLS_PER_VIEW cells across a view of the given width in degree */
+  static int levelForWidth(float widthDeg);
+
+  /* Append the most important airports of all cells at level overlapping the rectangle. Rectangle must not cross
+   * the anti-meridian. */
+  void getAirports(QList<map::MapAirport>& result, float west, float south, float east, float north,
+                   int level) const;
+
+  /* Higher value is more important. Uses only fields filled for the overview. */
+  static float importance(const map::MapAirport& airport);
+
+private:
+  /* Cell key and index into airports */
+  struct Entry
+  {
+    quint32 cell;
+    int index;
+  };
+
+  static int cellX(float lonX, int level);
+  static int cellY(float latY, int level);
+
+  static quint32 cellKey(int x, int y)
+  {
+    return static_cast<quint32>(y) << 16 | static_cast<quint32>(x);
+  }
+
+  /* Finest level. Cell size is about 0.09 degree at this level. */
+  static Q_DECL_CONSTEXPR int MAX_LEVEL = 12;
+
+  /* Number of airports kept in each cell */
+  static Q_DECL_CONSTEXPR int AIRPORTS_PER_CELL = 4;
+
+  /* Number of cells across a view used to select the level */
+  static Q_DECL_CONSTEXPR float CELLS_PER_VIEW = 16.f;
+
+  /* Sorted by decreasing importance */
+  QVector<map::MapAirport> airports;
+
+  /* Entries for each level sorted by cell and importance */
+  QVector<QVector<Entry> > levels;
+};
+
+#endif // LITTLENAVMAP_AIRPORTRANKING_H
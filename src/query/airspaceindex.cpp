@@ -0,0 +1,232 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "query/airspaceindex.h"
+
+#include "geo/linestring.h"
+#include "geo/rect.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+/* Shift longitude to be within 180 degree of the reference longitude */
+static inline float normalizeLon(float lonX, float refLonX)
+{
+  if(lonX - refLonX > 180.f)
+    return lonX - 360.f;
+  else if(lonX - refLonX < -180.f)
+    return lonX + 360.f;
+  else
+    return lonX;
+}
+
+/* Sign of the cross product for points a, b and c */
+static inline float orientation(float ax, float ay, float bx, float by, float cx, float cy)
+{
+  return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+template<typename FUNC>
+void AirspaceIndex::splitRect(const atools::geo::Rect& rect, FUNC func)
+{
+  if(rect.getWest() > rect.getEast())
+  {
+    func(rect.getWest(), rect.getSouth(), 180.f, rect.getNorth());
+    func(-180.f, rect.getSouth(), rect.getEast(), rect.getNorth());
+  }
+  else
+    func(rect.getWest(), rect.getSouth(), rect.getEast(), rect.getNorth());
+}
+
+void AirspaceIndex::build(const QList<map::MapAirspace>& airspaceList)
+{
+  clear();
+
+  airspaces.reserve(airspaceList.size());
+  for(const map::MapAirspace& airspace : airspaceList)
+  {
+    if(!airspace.bounding.isValid())
+      continue;
+
+    int index = airspaces.size();
+    airspaces.append(airspace);
+
+    splitRect(airspace.bounding, [this, index](float west, float south, float east, float north) -> void
+    {
+      entries.append({west, south, east, north, index, 1});
+    });
+  }
+
+  if(entries.isEmpty())
+    return;
+
+  sortTiles(entries);
+  QVector<Node> level = packLevel(entries);
+  while(level.size() > NODE_SIZE)
+  {
+    // Children have to be sorted before packing since nodes refer to a range
+    sortTiles(level);
+    levels.append(level);
+    level = packLevel(levels.last());
+  }
+  levels.append(level);
+
+  qDebug() << Q_FUNC_INFO << "airspaces" << airspaces.size() << "entries" << entries.size()
+           << "levels" << levels.size();
+}
+
+void AirspaceIndex::clear()
+{
+  airspaces.clear();
+  entries.clear();
+  levels.clear();
+}
+
+void AirspaceIndex::sortTiles(QVector<Node>& nodes)
+{
+  int numParents = (nodes.size() + NODE_SIZE - 1) / NODE_SIZE;
+  int numSlices = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(numParents))));
+  int sliceSize = numSlices * NODE_SIZE;
+
+  // Sort by x into vertical slices and then each slice by y
+  std::sort(nodes.begin(), nodes.end(), [](const Node& n1, const Node& n2) -> bool
+  {
+    return n1.west + n1.east < n2.west + n2.east;
+  });
+
+  for(int i = 0; i < nodes.size(); i += sliceSize)
+  {
+    std::sort(nodes.begin() + i, nodes.begin() + std::min(i + sliceSize, nodes.size()),
+              [](const Node& n1, const Node& n2) -> bool
+    {
+      return n1.south + n1.north < n2.south + n2.north;
+    });
+  }
+}
+
+QVector<AirspaceIndex::Node> AirspaceIndex::packLevel(const QVector<Node>& nodes)
+{
+  QVector<Node> parents;
+  for(int i = 0; i < nodes.size(); i += NODE_SIZE)
+  {
+    Node parent = nodes.at(i);
+    parent.first = i;
+    parent.count = std::min(static_cast<int>(NODE_SIZE), nodes.size() - i);
+
+    for(int j = i + 1; j < i + parent.count; j++)
+    {
+      const Node& child = nodes.at(j);
+      parent.west = std::min(parent.west, child.west);
+      parent.south = std::min(parent.south, child.south);
+      parent.east = std::max(parent.east, child.east);
+      parent.north = std::max(parent.north, child.north);
+    }
+    parents.append(parent);
+  }
+  return parents;
+}
+
+void AirspaceIndex::getCandidates(QVector<int>& indexes, const atools::geo::Rect& rect) const
+{
+  indexes.clear();
+  if(levels.isEmpty() || !rect.isValid())
+    return;
+
+  splitRect(rect, [this, &indexes](float west, float south, float east, float north) -> void
+  {
+    // Stack of level and node index
+    QVector<std::pair<int, int> > stack;
+    const QVector<Node>& root = levels.last();
+    for(int i = 0; i < root.size(); i++)
+      stack.append(std::make_pair(levels.size() - 1, i));
+
+    while(!stack.isEmpty())
+    {
+      std::pair<int, int> top = stack.takeLast();
+      const Node& node = levels.at(top.first).at(top.second);
+      if(!overlaps(node, west, south, east, north))
+        continue;
+
+      for(int i = node.first; i < node.first + node.count; i++)
+      {
+        if(top.first == 0)
+        {
+          const Node& entry = entries.at(i);
+          if(overlaps(entry, west, south, east, north))
+            indexes.append(entry.first);
+        }
+        else
+          stack.append(std::make_pair(top.first - 1, i));
+      }
+    }
+  });
+
+  // Remove duplicates from split rectangles
+  std::sort(indexes.begin(), indexes.end());
+  indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+}
+
+bool AirspaceIndex::containsAltitude(const map::MapAirspace& airspace, float altitudeFt)
+{
+  return altitudeFt < 0.f || (altitudeFt >= airspace.minAltitude && altitudeFt <= airspace.maxAltitude);
+}
+
+bool AirspaceIndex::containsPos(const atools::geo::LineString& polygon, const atools::geo::Pos& pos)
+{
+  if(polygon.size() < 3 || !pos.isValid())
+    return false;
+
+  float x = pos.getLonX(), y = pos.getLatY();
+  bool inside = false;
+  for(int i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+  {
+    float xi = normalizeLon(polygon.at(i).getLonX(), x), yi = polygon.at(i).getLatY();
+    float xj = normalizeLon(polygon.at(j).getLonX(), x), yj = polygon.at(j).getLatY();
+
+    if(((yi > y) != (yj > y)) && (x < (xj - xi) * (y - yi) / (yj - yi) + xi))
+      inside = !inside;
+  }
+  return inside;
+}
+
+bool AirspaceIndex::crossesLine(const atools::geo::LineString& polygon, const atools::geo::Pos& from,
+                                const atools::geo::Pos& to)
+{
+  if(containsPos(polygon, from) || containsPos(polygon, to))
+    return true;
+
+  if(polygon.size() < 2 || !from.isValid() || !to.isValid())
+    return false;
+
+  // Check for intersection with any boundary segment
+  float ax = from.getLonX(), ay = from.getLatY();
+  float bx = normalizeLon(to.getLonX(), ax), by = to.getLatY();
+  for(int i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+  {
+    float cx = normalizeLon(polygon.at(i).getLonX(), ax), cy = polygon.at(i).getLatY();
+    float dx = normalizeLon(polygon.at(j).getLonX(), ax), dy = polygon.at(j).getLatY();
+
+    float o1 = orientation(ax, ay, bx, by, cx, cy), o2 = orientation(ax, ay, bx, by, dx, dy);
+    float o3 = orientation(cx, cy, dx, dy, ax, ay), o4 = orientation(cx, cy, dx, dy, bx, by);
+
+    if(((o1 > 0.f) != (o2 > 0.f)) && ((o3 > 0.f) != (o4 > 0.f)))
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_AIRSPACEINDEX_H
+#define LITTLENAVMAP_AIRSPACEINDEX_H
+
+#include "common/maptypes.h"
+
+#include <QVector>
+
+namespace atools {
+namespace geo {
+class LineString;
+class Pos;
+class Rect;
+}
+}
+
+/*
+ * Static R-tree of airspace bounding rectangles which is bulk loaded using sort tile recursive packing.
+ * Airspaces crossing the anti-meridian are split into two entries.
+ *
+ * Provides also the exact tests on the airspace geometry. Geometry is treated as planar in degrees which
+ * is sufficiently accurate for the lookup of airspaces at a position or along a flight plan.
+ */
+class AirspaceIndex
+{
+public:
+  /* Builds the tree for all given airspaces which are copied */
+  void build(const QList<map::MapAirspace>& airspaceList);
+  void clear();
+
+  bool isEmpty() const
+  {
+    return airspaces.isEmpty();
+  }
+
+  /* Get indexes of all airspaces having a bounding rectangle overlapping rect. Result is sorted. */
+  void getCandidates(QVector<int>& indexes, const atools::geo::Rect& rect) const;
+
+  const map::MapAirspace& at(int index) const
+  {
+    return airspaces.at(index);
+  }
+
+  /* true if the altitude in feet is within the airspace limits. Always true if altitude is negative. */
+  static bool containsAltitude(const map::MapAirspace& airspace, float altitudeFt);
+
+  /* Even-odd test if pos is inside the polygon */
+  static bool containsPos(const atools::geo::LineString& polygon, const atools::geo::Pos& pos);
+
+  /* true if the line from one to two is inside or crosses the polygon boundary */
+  static bool crossesLine(const atools::geo::LineString& polygon, const atools::geo::Pos& from,
+                          const atools::geo::Pos& to);
+
+private:
+  /* Bounding rectangle and range of children in the next lower level or entries for the leaf level */
+  struct Node
+  {
+    float west, south, east, north;
+    int first, count;
+  };
+
+  /* Split anti-meridian crossing rectangles and call function for each part */
+  template<typename FUNC>
+  static void splitRect(const atools::geo::Rect& rect, FUNC func);
+
+  /* Sort tile recursive packing of one level */
+  static void sortTiles(QVector<Node>& nodes);
+  static QVector<Node> packLevel(const QVector<Node>& nodes);
+
+  static bool overlaps(const Node& node, float west, float south, float east, float north)
+  {
+    return !(node.east < west || node.west > east || node.north < south || node.south > north);
+  }
+
+  /* Number of children for each node */
+  static Q_DECL_CONSTEXPR int NODE_SIZE = 16;
+
+  QVector<map::MapAirspace> airspaces;
+
+  /* Leaf entries pointing into airspaces using first */
+  QVector<Node> entries;
+
+  /* Levels from leafs (0) to root */
+  QVector<QVector<Node> > levels;
+};
+
+#endif // LITTLENAVMAP_AIRSPACEINDEX_H
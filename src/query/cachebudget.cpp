@@ -0,0 +1,205 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+
+#include "query/cachebudget.h"
+
+#include "common/constants.h"
+#include "common/maptypes.h"
+#include "common/proctypes.h"
+#include "geo/linestring.h"
+#include "settings/settings.h"
+#include "sql/sqlrecord.h"
+
+#include <QDebug>
+#include <QTimer>
+
+#include <algorithm>
+
+CacheBudget *CacheBudget::cacheBudget = nullptr;
+
+CacheBudget::CacheBudget()
+{
+  bool ok;
+  budgetKb = atools::settings::Settings::instance().getAndStoreValue(lnm::SETTINGS_CACHE_BUDGET_KB, 100000).toInt(&ok);
+  if(!ok || budgetKb < MIN_BUDGET_KB || budgetKb > MAX_BUDGET_KB)
+  {
+    qWarning() << Q_FUNC_INFO << "invalid budget" << budgetKb << "kB";
+    if(!ok)
+      budgetKb = 100000;
+    else if(budgetKb < MIN_BUDGET_KB)
+      budgetKb = MIN_BUDGET_KB;
+    else
+      budgetKb = MAX_BUDGET_KB;
+  }
+  budgetBytes = budgetKb * 1024;
+  qDebug() << Q_FUNC_INFO << "budget" << budgetKb << "kB";
+}
+
+CacheBudget& CacheBudget::instance()
+{
+  // Never deleted since caches of other singletons can be unregistered late on shutdown
+  if(cacheBudget == nullptr)
+    cacheBudget = new CacheBudget();
+  return *cacheBudget;
+}
+
+void CacheBudget::unregisterCaches(const void *owner)
+{
+  caches.erase(std::remove_if(caches.begin(), caches.end(), [owner](const Cache& cache) -> bool
+  {
+    return cache.owner == owner;
+  }), caches.end());
+}
+
+void CacheBudget::scheduleEnforce()
+{
+  if(!enforcePending)
+  {
+    enforcePending = true;
+    QTimer::singleShot(0, [this]() -> void
+    {
+      enforcePending = false;
+      enforce();
+    });
+  }
+}
+
+void CacheBudget::enforce()
+{
+  qint64 total = getTotalCostBytes();
+  if(total <= budgetBytes)
+    return;
+
+  // Go a bit below the budget to avoid evicting on each insert
+  qint64 excess = total - budgetBytes * Q_INT64_C(9) / 10;
+
+  // Largest caches first
+  QVector<int> order;
+  for(int i = 0; i < caches.size(); i++)
+    order.append(i);
+  std::sort(order.begin(), order.end(), [this](int i1, int i2) -> bool
+  {
+    return caches.at(i1).totalCost() > caches.at(i2).totalCost();
+  });
+
+  for(int i = 0; i < order.size() && excess > 0; i++)
+  {
+    const Cache& cache = caches.at(order.at(i));
+    int cost = cache.totalCost();
+
+    // Shrinking evicts the least recently used objects - then restore the limit
+    cache.setMaxCost(static_cast<int>(std::max(Q_INT64_C(0), cost - excess)));
+    cache.setMaxCost(MAX_CACHE_COST);
+    excess -= cost - cache.totalCost();
+  }
+
+  qDebug() << Q_FUNC_INFO << "total before" << total / 1024 << "kB after" << getTotalCostKb()
+           << "kB budget" << budgetKb << "kB";
+}
+
+int CacheBudget::getTotalCostKb() const
+{
+  return static_cast<int>(getTotalCostBytes() / 1024);
+}
+
+qint64 CacheBudget::getTotalCostBytes() const
+{
+  qint64 total = 0;
+  for(const Cache& cache : caches)
+    total += cache.totalCost();
+  return total;
+}
+
+QStringList CacheBudget::getUsageText(int maxCaches) const
+{
+  QVector<const Cache *> sorted;
+  for(const Cache& cache : caches)
+    sorted.append(&cache);
+  std::sort(sorted.begin(), sorted.end(), [](const Cache *c1, const Cache *c2) -> bool
+  {
+    return c1->totalCost() > c2->totalCost();
+  });
+
+  QStringList lines;
+  lines.append(QString("Caches %1 of %2 kB").arg(getTotalCostKb()).arg(budgetKb));
+  for(int i = 0; i < sorted.size() && (maxCaches == -1 || i < maxCaches); i++)
+    lines.append(QString("%1 %2 objects, %3 kB").
+                 arg(sorted.at(i)->name, -24).
+                 arg(sorted.at(i)->count(), 6).
+                 arg(sorted.at(i)->totalCost() / 1024, 6));
+  return lines;
+}
+
+int CacheBudget::toCost(qint64 bytes)
+{
+  return static_cast<int>(std::min(static_cast<qint64>(MAX_CACHE_COST), bytes));
+}
+
+int CacheBudget::cost(const atools::sql::SqlRecord& record)
+{
+  // Assume short strings or numbers for each value
+  return toCost(static_cast<qint64>(sizeof(atools::sql::SqlRecord)) + record.count() * 64);
+}
+
+int CacheBudget::cost(const atools::sql::SqlRecordVector& records)
+{
+  qint64 size = static_cast<qint64>(sizeof(atools::sql::SqlRecordVector));
+  for(const atools::sql::SqlRecord& record : records)
+    size += static_cast<qint64>(sizeof(atools::sql::SqlRecord)) + record.count() * 64;
+  return toCost(size);
+}
+
+int CacheBudget::cost(const atools::geo::LineString& line)
+{
+  return toCost(static_cast<qint64>(sizeof(atools::geo::LineString)) +
+              line.size() * static_cast<qint64>(sizeof(atools::geo::Pos)));
+}
+
+int CacheBudget::cost(const map::MapAirport& airport)
+{
+  Q_UNUSED(airport);
+  return toCost(static_cast<qint64>(sizeof(map::MapAirport)));
+}
+
+int CacheBudget::cost(const map::MapAirportDiagram& diagram)
+{
+  return toCost(diagram.memorySize());
+}
+
+int CacheBudget::cost(const proc::MapProcedureLegs& legs)
+{
+  qint64 size = static_cast<qint64>(sizeof(proc::MapProcedureLegs));
+  for(const proc::MapProcedureLeg& leg : legs.approachLegs)
+    size += static_cast<qint64>(sizeof(proc::MapProcedureLeg)) +
+            leg.geometry.size() * static_cast<qint64>(sizeof(atools::geo::Pos));
+  for(const proc::MapProcedureLeg& leg : legs.transitionLegs)
+    size += static_cast<qint64>(sizeof(proc::MapProcedureLeg)) +
+            leg.geometry.size() * static_cast<qint64>(sizeof(atools::geo::Pos));
+  return toCost(size);
+}
+
+int CacheBudget::cost(const QList<map::MapApron>& aprons)
+{
+  // Geometry is the largest part for aprons
+  qint64 size = static_cast<qint64>(sizeof(QList<map::MapApron>));
+  for(const map::MapApron& apron : aprons)
+    size += static_cast<qint64>(sizeof(map::MapApron)) +
+            apron.vertices.size() * static_cast<qint64>(sizeof(atools::geo::Pos)) +
+            apron.xplanePath.elementCount() * static_cast<qint64>(sizeof(QPainterPath::Element));
+  return toCost(size);
+}
@@ -0,0 +1,175 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+
+#ifndef LITTLENAVMAP_CACHEBUDGET_H
+#define LITTLENAVMAP_CACHEBUDGET_H
+
+#include <QCache>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+namespace atools {
+namespace geo {
+class LineString;
+}
+namespace sql {
+class SqlRecord;
+class SqlRecordVector;
+}
+}
+
+namespace map {
+struct MapAirport;
+struct MapAirportDiagram;
+struct MapApron;
+}
+
+namespace proc {
+struct MapProcedureLegs;
+}
+
+/*
+ * Central accounting for the object caches of the query classes.
+ *
+ * Registered caches use estimated bytes as cost for each object. Bytes avoid inflating small objects
+ * like single records which would all cost one kilobyte. The maximum cost of each cache is far above
+ * the budget so that QCache never drops an object on insert. After inserting objects the total cost of
+ * all caches is checked in the next event loop iteration. If above budget, least recently used objects
+ * are evicted from the caches using the most memory first. Deferring the check keeps pointers returned
+ * right after inserting valid.
+ *
+ * Budget is read from the configuration file and limited to MIN_BUDGET_KB and MAX_BUDGET_KB.
+ * Not thread safe.
+ */
+class CacheBudget
+{
+public:
+  static CacheBudget& instance();
+
+  /* Register cache with a name for the usage overview. owner is used to unregister all caches of an object. */
+  template<typename KEY, typename TYPE>
+  void registerCache(const void *owner, const QString& name, QCache<KEY, TYPE> *cache);
+  void unregisterCaches(const void *owner);
+
+  /* Insert object with estimated cost and schedule a budget check. Same as QCache::insert. */
+  template<typename KEY, typename TYPE>
+  bool insert(QCache<KEY, TYPE>& cache, const KEY& key, TYPE *object)
+  {
+    return insert(cache, key, object, cost(*object));
+  }
+
+  template<typename KEY, typename TYPE>
+  bool insert(QCache<KEY, TYPE>& cache, const KEY& key, TYPE *object, int costBytes);
+
+  /* Evict objects until the total cost is below the budget */
+  void enforce();
+
+  int getBudgetKb() const
+  {
+    return budgetKb;
+  }
+
+  /* Sum of the costs of all registered caches in kilobytes */
+  int getTotalCostKb() const;
+
+  /* Total and usage per cache sorted by cost descending. maxCaches limits the number of cache lines. */
+  QStringList getUsageText(int maxCaches = -1) const;
+
+  /* Estimated memory usage in bytes which is used as cache cost */
+  static int cost(const atools::sql::SqlRecord& record);
+  static int cost(const atools::sql::SqlRecordVector& records);
+  static int cost(const atools::geo::LineString& line);
+  static int cost(const map::MapAirport& airport);
+  static int cost(const map::MapAirportDiagram& diagram);
+  static int cost(const proc::MapProcedureLegs& legs);
+  static int cost(const QList<map::MapApron>& aprons);
+
+  template<typename TYPE>
+  static int cost(const QList<TYPE>& list)
+  {
+    return toCost(static_cast<qint64>(sizeof(QList<TYPE>)) + list.size() * static_cast<qint64>(sizeof(TYPE)));
+  }
+
+private:
+  CacheBudget();
+
+  struct Cache
+  {
+    const void *owner;
+    QString name;
+    std::function<int()> totalCost /* bytes */, count;
+    std::function<void(int)> setMaxCost;
+  };
+
+  /* Clamp to MAX_CACHE_COST */
+  static int toCost(qint64 bytes);
+
+  qint64 getTotalCostBytes() const;
+
+  /* Start enforce() in the next event loop iteration */
+  void scheduleEnforce();
+
+  QVector<Cache> caches;
+  int budgetKb, budgetBytes;
+  bool enforcePending = false;
+
+  static CacheBudget *cacheBudget;
+
+  /* Limits for the budget setting in kB */
+  static Q_DECL_CONSTEXPR int MIN_BUDGET_KB = 10000;
+  static Q_DECL_CONSTEXPR int MAX_BUDGET_KB = 500000;
+
+  /* Maximum cost of each cache in bytes. Twice the maximum budget to keep inserts from evicting objects. */
+  static Q_DECL_CONSTEXPR int MAX_CACHE_COST = 1 << 30;
+};
+
+// ---------------------------------------------------------------------------------
+template<typename KEY, typename TYPE>
+void CacheBudget::registerCache(const void *owner, const QString& name, QCache<KEY, TYPE> *cache)
+{
+  cache->setMaxCost(MAX_CACHE_COST);
+
+  Cache entry;
+  entry.owner = owner;
+  entry.name = name;
+  entry.totalCost = [cache]() -> int
+  {
+    return cache->totalCost();
+  };
+  entry.count = [cache]() -> int
+  {
+    return cache->count();
+  };
+  entry.setMaxCost = [cache](int maxCost) -> void
+  {
+    cache->setMaxCost(maxCost);
+  };
+  caches.append(entry);
+}
+
+template<typename KEY, typename TYPE>
+bool CacheBudget::insert(QCache<KEY, TYPE>& cache, const KEY& key, TYPE *object, int costBytes)
+{
+  bool inserted = cache.insert(key, object, costBytes);
+  scheduleEnforce();
+  return inserted;
+}
+
+#endif // LITTLENAVMAP_CACHEBUDGET_H
@@ -18,8 +18,9 @@
 #include "query/infoquery.h"
 
 #include "sql/sqldatabase.h"
-#include "settings/settings.h"
-#include "common/constants.h"
+#include "query/cachebudget.h"
+
+#include <QStringList>
 
 using atools::sql::SqlQuery;
 using atools::sql::SqlDatabase;
@@ -29,29 +30,29 @@ using atools::sql::SqlRecordVector;
 InfoQuery::InfoQuery(SqlDatabase *sqlDb, atools::sql::SqlDatabase *sqlDbNav)
   : db(sqlDb), dbNav(sqlDbNav)
 {
-  atools::settings::Settings& settings = atools::settings::Settings::instance();
-  airportCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "AirportCache", 100).toInt());
-  vorCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "VorCache", 100).toInt());
-  ndbCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "NdbCache", 100).toInt());
-  waypointCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "WaypointCache", 100).toInt());
-  airwayCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "AirwayCache", 100).toInt());
-  runwayEndCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "RunwayEndCache", 100).toInt());
-  ilsCacheSim.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "IlsCache", 100).toInt());
-  ilsCacheNav.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "IlsCache", 100).toInt());
-  ilsCacheSimByName.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "IlsCache", 100).toInt());
-  comCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "ComCache", 100).toInt());
-  runwayCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "RunwayCache", 100).toInt());
-  helipadCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "HelipadCache", 100).toInt());
-  startCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "StartCache", 100).toInt());
-  approachCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "ApproachCache", 100).toInt());
-  transitionCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "TransitionCache", 100).toInt());
-  airspaceCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "AirspaceCache", 100).toInt());
-  airportSceneryCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_INFOQUERY + "AirportSceneryCache",
-                                                           100).toInt());
+  CacheBudget& budget = CacheBudget::instance();
+  budget.registerCache(this, "Info airports", &airportCache);
+  budget.registerCache(this, "Info VOR", &vorCache);
+  budget.registerCache(this, "Info NDB", &ndbCache);
+  budget.registerCache(this, "Info waypoints", &waypointCache);
+  budget.registerCache(this, "Info airways", &airwayCache);
+  budget.registerCache(this, "Info runway ends", &runwayEndCache);
+  budget.registerCache(this, "Info ILS sim", &ilsCacheSim);
+  budget.registerCache(this, "Info ILS nav", &ilsCacheNav);
+  budget.registerCache(this, "Info ILS by name", &ilsCacheSimByName);
+  budget.registerCache(this, "Info COM", &comCache);
+  budget.registerCache(this, "Info runways", &runwayCache);
+  budget.registerCache(this, "Info helipads", &helipadCache);
+  budget.registerCache(this, "Info starts", &startCache);
+  budget.registerCache(this, "Info approaches", &approachCache);
+  budget.registerCache(this, "Info transitions", &transitionCache);
+  budget.registerCache(this, "Info airspaces", &airspaceCache);
+  budget.registerCache(this, "Info airport scenery", &airportSceneryCache);
 }
 
 InfoQuery::~InfoQuery()
 {
+  CacheBudget::instance().unregisterCaches(this);
   deInitQueries();
 }
 
@@ -126,7 +127,7 @@ const atools::sql::SqlRecordVector *InfoQuery::getIlsInformationSimByName(const
     while(ilsQuerySimByName->next())
       rec->append(ilsQuerySimByName->record());
 
-    ilsCacheSimByName.insert(key, rec);
+    CacheBudget::instance().insert(ilsCacheSimByName, key, rec);
   }
   return rec;
 }
@@ -180,6 +181,134 @@ atools::sql::SqlRecordVector InfoQuery::getAirwayWaypointInformation(const QStri
   return rec;
 }
 
+void InfoQuery::prefetchAirportInformation(int airportId, int airportIdNav)
+{
+  if(airportId == prefetchedAirportId && airportIdNav == prefetchedAirportIdNav &&
+     airportCache.contains(airportId) && runwayCache.contains(airportId) && comCache.contains(airportId) &&
+     helipadCache.contains(airportId) && startCache.contains(airportId) && approachCache.contains(airportIdNav))
+    // Still all in cache
+    return;
+
+  prefetchedAirportId = airportId;
+  prefetchedAirportIdNav = airportIdNav;
+
+  // Simulator database ==========================================================
+  if(airportId != -1)
+  {
+    const SqlRecord *airportRec = cachedRecord(airportCache, airportQuery, airportId);
+    cachedRecordVector(comCache, comQuery, airportId);
+    cachedRecordVector(helipadCache, helipadQuery, airportId);
+    cachedRecordVector(startCache, startQuery, airportId);
+    const SqlRecordVector *runways = cachedRecordVector(runwayCache, runwayQuery, airportId);
+
+    if(runways != nullptr)
+    {
+      // Load all runway ends of the airport with one query if any is missing ================
+      bool missing = false;
+      for(const SqlRecord& rec : *runways)
+      {
+        if(!runwayEndCache.contains(rec.valueInt("primary_end_id")) ||
+           !runwayEndCache.contains(rec.valueInt("secondary_end_id")))
+        {
+          missing = true;
+          break;
+        }
+      }
+
+      if(missing)
+      {
+        runwayEndByAirportQuery->bindValue(":id", airportId);
+        runwayEndByAirportQuery->exec();
+        while(runwayEndByAirportQuery->next())
+          CacheBudget::instance().insert(runwayEndCache, runwayEndByAirportQuery->value("runway_end_id").toInt(),
+                                         new SqlRecord(runwayEndByAirportQuery->record()));
+        runwayEndByAirportQuery->finish();
+      }
+
+      // Load all ILS of the airport with one query and sort them by runway end ================
+      if(airportRec != nullptr)
+      {
+        QString ident = airportRec->valueStr("ident");
+
+        QStringList runwayEndNames;
+        bool missingIls = false;
+        for(const SqlRecord& rec : *runways)
+        {
+          for(int endId : {rec.valueInt("primary_end_id"), rec.valueInt("secondary_end_id")})
+          {
+            const SqlRecord *endRec = runwayEndCache.object(endId);
+            if(endRec != nullptr)
+            {
+              runwayEndNames.append(endRec->valueStr("name"));
+              missingIls |= !ilsCacheSimByName.contains(std::make_pair(ident, runwayEndNames.last()));
+            }
+          }
+        }
+
+        if(missingIls)
+        {
+          QHash<QString, SqlRecordVector *> ilsByRunway;
+          for(const QString& name : runwayEndNames)
+            ilsByRunway.insert(name, new SqlRecordVector);
+
+          ilsByAirportQuery->bindValue(":apt", ident);
+          ilsByAirportQuery->exec();
+          while(ilsByAirportQuery->next())
+          {
+            QString runway = ilsByAirportQuery->value("loc_runway_name").toString();
+            if(!ilsByRunway.contains(runway))
+              ilsByRunway.insert(runway, new SqlRecordVector);
+            ilsByRunway.value(runway)->append(ilsByAirportQuery->record());
+          }
+          ilsByAirportQuery->finish();
+
+          // Insert all, also empty ones which indicate that a runway end has no ILS
+          for(auto it = ilsByRunway.constBegin(); it != ilsByRunway.constEnd(); ++it)
+            CacheBudget::instance().insert(ilsCacheSimByName, std::make_pair(ident, it.key()), it.value());
+        }
+      }
+    }
+  }
+
+  // Navigation database ==========================================================
+  if(airportIdNav != -1)
+  {
+    const SqlRecordVector *approaches = cachedRecordVector(approachCache, approachQuery, airportIdNav);
+
+    if(approaches != nullptr)
+    {
+      QVector<int> missingIds;
+      for(const SqlRecord& rec : *approaches)
+      {
+        int approachId = rec.valueInt("approach_id");
+        if(!transitionCache.contains(approachId))
+          missingIds.append(approachId);
+      }
+
+      if(!missingIds.isEmpty())
+      {
+        // Load all transitions of all approaches with one query ================
+        QHash<int, SqlRecordVector *> transByApproach;
+        for(int approachId : missingIds)
+          transByApproach.insert(approachId, new SqlRecordVector);
+
+        transitionByAirportQuery->bindValue(":id", airportIdNav);
+        transitionByAirportQuery->exec();
+        while(transitionByAirportQuery->next())
+        {
+          int approachId = transitionByAirportQuery->value("approach_id").toInt();
+          if(transByApproach.contains(approachId))
+            transByApproach.value(approachId)->append(transitionByAirportQuery->record());
+        }
+        transitionByAirportQuery->finish();
+
+        for(auto it = transByApproach.constBegin(); it != transByApproach.constEnd(); ++it)
+          CacheBudget::instance().insert(transitionCache, it.key(), it.value());
+      }
+    }
+  }
+}
+
 /* Get a record from the cache of get it from a database query */
 template<typename ID>
 const SqlRecord *InfoQuery::cachedRecord(QCache<ID, SqlRecord>& cache, SqlQuery *query, ID id)
@@ -202,11 +331,11 @@ const SqlRecord *InfoQuery::cachedRecord(QCache<ID, SqlRecord>& cache, SqlQuery
     {
       // Insert it into the cache
       rec = new SqlRecord(query->record());
-      cache.insert(id, rec);
+      CacheBudget::instance().insert(cache, id, rec);
     }
     else
       // Add empty record to indicate nothing found for this id
-      cache.insert(id, new SqlRecord());
+      CacheBudget::instance().insert(cache, id, new SqlRecord());
   }
   query->finish();
   return rec;
@@ -237,7 +366,7 @@ const SqlRecordVector *InfoQuery::cachedRecordVector(QCache<ID, SqlRecordVector>
       rec->append(query->record());
 
     // Insert it into the cache
-    cache.insert(id, rec);
+    CacheBudget::instance().insert(cache, id, rec);
 
     if(rec->isEmpty())
       return nullptr;
@@ -341,6 +470,20 @@ void InfoQuery::initQueries()
 
   transitionQuery = new SqlQuery(dbNav);
   transitionQuery->prepare("select * from transition where approach_id = :id order by fix_ident");
+
+  runwayEndByAirportQuery = new SqlQuery(db);
+  runwayEndByAirportQuery->prepare("select e.* from runway r "
+                                   "join runway_end e on "
+                                   "(e.runway_end_id = r.primary_end_id or e.runway_end_id = r.secondary_end_id) "
+                                   "where r.airport_id = :id");
+
+  ilsByAirportQuery = new SqlQuery(db);
+  ilsByAirportQuery->prepare("select * from ils where loc_airport_ident = :apt");
+
+  transitionByAirportQuery = new SqlQuery(dbNav);
+  transitionByAirportQuery->prepare("select t.* from transition t "
+                                    "join approach a on t.approach_id = a.approach_id "
+                                    "where a.airport_id = :id order by t.approach_id, t.fix_ident");
 }
 
 void InfoQuery::deInitQueries()
@@ -362,6 +505,7 @@ void InfoQuery::deInitQueries()
   approachCache.clear();
   transitionCache.clear();
   airportSceneryCache.clear();
+  prefetchedAirportId = prefetchedAirportIdNav = -1;
 
   delete airportQuery;
   airportQuery = nullptr;
@@ -419,4 +563,13 @@ void InfoQuery::deInitQueries()
 
   delete transitionQuery;
   transitionQuery = nullptr;
+
+  delete runwayEndByAirportQuery;
+  runwayEndByAirportQuery = nullptr;
+
+  delete ilsByAirportQuery;
+  ilsByAirportQuery = nullptr;
+
+  delete transitionByAirportQuery;
+  transitionByAirportQuery = nullptr;
 }
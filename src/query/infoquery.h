@@ -92,6 +92,13 @@ public:
   /* Get record for table transition */
   const atools::sql::SqlRecordVector *getTransitionInformation(int approachId);
 
+  /* Loads all airport related records (COM, runways, runway ends, helipads, starts, ILS, approaches and
+   * transitions) with a few joined queries in one pass and fills the caches above.
+   * Following calls of the get methods for this airport will not issue any further queries.
+   * @param airportId airport id in the simulator database
+   * @param airportIdNav same airport in the navigation database which is used for procedures. */
+  void prefetchAirportInformation(int airportId, int airportIdNav);
+
   /* Create all queries */
   void initQueries();
 
@@ -122,6 +129,9 @@ private:
 
   QCache<QString, atools::sql::SqlRecordVector> airportSceneryCache;
 
+  /* Remember last prefetched airport to avoid repeated loading */
+  int prefetchedAirportId = -1, prefetchedAirportIdNav = -1;
+
   atools::sql::SqlDatabase *db, *dbNav;
 
   /* Prepared database queries */
@@ -134,6 +144,10 @@ private:
                         *airwayWaypointQuery = nullptr, *vorIdentRegionQuery = nullptr, *approachQuery = nullptr,
                         *transitionQuery = nullptr;
 
+  /* Queries fetching all records for an airport at once to fill the caches */
+  atools::sql::SqlQuery *runwayEndByAirportQuery = nullptr, *ilsByAirportQuery = nullptr,
+                        *transitionByAirportQuery = nullptr;
+
 };
 
 #endif // LITTLENAVMAP_INFOQUERY_H
@@ -23,14 +23,21 @@
 #include "fs/common/binarygeometry.h"
 #include "sql/sqlquery.h"
 #include "query/airportquery.h"
+#include "query/cachebudget.h"
 #include "navapp.h"
 #include "common/maptools.h"
 #include "settings/settings.h"
 #include "fs/common/xpgeometry.h"
 
+#include <marble/ViewportParams.h>
+
 #include <QDataStream>
+#include <QElapsedTimer>
 #include <QRegularExpression>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace Marble;
 using namespace atools::sql;
 using namespace atools::geo;
@@ -60,9 +67,9 @@ MapQuery::MapQuery(QObject *parent, atools::sql::SqlDatabase *sqlDb, SqlDatabase
   mapTypesFactory = new MapTypesFactory();
   atools::settings::Settings& settings = atools::settings::Settings::instance();
 
-  runwayOverwiewCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "RunwayOverwiewCache",
-                                                           1000).toInt());
-  airspaceLineCache.setMaxCost(settings.getAndStoreValue(lnm::SETTINGS_MAPQUERY + "AirspaceLineCache", 10000).toInt());
+  CacheBudget& budget = CacheBudget::instance();
+  budget.registerCache(this, "Map runway overview", &runwayOverwiewCache);
+  budget.registerCache(this, "Map airspace lines", &airspaceLineCache);
 
   queryRectInflationFactor = settings.getAndStoreValue(
     lnm::SETTINGS_MAPQUERY + "QueryRectInflationFactor", 0.3).toDouble();
@@ -74,6 +81,7 @@ MapQuery::MapQuery(QObject *parent, atools::sql::SqlDatabase *sqlDb, SqlDatabase
 
 MapQuery::~MapQuery()
 {
+  CacheBudget::instance().unregisterCaches(this);
   deInitQueries();
   delete mapTypesFactory;
 }
@@ -498,7 +506,12 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
       {
         if(conv.wToS(airport.position, x, y))
           if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-            insertSortedByDistance(conv, result.airports, &result.airportIds, xs, ys, airport);
+          {
+            if(result.idsOnly)
+              result.addRef(airport.id, map::AIRPORT);
+            else
+              insertSortedByDistance(conv, result.airports, &result.airportIds, xs, ys, airport);
+          }
 
         if(airportDiagram)
         {
@@ -518,7 +531,12 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
       const MapVor& vor = vorCache.list.at(i);
       if(conv.wToS(vor.position, x, y))
         if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.vors, &result.vorIds, xs, ys, vor);
+        {
+          if(result.idsOnly)
+            result.addRef(vor.id, map::VOR);
+          else
+            insertSortedByDistance(conv, result.vors, &result.vorIds, xs, ys, vor);
+        }
     }
   }
 
@@ -529,7 +547,12 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
       const MapNdb& ndb = ndbCache.list.at(i);
       if(conv.wToS(ndb.position, x, y))
         if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.ndbs, &result.ndbIds, xs, ys, ndb);
+        {
+          if(result.idsOnly)
+            result.addRef(ndb.id, map::NDB);
+          else
+            insertSortedByDistance(conv, result.ndbs, &result.ndbIds, xs, ys, ndb);
+        }
     }
   }
 
@@ -540,7 +563,12 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
       const MapWaypoint& wp = waypointCache.list.at(i);
       if(conv.wToS(wp.position, x, y))
         if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-          insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+        {
+          if(result.idsOnly)
+            result.addRef(wp.id, map::WAYPOINT);
+          else
+            insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+        }
     }
   }
 
@@ -553,7 +581,12 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
          (wp.hasJetAirways && types.testFlag(map::AIRWAYJ)))
         if(conv.wToS(wp.position, x, y))
           if((atools::geo::manhattanDistance(x, y, xs, ys)) < screenDistance)
-            insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+          {
+            if(result.idsOnly)
+              result.addRef(wp.id, map::WAYPOINT);
+            else
+              insertSortedByDistance(conv, result.waypoints, &result.waypointIds, xs, ys, wp);
+          }
     }
   }
 
@@ -614,25 +647,31 @@ void MapQuery::getNearestObjects(const CoordinateConverter& conv, const MapLayer
 const QList<map::MapAirport> *MapQuery::getAirports(const Marble::GeoDataLatLonBox& rect,
                                                     const MapLayer *mapLayer, bool lazy)
 {
-  airportCache.updateCache(rect, mapLayer, lazy,
-                           [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  bool changed = airportCache.updateCache(rect, visibleCap, mapLayer, lazy,
+                                          [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersAirport(newLayer);
-  });
+  }, queryStatistics);
 
   switch(mapLayer->getDataSource())
   {
     case layer::ALL:
+      if(airportRankingLevel != -1 && !lazy)
+      {
+        // Loaded from ranking before - clear also if a list from the ranking was restored
+        airportCache.list.clear();
+        airportRankingLevel = -1;
+      }
       airportByRectQuery->bindValue(":minlength", mapLayer->getMinRunwayLength());
       return fetchAirports(rect, airportByRectQuery, true /* reverse */, lazy, false /* overview */);
 
     case layer::MEDIUM:
       // Airports > 4000 ft
-      return fetchAirports(rect, airportMediumByRectQuery, false /* reverse */, lazy, true /* overview */);
+      return fetchAirportsRanked(rect, airportRankingMedium, airportMediumQuery, lazy, changed);
 
     case layer::LARGE:
       // Airports > 8000 ft
-      return fetchAirports(rect, airportLargeByRectQuery, false /* reverse */, lazy, true /* overview */);
+      return fetchAirportsRanked(rect, airportRankingLarge, airportLargeQuery, lazy, changed);
 
   }
   return nullptr;
@@ -641,26 +680,31 @@ const QList<map::MapAirport> *MapQuery::getAirports(const Marble::GeoDataLatLonB
 const QList<map::MapWaypoint> *MapQuery::getWaypoints(const GeoDataLatLonBox& rect,
                                                       const MapLayer *mapLayer, bool lazy)
 {
-  waypointCache.updateCache(rect, mapLayer, lazy,
+  waypointCache.updateCache(rect, visibleCap, mapLayer, lazy,
                             [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersWaypoint(newLayer);
-  });
+  }, queryStatistics);
 
   if(waypointCache.list.isEmpty() && !lazy)
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    QElapsedTimer timer;
+    timer.start();
+    for(const GeoDataLatLonBox& r : splitVisible(rect))
     {
       bindCoordinatePointInRect(r, waypointsByRectQuery);
       waypointsByRectQuery->exec();
       while(waypointsByRectQuery->next())
       {
         map::MapWaypoint wp;
-        mapTypesFactory->fillWaypoint(waypointsByRectQuery->record(), wp);
+        mapTypesFactory->fillWaypoint(waypointsByRectQuery, waypointColumns, wp);
         waypointCache.list.append(wp);
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   waypointCache.validate();
   return &waypointCache.list;
 }
@@ -668,26 +712,31 @@ const QList<map::MapWaypoint> *MapQuery::getWaypoints(const GeoDataLatLonBox& re
 const QList<map::MapVor> *MapQuery::getVors(const GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                             bool lazy)
 {
-  vorCache.updateCache(rect, mapLayer, lazy,
+  vorCache.updateCache(rect, visibleCap, mapLayer, lazy,
                        [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersVor(newLayer);
-  });
+  }, queryStatistics);
 
   if(vorCache.list.isEmpty() && !lazy)
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    QElapsedTimer timer;
+    timer.start();
+    for(const GeoDataLatLonBox& r : splitVisible(rect))
     {
       bindCoordinatePointInRect(r, vorsByRectQuery);
       vorsByRectQuery->exec();
       while(vorsByRectQuery->next())
       {
         map::MapVor vor;
-        mapTypesFactory->fillVor(vorsByRectQuery->record(), vor);
+        mapTypesFactory->fillVor(vorsByRectQuery, vorColumns, vor);
         vorCache.list.append(vor);
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   vorCache.validate();
   return &vorCache.list;
 }
@@ -695,26 +744,31 @@ const QList<map::MapVor> *MapQuery::getVors(const GeoDataLatLonBox& rect, const
 const QList<map::MapNdb> *MapQuery::getNdbs(const GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                             bool lazy)
 {
-  ndbCache.updateCache(rect, mapLayer, lazy,
+  ndbCache.updateCache(rect, visibleCap, mapLayer, lazy,
                        [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersNdb(newLayer);
-  });
+  }, queryStatistics);
 
   if(ndbCache.list.isEmpty() && !lazy)
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    QElapsedTimer timer;
+    timer.start();
+    for(const GeoDataLatLonBox& r : splitVisible(rect))
     {
       bindCoordinatePointInRect(r, ndbsByRectQuery);
       ndbsByRectQuery->exec();
       while(ndbsByRectQuery->next())
       {
         map::MapNdb ndb;
-        mapTypesFactory->fillNdb(ndbsByRectQuery->record(), ndb);
+        mapTypesFactory->fillNdb(ndbsByRectQuery, ndbColumns, ndb);
         ndbCache.list.append(ndb);
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   ndbCache.validate();
   return &ndbCache.list;
 }
@@ -722,15 +776,17 @@ const QList<map::MapNdb> *MapQuery::getNdbs(const GeoDataLatLonBox& rect, const
 const QList<map::MapMarker> *MapQuery::getMarkers(const GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                                   bool lazy)
 {
-  markerCache.updateCache(rect, mapLayer, lazy,
+  markerCache.updateCache(rect, visibleCap, mapLayer, lazy,
                           [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersMarker(newLayer);
-  });
+  }, queryStatistics);
 
   if(markerCache.list.isEmpty() && !lazy)
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    QElapsedTimer timer;
+    timer.start();
+    for(const GeoDataLatLonBox& r : splitVisible(rect))
     {
       bindCoordinatePointInRect(r, markersByRectQuery);
       markersByRectQuery->exec();
@@ -741,22 +797,27 @@ const QList<map::MapMarker> *MapQuery::getMarkers(const GeoDataLatLonBox& rect,
         markerCache.list.append(marker);
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   markerCache.validate();
   return &markerCache.list;
 }
 
 const QList<map::MapIls> *MapQuery::getIls(const GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy)
 {
-  ilsCache.updateCache(rect, mapLayer, lazy,
+  ilsCache.updateCache(rect, visibleCap, mapLayer, lazy,
                        [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersIls(newLayer);
-  });
+  }, queryStatistics);
 
   if(ilsCache.list.isEmpty() && !lazy)
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    QElapsedTimer timer;
+    timer.start();
+    for(const GeoDataLatLonBox& r : splitVisible(rect))
     {
       bindCoordinatePointInRect(r, ilsByRectQuery);
       ilsByRectQuery->exec();
@@ -767,21 +828,29 @@ const QList<map::MapIls> *MapQuery::getIls(const GeoDataLatLonBox& rect, const M
         ilsCache.list.append(ils);
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   ilsCache.validate();
   return &ilsCache.list;
 }
 
 const QList<map::MapAirway> *MapQuery::getAirways(const GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy)
 {
-  airwayCache.updateCache(rect, mapLayer, lazy,
-                          [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  if(airwayCache.updateCache(rect, VisibleCap(), mapLayer, lazy,
+                             [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersAirway(newLayer);
-  });
+  }, queryStatistics))
+    // Cleared or restored from a previous layer
+    airwayCacheGeneration++;
 
   if(airwayCache.list.isEmpty() && !lazy)
   {
+    airwayCacheGeneration++;
+    QElapsedTimer timer;
+    timer.start();
     QSet<int> ids;
     for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
     {
@@ -806,7 +875,10 @@ const QList<map::MapAirway> *MapQuery::getAirways(const GeoDataLatLonBox& rect,
         }
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   airwayCache.validate();
   return &airwayCache.list;
 }
@@ -815,132 +887,201 @@ const QList<map::MapAirspace> *MapQuery::getAirspaces(const GeoDataLatLonBox& re
                                                       map::MapAirspaceFilter filter, float flightPlanAltitude,
                                                       bool lazy)
 {
-  airspaceCache.updateCache(rect, mapLayer, lazy,
-                            [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
+  if(airspaceCache.updateCache(rect, VisibleCap(), mapLayer, lazy,
+                               [](const MapLayer *curLayer, const MapLayer *newLayer) -> bool
   {
     return curLayer->hasSameQueryParametersAirspace(newLayer);
-  });
+  }, queryStatistics) && !airspaceCache.list.isEmpty())
+  {
+    // Restored from a previous layer - index refers to the old list
+    buildAirspaceIndex();
+    airspaceFilterDirty = true;
+  }
 
   if(filter.types != lastAirspaceFilter.types || filter.flags != lastAirspaceFilter.flags ||
      atools::almostNotEqual(lastFlightplanAltitude, flightPlanAltitude))
   {
-    // Need a few more parameters to clear the cache which is different to other map features
-    airspaceCache.list.clear();
+    // Filter again from memory
+    airspaceFilterDirty = true;
     lastAirspaceFilter = filter;
     lastFlightplanAltitude = flightPlanAltitude;
   }
 
-  if(airspaceCache.list.isEmpty() && !lazy)
+  if(airspaceCache.list.isEmpty() && !lazy && filter.types != map::AIRSPACE_NONE)
   {
-    QStringList typeStrings;
+    QElapsedTimer timer;
+    timer.start();
 
-    if(filter.types != map::AIRSPACE_NONE)
+    QSet<int> ids;
+
+    // Get all airspace objects without geometry
+    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
     {
-      // Build a list of query strings based on the bitfield
-      if(filter.types == map::AIRSPACE_ALL)
-        typeStrings.append("%");
-      else
+      bindCoordinatePointInRect(r, airspaceByRectQuery);
+      airspaceByRectQuery->bindValue(":type", "%");
+      airspaceByRectQuery->exec();
+      while(airspaceByRectQuery->next())
       {
-        for(int i = 0; i <= map::MAP_AIRSPACE_TYPE_BITS; i++)
+        // Avoid double airspaces which can happen if they cross the date boundary
+        if(ids.contains(airspaceByRectQuery->valueInt("boundary_id")))
+          continue;
+
+        // qreal north, qreal south, qreal east, qreal west
+        if(rect.intersects(GeoDataLatLonBox(airspaceByRectQuery->valueFloat("max_laty"),
+                                            airspaceByRectQuery->valueFloat("min_laty"),
+                                            airspaceByRectQuery->valueFloat("max_lonx"),
+                                            airspaceByRectQuery->valueFloat("min_lonx"),
+                                            GeoDataCoordinates::GeoDataCoordinates::Degree)))
         {
-          map::MapAirspaceTypes t(1 << i);
-          if(filter.types & t)
-            typeStrings.append(map::airspaceTypeToDatabase(t));
+          map::MapAirspace airspace;
+          mapTypesFactory->fillAirspace(airspaceByRectQuery->record(), airspace);
+          airspaceCache.list.append(airspace);
+
+          ids.insert(airspace.id);
         }
       }
+    }
 
-      SqlQuery *query = nullptr;
-      int alt;
-      if(filter.flags & map::AIRSPACE_AT_FLIGHTPLAN)
-      {
-        query = airspaceByRectAtAltQuery;
-        alt = atools::roundToInt(flightPlanAltitude);
-      }
-      else if(filter.flags & map::AIRSPACE_BELOW_10000)
-      {
-        query = airspaceByRectBelowAltQuery;
-        alt = 10000;
-      }
-      else if(filter.flags & map::AIRSPACE_BELOW_18000)
-      {
-        query = airspaceByRectBelowAltQuery;
-        alt = 18000;
-      }
-      else if(filter.flags & map::AIRSPACE_ABOVE_10000)
-      {
-        query = airspaceByRectAboveAltQuery;
-        alt = 10000;
-      }
-      else if(filter.flags & map::AIRSPACE_ABOVE_18000)
-      {
-        query = airspaceByRectAboveAltQuery;
-        alt = 18000;
-      }
-      else
-      {
-        query = airspaceByRectQuery;
-        alt = 0;
-      }
+    // Sort by importance - filtered list keeps the order
+    std::sort(airspaceCache.list.begin(), airspaceCache.list.end(),
+              [](const map::MapAirspace& airspace1, const map::MapAirspace& airspace2) -> bool
+    {
+      return map::airspaceDrawingOrder(airspace1.type) < map::airspaceDrawingOrder(airspace2.type);
+    });
+
+    buildAirspaceIndex();
+    airspaceFilterDirty = true;
+    queryStatistics.miss(timer.nsecsElapsed());
+  }
+  else
+    queryStatistics.hit();
 
-      QSet<int> ids;
+  if(airspaceCache.list.isEmpty())
+  {
+    // Cache was invalidated by a changed rectangle
+    airspaceTypeIndex.clear();
+    airspaceFilteredList.clear();
+  }
+  else if(airspaceFilterDirty)
+    filterAirspaces(filter, flightPlanAltitude);
 
-      // qDebug() << rect.toString(GeoDataCoordinates::Degree);
+  airspaceCache.validate();
+  return &airspaceFilteredList;
+}
 
-      // Get the airspace objects without geometry
-      for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+void MapQuery::buildAirspaceIndex()
+{
+  airspaceTypeIndex.clear();
+  airspaceTypeIndex.resize(map::MAP_AIRSPACE_TYPE_BITS + 2);
+
+  for(int i = 0; i < airspaceCache.list.size(); i++)
+  {
+    const map::MapAirspace& airspace = airspaceCache.list.at(i);
+
+    // Find bit for type - unknown types go into the last bucket
+    int bucket = map::MAP_AIRSPACE_TYPE_BITS + 1;
+    for(int bit = 0; bit <= map::MAP_AIRSPACE_TYPE_BITS; bit++)
+    {
+      if(airspace.type == map::MapAirspaceTypes(1 << bit))
       {
-        // qDebug() << r.toString(GeoDataCoordinates::Degree);
+        bucket = bit;
+        break;
+      }
+    }
+    airspaceTypeIndex[bucket].append(i);
+  }
 
-        for(const QString& typeStr : typeStrings)
-        {
-          bindCoordinatePointInRect(r, query);
-          query->bindValue(":type", typeStr);
+  for(QVector<int>& indexes : airspaceTypeIndex)
+  {
+    std::sort(indexes.begin(), indexes.end(), [this](int index1, int index2) -> bool
+    {
+      return airspaceCache.list.at(index1).minAltitude < airspaceCache.list.at(index2).minAltitude;
+    });
+  }
+}
 
-          if(alt > 0)
-            query->bindValue(":alt", alt);
+void MapQuery::filterAirspaces(map::MapAirspaceFilter filter, float flightPlanAltitude)
+{
+  airspaceFilterDirty = false;
+  airspaceFilteredList.clear();
 
-          // qDebug() << "==================== query" << endl << query->getFullQueryString();
+  if(filter.types == map::AIRSPACE_NONE || airspaceTypeIndex.isEmpty())
+    return;
 
-          query->exec();
-          while(query->next())
-          {
-            // Avoid double airspaces which can happen if they cross the date boundary
-            if(ids.contains(query->valueInt("boundary_id")))
-              continue;
-
-            // qreal north, qreal south, qreal east, qreal west
-            if(rect.intersects(GeoDataLatLonBox(query->valueFloat("max_laty"), query->valueFloat("min_laty"),
-                                                query->valueFloat("max_lonx"), query->valueFloat("min_lonx"),
-                                                GeoDataCoordinates::GeoDataCoordinates::Degree)))
-            {
-              map::MapAirspace airspace;
-              mapTypesFactory->fillAirspace(query->record(), airspace);
-              airspaceCache.list.append(airspace);
-
-              ids.insert(airspace.id);
-            }
-          }
-        }
-      }
+  // Check minimum altitude below and/or maximum altitude above alt
+  int alt = 0;
+  bool checkMin = false, checkMax = false, inclusive = false;
+  if(filter.flags & map::AIRSPACE_AT_FLIGHTPLAN)
+  {
+    alt = atools::roundToInt(flightPlanAltitude);
+    checkMin = checkMax = inclusive = true;
+  }
+  else if(filter.flags & map::AIRSPACE_BELOW_10000)
+  {
+    alt = 10000;
+    checkMin = true;
+  }
+  else if(filter.flags & map::AIRSPACE_BELOW_18000)
+  {
+    alt = 18000;
+    checkMin = true;
+  }
+  else if(filter.flags & map::AIRSPACE_ABOVE_10000)
+  {
+    alt = 10000;
+    checkMax = true;
+  }
+  else if(filter.flags & map::AIRSPACE_ABOVE_18000)
+  {
+    alt = 18000;
+    checkMax = true;
+  }
 
-      // Sort by importance
-      std::sort(airspaceCache.list.begin(), airspaceCache.list.end(),
-                [](const map::MapAirspace& airspace1, const map::MapAirspace& airspace2) -> bool
+  QVector<int> indexes;
+  for(int bucket = 0; bucket < airspaceTypeIndex.size(); bucket++)
+  {
+    // Unknown types are only included if all are selected
+    if(bucket <= map::MAP_AIRSPACE_TYPE_BITS ? !(filter.types & map::MapAirspaceTypes(1 << bucket)) :
+       filter.types != map::AIRSPACE_ALL)
+      continue;
+
+    const QVector<int>& typeIndexes = airspaceTypeIndex.at(bucket);
+
+    // Skip all airspaces with a minimum altitude above the band using the sorted index
+    QVector<int>::const_iterator end = typeIndexes.constEnd();
+    if(checkMin)
+      end = std::partition_point(typeIndexes.constBegin(), typeIndexes.constEnd(),
+                                 [this, alt, inclusive](int i) -> bool
       {
-        return map::airspaceDrawingOrder(airspace1.type) < map::airspaceDrawingOrder(airspace2.type);
+        int minAlt = airspaceCache.list.at(i).minAltitude;
+        return inclusive ? minAlt <= alt : minAlt < alt;
       });
+
+    for(QVector<int>::const_iterator it = typeIndexes.constBegin(); it != end; ++it)
+    {
+      int maxAlt = airspaceCache.list.at(*it).maxAltitude;
+      if(!checkMax || (inclusive ? maxAlt >= alt : maxAlt > alt))
+        indexes.append(*it);
     }
   }
-  airspaceCache.validate();
-  return &airspaceCache.list;
+
+  // Restore drawing order of the cache list
+  std::sort(indexes.begin(), indexes.end());
+  for(int index : indexes)
+    airspaceFilteredList.append(airspaceCache.list.at(index));
 }
 
 const LineString *MapQuery::getAirspaceGeometry(int boundaryId)
 {
   if(airspaceLineCache.contains(boundaryId))
+  {
+    queryStatistics.hit();
     return airspaceLineCache.object(boundaryId);
+  }
   else
   {
+    QElapsedTimer timer;
+    timer.start();
     LineString *lines = new LineString;
 
     airspaceLinesByIdQuery->bindValue(":id", boundaryId);
@@ -953,12 +1094,109 @@ const LineString *MapQuery::getAirspaceGeometry(int boundaryId)
       // qDebug() << *lines;
     }
 
-    airspaceLineCache.insert(boundaryId, lines);
+    CacheBudget::instance().insert(airspaceLineCache, boundaryId, lines);
+    queryStatistics.miss(timer.nsecsElapsed());
 
     return lines;
   }
 }
 
+void MapQuery::initAirspaceIndex()
+{
+  if(airspaceIndexInitialized)
+    return;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  QList<map::MapAirspace> airspaces;
+  airspacesAllQuery->exec();
+  while(airspacesAllQuery->next())
+  {
+    map::MapAirspace airspace;
+    mapTypesFactory->fillAirspace(airspacesAllQuery->record(), airspace);
+    airspaces.append(airspace);
+  }
+  airspaceIndex.build(airspaces);
+  airspaceIndexInitialized = true;
+
+  queryStatistics.miss(timer.nsecsElapsed());
+}
+
+void MapQuery::getAirspacesAtPos(QList<map::MapAirspace>& airspaces, const atools::geo::Pos& pos,
+                                 float altitudeFt)
+{
+  if(!pos.isValid())
+    return;
+
+  initAirspaceIndex();
+
+  QVector<int> indexes;
+  airspaceIndex.getCandidates(indexes, Rect(pos));
+
+  for(int index : indexes)
+  {
+    const map::MapAirspace& airspace = airspaceIndex.at(index);
+    if(AirspaceIndex::containsAltitude(airspace, altitudeFt))
+    {
+      const LineString *geometry = getAirspaceGeometry(airspace.id);
+      if(geometry != nullptr && AirspaceIndex::containsPos(*geometry, pos))
+        airspaces.append(airspace);
+    }
+  }
+}
+
+void MapQuery::getAirspacesForLine(QList<map::MapAirspace>& airspaces, const atools::geo::LineString& line,
+                                   float altitudeFt)
+{
+  if(line.isEmpty())
+    return;
+
+  initAirspaceIndex();
+
+  QSet<int> found;
+  QVector<int> indexes;
+  for(int i = 0; i < line.size(); i++)
+  {
+    const Pos& from = line.at(i);
+    const Pos& to = i < line.size() - 1 ? line.at(i + 1) : from;
+    if(!from.isValid() || !to.isValid())
+      continue;
+
+    // Bounding rectangle of the segment - west is greater than east when crossing the anti-meridian
+    float west = std::min(from.getLonX(), to.getLonX()), east = std::max(from.getLonX(), to.getLonX());
+    if(east - west > 180.f)
+      std::swap(west, east);
+    Rect segmentRect(west, std::max(from.getLatY(), to.getLatY()), east, std::min(from.getLatY(), to.getLatY()));
+
+    airspaceIndex.getCandidates(indexes, segmentRect);
+    for(int index : indexes)
+    {
+      if(found.contains(index))
+        continue;
+
+      const map::MapAirspace& airspace = airspaceIndex.at(index);
+      if(AirspaceIndex::containsAltitude(airspace, altitudeFt))
+      {
+        const LineString *geometry = getAirspaceGeometry(airspace.id);
+        if(geometry != nullptr && AirspaceIndex::crossesLine(*geometry, from, to))
+          found.insert(index);
+      }
+    }
+  }
+
+  QList<int> sorted = found.toList();
+  std::sort(sorted.begin(), sorted.end());
+  for(int index : sorted)
+    airspaces.append(airspaceIndex.at(index));
+
+  std::stable_sort(airspaces.begin(), airspaces.end(),
+                   [](const map::MapAirspace& airspace1, const map::MapAirspace& airspace2) -> bool
+  {
+    return map::airspaceDrawingOrder(airspace1.type) < map::airspaceDrawingOrder(airspace2.type);
+  });
+}
+
 /*
  * Get airport cache
  * @param reverse reverse order of airports to have unimportant small ones below in painting order
@@ -972,7 +1210,9 @@ const QList<map::MapAirport> *MapQuery::fetchAirports(const Marble::GeoDataLatLo
 {
   if(airportCache.list.isEmpty() && !lazy)
   {
-    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+    QElapsedTimer timer;
+    timer.start();
+    for(const GeoDataLatLonBox& r : splitVisible(rect))
     {
       bindCoordinatePointInRect(r, query);
       query->exec();
@@ -991,18 +1231,75 @@ const QList<map::MapAirport> *MapQuery::fetchAirports(const Marble::GeoDataLatLo
           airportCache.list.append(ap);
       }
     }
+    queryStatistics.miss(timer.nsecsElapsed());
   }
+  else
+    queryStatistics.hit();
   airportCache.validate();
   return &airportCache.list;
 }
 
+const QList<map::MapAirport> *MapQuery::fetchAirportsRanked(const Marble::GeoDataLatLonBox& rect,
+                                                            AirportRanking& ranking, atools::sql::SqlQuery *query,
+                                                            bool lazy, bool changed)
+{
+  if(lazy)
+  {
+    // Keep whatever is loaded while scrolling or zooming
+    queryStatistics.hit();
+    return &airportCache.list;
+  }
+
+  if(ranking.isEmpty())
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<map::MapAirport> airports;
+    query->exec();
+    while(query->next())
+    {
+      map::MapAirport ap;
+      mapTypesFactory->fillAirportForOverview(query->record(), ap);
+      airports.append(ap);
+    }
+    ranking.build(airports);
+
+    queryStatistics.miss(timer.nsecsElapsed());
+  }
+
+  // Level depends on the zoom distance which can change within a layer
+  int level = AirportRanking::levelForWidth(static_cast<float>(rect.width(GeoDataCoordinates::Degree)));
+  if(changed || level != airportRankingLevel || airportCache.list.isEmpty())
+  {
+    // Ranking is in memory - always rebuild the list instead of using restored results
+    airportCache.list.clear();
+    for(const GeoDataLatLonBox& r : splitAtAntiMeridian(rect))
+      ranking.getAirports(airportCache.list,
+                          static_cast<float>(r.west(GeoDataCoordinates::Degree)),
+                          static_cast<float>(r.south(GeoDataCoordinates::Degree)),
+                          static_cast<float>(r.east(GeoDataCoordinates::Degree)),
+                          static_cast<float>(r.north(GeoDataCoordinates::Degree)), level);
+    airportRankingLevel = level;
+  }
+  else
+    queryStatistics.hit();
+
+  return &airportCache.list;
+}
+
 const QList<map::MapRunway> *MapQuery::getRunwaysForOverview(int airportId)
 {
   if(runwayOverwiewCache.contains(airportId))
+  {
+    queryStatistics.hit();
     return runwayOverwiewCache.object(airportId);
+  }
   else
   {
     using atools::geo::Pos;
+    QElapsedTimer timer;
+    timer.start();
 
     runwayOverviewQuery->bindValue(":airportId", airportId);
     runwayOverviewQuery->exec();
@@ -1014,7 +1311,8 @@ const QList<map::MapRunway> *MapQuery::getRunwaysForOverview(int airportId)
       mapTypesFactory->fillRunway(runwayOverviewQuery->record(), runway, true);
       rws->append(runway);
     }
-    runwayOverwiewCache.insert(airportId, rws);
+    CacheBudget::instance().insert(runwayOverwiewCache, airportId, rws);
+    queryStatistics.miss(timer.nsecsElapsed());
     return rws;
   }
 }
@@ -1061,6 +1359,150 @@ QList<Marble::GeoDataLatLonBox> MapQuery::splitAtAntiMeridian(const Marble::GeoD
     return QList<GeoDataLatLonBox>({newRect});
 }
 
+QList<Marble::GeoDataLatLonBox> MapQuery::splitVisible(const Marble::GeoDataLatLonBox& rect)
+{
+  if(!visibleCap.isLimiting())
+    return splitAtAntiMeridian(rect);
+
+  VisibleCap cap(visibleCap);
+  inflateCap(cap);
+  if(cap.isFull())
+    return splitAtAntiMeridian(rect);
+
+  float centerLon = cap.center.getLonX(), centerLat = cap.center.getLatY();
+
+  // Latitude range of the cap limited by the rectangle
+  GeoDataLatLonBox inflated(rect);
+  inflateRect(inflated);
+  float south = std::max(centerLat - cap.radiusDeg, static_cast<float>(inflated.south(GeoDataCoordinates::Degree)));
+  float north = std::min(centerLat + cap.radiusDeg, static_cast<float>(inflated.north(GeoDataCoordinates::Degree)));
+  south = std::max(south, -90.f);
+  north = std::min(north, 90.f);
+
+  if(south >= north)
+    return splitAtAntiMeridian(rect);
+
+  // Latitude where the cap is widest if it does not contain a pole
+  float widestLat = centerLat;
+  double sinWidest = std::sin(atools::geo::toRadians(static_cast<double>(centerLat))) /
+                     std::cos(atools::geo::toRadians(static_cast<double>(cap.radiusDeg)));
+  if(sinWidest >= -1. && sinWidest <= 1.)
+    widestLat = static_cast<float>(std::asin(sinWidest) * 180. / M_PI);
+
+  QList<GeoDataLatLonBox> rects;
+  float bandHeight = (north - south) / CAP_LATITUDE_BANDS;
+  for(int i = 0; i < CAP_LATITUDE_BANDS; i++)
+  {
+    float bandSouth = south + bandHeight * i, bandNorth = south + bandHeight * (i + 1);
+
+    // Width has at most one maximum - check borders and the widest latitude if within the band
+    float halfWidth = std::max(capHalfWidth(cap, bandSouth), capHalfWidth(cap, bandNorth));
+    halfWidth = std::max(halfWidth, capHalfWidth(cap, std::max(bandSouth, std::min(widestLat, bandNorth))));
+
+    GeoDataLatLonBox band;
+    if(halfWidth >= 180.f)
+      band.setBoundaries(bandNorth, bandSouth, 180., -180., GeoDataCoordinates::Degree);
+    else
+    {
+      // Boundaries are normalized which results in a box crossing the anti-meridian if needed
+      band.setBoundaries(bandNorth, bandSouth,
+                         GeoDataCoordinates::normalizeLon(centerLon + halfWidth, GeoDataCoordinates::Degree),
+                         GeoDataCoordinates::normalizeLon(centerLon - halfWidth, GeoDataCoordinates::Degree),
+                         GeoDataCoordinates::Degree);
+    }
+
+    // Bands are already inflated
+    if(band.crossesDateLine())
+    {
+      GeoDataLatLonBox westOf, eastOf;
+      westOf.setBoundaries(bandNorth, bandSouth, 180., band.west(GeoDataCoordinates::Degree),
+                           GeoDataCoordinates::Degree);
+      eastOf.setBoundaries(bandNorth, bandSouth, band.east(GeoDataCoordinates::Degree), -180.,
+                           GeoDataCoordinates::Degree);
+      rects.append(westOf);
+      rects.append(eastOf);
+    }
+    else
+      rects.append(band);
+  }
+  return rects;
+}
+
+float MapQuery::capHalfWidth(const VisibleCap& cap, float latY)
+{
+  float centerLat = cap.center.getLatY();
+
+  // Poles are either inside or outside of the cap
+  if(latY >= 89.99f)
+    return centerLat + cap.radiusDeg >= 90.f ? 180.f : 0.f;
+  else if(latY <= -89.99f)
+    return centerLat - cap.radiusDeg <= -90.f ? 180.f : 0.f;
+
+  double lat = atools::geo::toRadians(static_cast<double>(latY));
+  double lat0 = atools::geo::toRadians(static_cast<double>(centerLat));
+  double denom = std::cos(lat) * std::cos(lat0);
+  if(denom < 1.e-9)
+    // Cap centered on a pole covers all longitudes
+    return 180.f;
+
+  // Solve the spherical law of cosines for the longitude difference at the cap border
+  double cosLon = (std::cos(atools::geo::toRadians(static_cast<double>(cap.radiusDeg))) -
+                   std::sin(lat) * std::sin(lat0)) / denom;
+  if(cosLon <= -1.)
+    return 180.f;
+  else if(cosLon >= 1.)
+    return 0.f;
+  else
+    return static_cast<float>(std::acos(cosLon) * 180. / M_PI);
+}
+
+void MapQuery::inflateCap(VisibleCap& cap)
+{
+  if(!cap.isFull())
+    cap.radiusDeg = std::min(180.f, static_cast<float>(cap.radiusDeg * (1. + queryRectInflationFactor) +
+                                                       queryRectInflationIncrement));
+}
+
+bool MapQuery::VisibleCap::contains(const VisibleCap& other) const
+{
+  if(isFull())
+    return true;
+  else if(other.isFull())
+    return false;
+
+  // Angular distance between centers in degree
+  double lat1 = atools::geo::toRadians(static_cast<double>(center.getLatY()));
+  double lat2 = atools::geo::toRadians(static_cast<double>(other.center.getLatY()));
+  double lon = atools::geo::toRadians(static_cast<double>(other.center.getLonX() - center.getLonX()));
+  double cosDist = std::sin(lat1) * std::sin(lat2) + std::cos(lat1) * std::cos(lat2) * std::cos(lon);
+  double dist = std::acos(std::max(-1., std::min(cosDist, 1.))) * 180. / M_PI;
+
+  return dist + other.radiusDeg <= radiusDeg;
+}
+
+void MapQuery::updateVisibleCap(const Marble::ViewportParams *viewport)
+{
+  VisibleCap cap;
+  if(viewport->projection() == Marble::Spherical)
+  {
+    // Farthest visible point is in a screen corner or on the horizon
+    double halfDiagonal = std::sqrt(viewport->width() * viewport->width() +
+                                    viewport->height() * viewport->height()) / 2.;
+    double radius = viewport->radius();
+
+    cap.center = Pos(static_cast<float>(viewport->centerLongitude() * 180. / M_PI),
+                     static_cast<float>(viewport->centerLatitude() * 180. / M_PI));
+    if(halfDiagonal >= radius)
+      cap.radiusDeg = 90.f;
+    else
+      cap.radiusDeg = static_cast<float>(std::asin(halfDiagonal / radius) * 180. / M_PI);
+
+    // Caps below CAP_MIN_RADIUS_DEG are not used for queries since the bounding rectangle is tight enough.
+    // They are kept anyway so that data loaded for a larger cap is reused when zooming in.
+  }
+  visibleCap = cap;
+}
+
 /* Inflate rect by width and height in degrees. If it crosses the poles or date line it will be limited */
 void MapQuery::inflateRect(Marble::GeoDataLatLonBox& rect)
 {
@@ -1179,13 +1621,12 @@ void MapQuery::initQueries()
     " and longest_runway_length >= :minlength order by rating desc, longest_runway_length desc "
     + whereLimit);
 
-  airportMediumByRectQuery = new SqlQuery(db);
-  airportMediumByRectQuery->prepare(
-    "select " + airportQueryBaseOverview + "from airport_medium where " + whereRect + " " + whereLimit);
+  // Load all overview airports for the ranking
+  airportMediumQuery = new SqlQuery(db);
+  airportMediumQuery->prepare("select " + airportQueryBaseOverview + "from airport_medium");
 
-  airportLargeByRectQuery = new SqlQuery(db);
-  airportLargeByRectQuery->prepare(
-    "select " + airportQueryBaseOverview + "from airport_large where " + whereRect + " " + whereLimit);
+  airportLargeQuery = new SqlQuery(db);
+  airportLargeQuery->prepare("select " + airportQueryBaseOverview + "from airport_large");
 
   // Runways > 4000 feet for simplyfied runway overview
   runwayOverviewQuery = new SqlQuery(db);
@@ -1265,32 +1706,20 @@ void MapQuery::initQueries()
     "select " + airspaceQueryBase + "from boundary "
                                     "where " + airspaceRect + " type like :type");
 
-  airspaceByRectBelowAltQuery = new SqlQuery(dbNav);
-  airspaceByRectBelowAltQuery->prepare(
-    "select " + airspaceQueryBase + "from boundary "
-                                    "where " + airspaceRect + " type like :type and min_altitude < :alt");
-
-  airspaceByRectAboveAltQuery = new SqlQuery(dbNav);
-  airspaceByRectAboveAltQuery->prepare(
-    "select " + airspaceQueryBase + "from boundary "
-                                    "where " + airspaceRect + " type like :type and max_altitude > :alt");
-
-  airspaceByRectAtAltQuery = new SqlQuery(dbNav);
-  airspaceByRectAtAltQuery->prepare(
-    "select " + airspaceQueryBase + "from boundary "
-                                    "where "
-                                    "not (max_lonx < :leftx or min_lonx > :rightx or "
-                                    "min_laty > :topy or max_laty < :bottomy) and "
-                                    "type like :type and "
-                                    ":alt between min_altitude and max_altitude");
-
   airspaceLinesByIdQuery = new SqlQuery(dbNav);
   airspaceLinesByIdQuery->prepare("select geometry from boundary where boundary_id = :id");
 
+  airspacesAllQuery = new SqlQuery(dbNav);
+  airspacesAllQuery->prepare("select " + airspaceQueryBase + " from boundary");
+
 }
 
 void MapQuery::deInitQueries()
 {
+  mapTypesFactory->clearInternedStrings();
+  waypointColumns = MapTypesFactory::WaypointColumns();
+  vorColumns = MapTypesFactory::VorColumns();
+  ndbColumns = MapTypesFactory::NdbColumns();
   airportCache.clear();
   waypointCache.clear();
   vorCache.clear();
@@ -1298,16 +1727,25 @@ void MapQuery::deInitQueries()
   markerCache.clear();
   ilsCache.clear();
   airwayCache.clear();
+  airwayCacheGeneration++;
   airspaceCache.clear();
+  airspaceTypeIndex.clear();
+  airspaceFilteredList.clear();
+  airspaceFilterDirty = true;
+  airspaceIndex.clear();
+  airspaceIndexInitialized = false;
+  airportRankingMedium.clear();
+  airportRankingLarge.clear();
+  airportRankingLevel = -1;
   airspaceLineCache.clear();
   runwayOverwiewCache.clear();
 
   delete airportByRectQuery;
   airportByRectQuery = nullptr;
-  delete airportMediumByRectQuery;
-  airportMediumByRectQuery = nullptr;
-  delete airportLargeByRectQuery;
-  airportLargeByRectQuery = nullptr;
+  delete airportMediumQuery;
+  airportMediumQuery = nullptr;
+  delete airportLargeQuery;
+  airportLargeQuery = nullptr;
 
   delete runwayOverviewQuery;
   runwayOverviewQuery = nullptr;
@@ -1327,15 +1765,11 @@ void MapQuery::deInitQueries()
 
   delete airspaceByRectQuery;
   airspaceByRectQuery = nullptr;
-  delete airspaceByRectBelowAltQuery;
-  airspaceByRectBelowAltQuery = nullptr;
-  delete airspaceByRectAboveAltQuery;
-  airspaceByRectAboveAltQuery = nullptr;
-  delete airspaceByRectAtAltQuery;
-  airspaceByRectAtAltQuery = nullptr;
 
   delete airspaceLinesByIdQuery;
   airspaceLinesByIdQuery = nullptr;
+  delete airspacesAllQuery;
+  airspacesAllQuery = nullptr;
   delete airspaceByIdQuery;
   airspaceByIdQuery = nullptr;
 
@@ -19,7 +19,11 @@
 #define LITTLENAVMAP_MAPQUERY_H
 
 #include "common/maptypes.h"
+#include "common/maptypesfactory.h"
 #include "mapgui/maplayer.h"
+#include "query/querystatistics.h"
+#include "query/airspaceindex.h"
+#include "query/airportranking.h"
 
 #include <QCache>
 #include <QList>
@@ -38,8 +42,11 @@ class SqlQuery;
 }
 }
 
+namespace Marble {
+class ViewportParams;
+}
+
 class CoordinateConverter;
-class MapTypesFactory;
 class MapLayer;
 
 /*
@@ -131,7 +138,7 @@ public:
    * @param types map objects to fetch AIRPORT, VOR, NDB, WAYPOINT, AIRWAY, etc.
    * @param xs/ys Screen coordinates
    * @param screenDistance maximum distance to coordinates
-   * @param result will receive objects based on type
+   * @param result will receive objects based on type or only references if result is in id only mode
    */
   void getNearestObjects(const CoordinateConverter& conv, const MapLayer *mapLayer, bool airportDiagram,
                          map::MapObjectTypes types, int xs, int ys, int screenDistance,
@@ -166,13 +173,46 @@ public:
   /* Similar to getAirports */
   const QList<map::MapAirway> *getAirways(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy);
 
+  /* All airspaces in the rectangle are loaded once and then filtered in memory by type and altitude.
+   * Changing filter or altitude does not access the database. */
   const QList<map::MapAirspace> *getAirspaces(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer,
                                               map::MapAirspaceFilter filter, float flightPlanAltitude, bool lazy);
   const atools::geo::LineString *getAirspaceGeometry(int boundaryId);
 
+  /* Get all airspaces containing the position at the given altitude in feet. Altitude is ignored if negative.
+   * Uses a spatial index of all airspaces which is built on first call. */
+  void getAirspacesAtPos(QList<map::MapAirspace>& airspaces, const atools::geo::Pos& pos, float altitudeFt);
+
+  /* Get all airspaces crossed by the line string, e.g. a flight plan, at the given altitude in feet.
+   * Altitude is ignored if negative. Result is in drawing order. */
+  void getAirspacesForLine(QList<map::MapAirspace>& airspaces, const atools::geo::LineString& line,
+                           float altitudeFt);
+
   /* Get a partially filled runway list for the overview */
   const QList<map::MapRunway> *getRunwaysForOverview(int airportId);
 
+  /* Changes every time the airway list returned by getAirways is reloaded or cleared */
+  int getAirwayCacheGeneration() const
+  {
+    return airwayCacheGeneration;
+  }
+
+  /* Statistics since last call of resetQueryStatistics() */
+  const QueryStatistics& getQueryStatistics() const
+  {
+    return queryStatistics;
+  }
+
+  void resetQueryStatistics()
+  {
+    queryStatistics = QueryStatistics();
+  }
+
+  /* Update the visible part of the globe from the viewport. Call before fetching objects for a view.
+   * If the spherical projection is zoomed out airports and navaids are only loaded for the latitude bands
+   * covering the visible part instead of the whole bounding rectangle. Disabled for other projections. */
+  void updateVisibleCap(const Marble::ViewportParams *viewport);
+
   /* Close all query objects thus disconnecting from the database */
   void initQueries();
 
@@ -180,7 +220,31 @@ public:
   void deInitQueries();
 
 private:
-  /* Simple spatial cache that deals with objects in a bounding rectangle but does not run any queries to load data */
+  /* Spherical cap covering the visible part of the globe. A radius of 180 degree covers the whole world. */
+  struct VisibleCap
+  {
+    atools::geo::Pos center;
+    float radiusDeg = 180.f;
+
+    bool isFull() const
+    {
+      return radiusDeg >= 180.f || !center.isValid();
+    }
+
+    /* true if other is completely covered by this cap */
+    bool contains(const VisibleCap& other) const;
+
+    /* true if the cap is large enough to be used to limit queries. Smaller caps are still kept to
+     * find cached data loaded for a larger cap. */
+    bool isLimiting() const
+    {
+      return !isFull() && radiusDeg >= CAP_MIN_RADIUS_DEG;
+    }
+
+  };
+
+  /* Simple spatial cache that deals with objects in a bounding rectangle but does not run any queries to load data.
+   * Keeps the complete results of the last layers and rectangles to avoid reloading when zooming back and forth. */
   template<typename TYPE>
   struct SimpleRectCache
   {
@@ -188,18 +252,37 @@ private:
 
     /*
      * @param rect bounding rectangle - all objects inside this rectangle are returned
+     * @param cap visible part of the globe - data is reloaded if the cap is not covered by the loaded data
      * @param mapLayer current map layer
      * @param lazy if true do not fetch new data but return the old potentially incomplete dataset
-     * @return true after clearing the cache. The caller has to request new data
+     * @param statistics counts reloads and restores
+     * @return true if the cache was cleared or restored from retained data. The caller has to request new
+     * data if the list is empty
      */
-    bool updateCache(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer, bool lazy,
-                     LayerCompareFunc funcSameLayer);
+    bool updateCache(const Marble::GeoDataLatLonBox& rect, const VisibleCap& cap, const MapLayer *mapLayer,
+                     bool lazy, LayerCompareFunc funcSameLayer, QueryStatistics& statistics);
     void clear();
     void validate();
 
     Marble::GeoDataLatLonBox curRect;
+    VisibleCap curCap;
     const MapLayer *curMapLayer = nullptr;
     QList<TYPE> list;
+
+    /* Result of a previous layer or rectangle */
+    struct Retained
+    {
+      Marble::GeoDataLatLonBox rect;
+      VisibleCap cap;
+      const MapLayer *mapLayer;
+      QList<TYPE> list;
+    };
+
+    /* Most recent first */
+    QList<Retained> retained;
+
+    /* Number of previous results to keep */
+    static Q_DECL_CONSTEXPR int RETAINED_SIZE = 3;
   };
 
   void mapObjectByIdentInternal(map::MapSearchResult& result, map::MapObjectTypes type,
@@ -211,18 +294,43 @@ private:
                                               atools::sql::SqlQuery *query, bool reverse,
                                               bool lazy, bool overview);
 
+  /* Get the most important airports for the rectangle from the ranking which is loaded using query on first call */
+  const QList<map::MapAirport> *fetchAirportsRanked(const Marble::GeoDataLatLonBox& rect, AirportRanking& ranking,
+                                                    atools::sql::SqlQuery *query, bool lazy, bool changed);
+
   void bindCoordinatePointInRect(const Marble::GeoDataLatLonBox& rect, atools::sql::SqlQuery *query,
                                  const QString& prefix = QString());
 
   QList<Marble::GeoDataLatLonBox> splitAtAntiMeridian(const Marble::GeoDataLatLonBox& rect);
 
+  /* Same as splitAtAntiMeridian but covers only the visible cap using latitude bands if the cap is large */
+  QList<Marble::GeoDataLatLonBox> splitVisible(const Marble::GeoDataLatLonBox& rect);
+
+  /* Half of the longitude range in degree covered by the cap at the given latitude */
+  static float capHalfWidth(const VisibleCap& cap, float latY);
+
+  /* Load all airspaces without geometry into airspaceIndex if not done yet */
+  void initAirspaceIndex();
+
+  /* Build airspaceTypeIndex from airspaceCache */
+  void buildAirspaceIndex();
+
+  /* Fill airspaceFilteredList from airspaceCache using the index */
+  void filterAirspaces(map::MapAirspaceFilter filter, float flightPlanAltitude);
+
   static void inflateRect(Marble::GeoDataLatLonBox& rect);
+  static void inflateCap(VisibleCap& cap);
 
   bool runwayCompare(const map::MapRunway& r1, const map::MapRunway& r2);
 
   MapTypesFactory *mapTypesFactory;
   atools::sql::SqlDatabase *db, *dbNav;
 
+  /* Column indexes for the rectangle queries. Resolved on first use. */
+  MapTypesFactory::WaypointColumns waypointColumns;
+  MapTypesFactory::VorColumns vorColumns;
+  MapTypesFactory::NdbColumns ndbColumns;
+
   /* Simple bounding rectangle caches */
   SimpleRectCache<map::MapAirport> airportCache;
   SimpleRectCache<map::MapWaypoint> waypointCache;
@@ -231,26 +339,53 @@ private:
   SimpleRectCache<map::MapMarker> markerCache;
   SimpleRectCache<map::MapIls> ilsCache;
   SimpleRectCache<map::MapAirway> airwayCache;
+  int airwayCacheGeneration = 0;
+  /* Airspaces of all types and altitudes in the rectangle */
   SimpleRectCache<map::MapAirspace> airspaceCache;
+
+  /* Index into airspaceCache for each type bit sorted by minimum altitude. Last entry is for unknown types. */
+  QVector<QVector<int> > airspaceTypeIndex;
+
+  /* Result of filtering airspaceCache by type and altitude */
+  QList<map::MapAirspace> airspaceFilteredList;
+  bool airspaceFilterDirty = true;
   map::MapAirspaceFilter lastAirspaceFilter = {map::AIRSPACE_NONE, map::AIRSPACE_FLAG_NONE};
   float lastFlightplanAltitude = 0.f;
 
+  /* Visible part of the globe for the current view */
+  VisibleCap visibleCap;
+
+  /* Number of latitude bands used to cover the cap and minimum radius in degree to use them */
+  static Q_DECL_CONSTEXPR int CAP_LATITUDE_BANDS = 4;
+  static Q_DECL_CONSTEXPR float CAP_MIN_RADIUS_DEG = 20.f;
+
+  /* Spatial index of all airspaces for position and line lookups */
+  AirspaceIndex airspaceIndex;
+  /* Set once the index is built - an empty boundary table leaves the index empty */
+  bool airspaceIndexInitialized = false;
+
+  /* Airports of the overview layers ranked by importance. Loaded on first use. */
+  AirportRanking airportRankingMedium, airportRankingLarge;
+
+  /* Ranking level of the airports in airportCache or -1 if not loaded from a ranking */
+  int airportRankingLevel = -1;
+
   /* ID/object caches */
   QCache<int, QList<map::MapRunway> > runwayOverwiewCache;
   QCache<int, atools::geo::LineString> airspaceLineCache;
 
   static int queryMaxRows;
 
+  QueryStatistics queryStatistics;
+
   /* Database queries */
   atools::sql::SqlQuery *runwayOverviewQuery = nullptr,
-                        *airportByRectQuery = nullptr, *airportMediumByRectQuery = nullptr,
-                        *airportLargeByRectQuery = nullptr;
+                        *airportByRectQuery = nullptr, *airportMediumQuery = nullptr,
+                        *airportLargeQuery = nullptr;
 
   atools::sql::SqlQuery *waypointsByRectQuery = nullptr, *vorsByRectQuery = nullptr,
                         *ndbsByRectQuery = nullptr, *markersByRectQuery = nullptr, *ilsByRectQuery = nullptr,
-                        *airwayByRectQuery = nullptr, *airspaceByRectQuery = nullptr,
-                        *airspaceByRectBelowAltQuery = nullptr, *airspaceByRectAboveAltQuery = nullptr,
-                        *airspaceByRectAtAltQuery = nullptr,
+                        *airwayByRectQuery = nullptr, *airspaceByRectQuery = nullptr, *airspacesAllQuery = nullptr,
                         *airspaceLinesByIdQuery = nullptr;
 
   atools::sql::SqlQuery *vorByIdentQuery = nullptr, *ndbByIdentQuery = nullptr, *waypointByIdentQuery = nullptr,
@@ -270,7 +405,8 @@ private:
 // ---------------------------------------------------------------------------------
 template<typename TYPE>
 bool MapQuery::SimpleRectCache<TYPE>::updateCache(const Marble::GeoDataLatLonBox& rect, const MapLayer *mapLayer,
-                                                  bool lazy, LayerCompareFunc funcSameLayer)
+                                                  bool lazy, LayerCompareFunc funcSameLayer,
+                                                  QueryStatistics& statistics)
 {
   if(lazy)
     // Nothing changed11
@@ -279,13 +415,51 @@ bool MapQuery::SimpleRectCache<TYPE>::updateCache(const Marble::GeoDataLatLonBox
   // Store bounding rectangle and inflate it
   Marble::GeoDataLatLonBox cur(curRect);
   MapQuery::inflateRect(cur);
+  VisibleCap curCapInflated(curCap);
+  MapQuery::inflateCap(curCapInflated);
 
-  if(curRect.isEmpty() || !cur.contains(rect) || !funcSameLayer(curMapLayer, mapLayer))
+  if(curRect.isEmpty() || !cur.contains(rect) || !curCapInflated.contains(cap) ||
+     !funcSameLayer(curMapLayer, mapLayer))
   {
     // Rectangle not covered by loaded data or new layer selected
-    list.clear();
-    curRect = rect;
+    // Look for a previous result covering the rectangle
+    int found = -1;
+    for(int i = 0; i < retained.size() && found == -1; i++)
+    {
+      Marble::GeoDataLatLonBox r(retained.at(i).rect);
+      MapQuery::inflateRect(r);
+      VisibleCap c(retained.at(i).cap);
+      MapQuery::inflateCap(c);
+      if(r.contains(rect) && c.contains(cap) && funcSameLayer(retained.at(i).mapLayer, mapLayer))
+        found = i;
+    }
+
+    Retained old = {curRect, curCap, curMapLayer, list};
+    if(found != -1)
+    {
+      Retained entry = retained.takeAt(found);
+      list = entry.list;
+      curRect = entry.rect;
+      curCap = entry.cap;
+      statistics.restore();
+    }
+    else
+    {
+      list.clear();
+      curRect = rect;
+      // Data loaded for the rectangle only covers any cap
+      curCap = cap.isLimiting() ? cap : VisibleCap();
+      statistics.reload();
+    }
     curMapLayer = mapLayer;
+
+    // Keep the old result if it is complete - validate() clears the rectangle for truncated results
+    if(!old.rect.isEmpty() && old.mapLayer != nullptr && !old.list.isEmpty())
+    {
+      retained.prepend(old);
+      while(retained.size() > RETAINED_SIZE)
+        retained.removeLast();
+    }
     return true;
   }
   return false;
@@ -305,7 +479,9 @@ template<typename TYPE>
 void MapQuery::SimpleRectCache<TYPE>::clear()
 {
   list.clear();
+  retained.clear();
   curRect.clear();
+  curCap = VisibleCap();
   curMapLayer = nullptr;
 }
 
@@ -19,6 +19,7 @@
 #include "navapp.h"
 #include "query/mapquery.h"
 #include "query/airportquery.h"
+#include "query/cachebudget.h"
 #include "geo/calculations.h"
 #include "sql/sqldatabase.h"
 #include "common/unit.h"
@@ -50,10 +51,15 @@ ProcedureQuery::ProcedureQuery(atools::sql::SqlDatabase *sqlDbNav)
 {
   mapQuery = NavApp::getMapQuery();
   airportQueryNav = NavApp::getAirportQueryNav();
+
+  CacheBudget& budget = CacheBudget::instance();
+  budget.registerCache(this, "Procedure approaches", &approachCache);
+  budget.registerCache(this, "Procedure transitions", &transitionCache);
 }
 
 ProcedureQuery::~ProcedureQuery()
 {
+  CacheBudget::instance().unregisterCaches(this);
   deInitQueries();
 }
 
@@ -546,7 +552,7 @@ proc::MapProcedureLegs *ProcedureQuery::fetchApproachLegs(const map::MapAirport&
     for(int i = 0; i < legs->size(); i++)
       approachLegIndex.insert(legs->at(i).legId, std::make_pair(approachId, i));
 
-    approachCache.insert(approachId, legs);
+    CacheBudget::instance().insert(approachCache, approachId, legs);
     return legs;
   }
 }
@@ -607,7 +613,7 @@ proc::MapProcedureLegs *ProcedureQuery::fetchTransitionLegs(const map::MapAirpor
     for(int i = 0; i < legs->size(); ++i)
       transitionLegIndex.insert(legs->at(i).legId, std::make_pair(transitionId, i));
 
-    transitionCache.insert(transitionId, legs);
+    CacheBudget::instance().insert(transitionCache, transitionId, legs);
     return legs;
   }
 }
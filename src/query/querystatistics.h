@@ -0,0 +1,67 @@
+/*****************************************************************************
+* Copyright 2015-2017 Alexander Barthel albar965@mailbox.org
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#ifndef LITTLENAVMAP_QUERYSTATISTICS_H
+#define LITTLENAVMAP_QUERYSTATISTICS_H
+
+#include <QtGlobal>
+
+/*
+ * Cache hit and query time counters for the render statistics overlay.
+ * Collected by the query classes and reset by the paint layer before each frame.
+ */
+struct QueryStatistics
+{
+  qint64 queryNs = 0; /* Time spent in database queries for cache misses */
+  int cacheHits = 0, cacheMisses = 0;
+  int cacheReloads = 0; /* Rectangle cache cleared because of a new layer or area */
+  int cacheRestores = 0; /* Rectangle cache filled from data retained for a previous layer or area */
+
+  void hit()
+  {
+    cacheHits++;
+  }
+
+  void reload()
+  {
+    cacheReloads++;
+  }
+
+  void restore()
+  {
+    cacheRestores++;
+  }
+
+  void miss(qint64 nanoseconds)
+  {
+    cacheMisses++;
+    queryNs += nanoseconds;
+  }
+
+  QueryStatistics& operator+=(const QueryStatistics& other)
+  {
+    queryNs += other.queryNs;
+    cacheHits += other.cacheHits;
+    cacheMisses += other.cacheMisses;
+    cacheReloads += other.cacheReloads;
+    cacheRestores += other.cacheRestores;
+    return *this;
+  }
+
+};
+
+#endif // LITTLENAVMAP_QUERYSTATISTICS_H
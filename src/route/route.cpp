@@ -1017,9 +1017,18 @@ void Route::updateDistancesAndCourse()
 
 void Route::updateMagvar()
 {
+  // Look up declination for all legs at once as fallback
+  QVector<atools::geo::Pos> positions;
+  positions.reserve(size());
+  for(const RouteLeg& leg : *this)
+    positions.append(leg.getPosition());
+
+  QVector<float> magvars;
+  NavApp::getMagVars(magvars, positions);
+
   // get magvar from internal database objects (waypoints, VOR and others)
   for(int i = 0; i < size(); i++)
-    (*this)[i].updateMagvar();
+    (*this)[i].updateMagvar(magvars.at(i));
 }
 
 /* Update the bounding rect using marble functions to catch anti meridian overlap */
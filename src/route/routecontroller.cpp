@@ -566,12 +566,14 @@ void RouteController::loadFlightplan(atools::fs::pln::Flightplan flightplan, con
 
     if(!ok)
     {
-      QMessageBox::warning(mainWindow, QApplication::applicationName(),
-                           tr("Loading of FLP flight plan failed:<br/><br/>") + rs.getMessages().join("<br/>"));
+      qWarning() << Q_FUNC_INFO << "Loading of FLP flight plan failed" << filename;
+      if(!quiet)
+        QMessageBox::warning(mainWindow, QApplication::applicationName(),
+                             tr("Loading of FLP flight plan failed:<br/><br/>") + rs.getMessages().join("<br/>"));
       return;
 
     }
-    else if(!rs.getMessages().isEmpty())
+    else if(!rs.getMessages().isEmpty() && !quiet)
       atools::gui::Dialog(mainWindow).showInfoMsgBox(lnm::ACTIONS_SHOW_LOAD_FLP_WARN,
                                                      tr("Warnings while loading FLP flight plan file:<br/><br/>") +
                                                      rs.getMessages().join("<br/>"),
@@ -615,7 +617,7 @@ void RouteController::loadFlightplan(atools::fs::pln::Flightplan flightplan, con
 
   createRouteLegsFromFlightplan();
 
-  loadProceduresFromFlightplan(false /* quiet */);
+  loadProceduresFromFlightplan(quiet);
   route.updateAll();
   updateAirwaysAndAltitude(adjustAltitude);
 
@@ -76,6 +76,8 @@ public:
   /* Loads flight plan from FSX PLN file, checks for proper start position (shows notification dialog)
    * and emits routeChanged. Uses file name as new current name  */
   bool loadFlightplan(const QString& filename);
+
+  /* Load flight plan object. Does not show any dialogs if quiet is true. */
   void loadFlightplan(atools::fs::pln::Flightplan flightplan,
                       const QString& filename, bool quiet, bool changed, bool adjustAltitude, float speedKts);
 
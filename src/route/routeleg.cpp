@@ -330,7 +330,7 @@ void RouteLeg::setDepartureStart(const map::MapStart& departureStart)
   parking = map::MapParking();
 }
 
-void RouteLeg::updateMagvar()
+void RouteLeg::updateMagvar(float gridMagvar)
 {
   if(isAnyProcedure())
     magvar = procedureLeg.magvar;
@@ -343,6 +343,8 @@ void RouteLeg::updateMagvar()
   // Airport is least reliable and often wrong
   else if(airport.isValid())
     magvar = airport.magvar;
+  else if(gridMagvar < map::INVALID_MAGVAR)
+    magvar = gridMagvar;
   else
     magvar = NavApp::getMagVar(getPosition());
 }
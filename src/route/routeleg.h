@@ -73,8 +73,9 @@ public:
    */
   void updateDistanceAndCourse(int entryIndex, const RouteLeg *prevLeg);
 
-  /* Get magvar from all known objects */
-  void updateMagvar();
+  /* Get magvar from all known objects. Uses gridMagvar or does a lookup in the declination grid if
+   * not given and no object is available. */
+  void updateMagvar(float gridMagvar = map::INVALID_MAGVAR);
 
   /* Change user defined waypoint name */
   void updateUserName(const QString& name);